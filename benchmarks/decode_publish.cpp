@@ -0,0 +1,183 @@
+// Measures heap allocations and peak memory of decoding an attribute report
+// and building the messages publishing it, with topics and payloads put
+// together in a MessageArena and, for comparison, in plain std::strings as
+// before. Peak RSS is per process, so pass the name of a single variant to
+// compare it between them.
+#include <malloc.h>
+#include <sys/resource.h>
+#include <boost/log/core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include "dynamic_encoding/decoding.h"
+#include "flatten_value.h"
+#include "message_arena.h"
+
+namespace {
+std::size_t allocations = 0;
+std::size_t allocated_bytes = 0;
+// Heap in use, and the most in use since peak_live_bytes was last reset.
+std::size_t live_bytes = 0;
+std::size_t peak_live_bytes = 0;
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocations++;
+  allocated_bytes += size;
+  if (void* p = std::malloc(size ? size : 1)) {
+    live_bytes += malloc_usable_size(p);
+    peak_live_bytes = std::max(peak_live_bytes, live_bytes);
+    return p;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept {
+  if (p) {
+    live_bytes -= malloc_usable_size(p);
+  }
+  std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+namespace {
+// Keeps the compiler from optimizing the results away.
+volatile std::size_t sink;
+
+// How FlattenValue() built the JSON messages before the arena.
+std::size_t FlattenValueWithStrings(std::string& topic,
+                                    const tao::json::value& value,
+                                    const PublishPolicy& policy,
+                                    std::vector<MqttWrapper::Message>& batch) {
+  const std::size_t index = batch.size();
+  batch.push_back(MqttWrapper::Message{topic, std::string(), policy.qos,
+                                       policy.retain, policy.expiry});
+  const std::size_t topic_size = topic.size();
+  std::string payload;
+  if (value.is_object()) {
+    payload += '{';
+    for (const auto& item : value.get_object()) {
+      if (payload.size() > 1) {
+        payload += ',';
+      }
+      // The keys here don't need escaping.
+      payload += '"';
+      payload += item.first;
+      payload += '"';
+      payload += ':';
+      topic += '/';
+      topic += item.first;
+      payload += batch[FlattenValueWithStrings(topic, item.second, policy,
+                                               batch)]
+                     .message;
+      topic.resize(topic_size);
+    }
+    payload += '}';
+  } else if (value.is_array()) {
+    const tao::json::value::array_t& array_value = value.get_array();
+    payload += '[';
+    for (std::size_t i = 0; i < array_value.size(); i++) {
+      if (i > 0) {
+        payload += ',';
+      }
+      topic += '/';
+      topic += std::to_string(i);
+      payload += batch[FlattenValueWithStrings(topic, array_value[i], policy,
+                                               batch)]
+                     .message;
+      topic.resize(topic_size);
+    }
+    payload += ']';
+  } else {
+    payload = tao::json::to_string(value);
+  }
+  batch[index].message = std::move(payload);
+  return index;
+}
+
+long PeakRssKiB() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+template <typename F>
+void Measure(const std::string& name, const std::string& only,
+             unsigned long iterations, F handle) {
+  if (!only.empty() && only != name) {
+    return;
+  }
+  const std::size_t allocations_before = allocations;
+  const std::size_t bytes_before = allocated_bytes;
+  const std::size_t live_before = live_bytes;
+  peak_live_bytes = live_bytes;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < iterations; i++) {
+    handle();
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::cout << std::left << std::setw(24) << name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(8)
+            << double(allocations - allocations_before) / iterations
+            << " allocs/msg" << std::setw(8)
+            << double(allocated_bytes - bytes_before) / iterations
+            << " bytes/msg" << std::setw(8) << elapsed.count() / iterations
+            << " us/msg" << std::setw(8) << peak_live_bytes - live_before
+            << " bytes peak heap" << std::setw(8) << PeakRssKiB()
+            << " KiB peak RSS" << std::endl;
+}
+}  // namespace
+
+int main(int argc, const char** argv) {
+  unsigned long iterations = argc > 1 ? std::stoul(argv[1]) : 100000;
+  const std::string only = argc > 2 ? argv[2] : "";
+  boost::log::core::get()->set_logging_enabled(false);
+
+  // Report Attributes from a temperature/humidity sensor: three records of
+  // attribute id and a variant.
+  const dynamic_encoding::ObjectType record_type{
+      {{"attributeId", zcl::DataType::uint16},
+       {"value", dynamic_encoding::VariantType{}}}};
+  const dynamic_encoding::ObjectType report_type{
+      {{"records", dynamic_encoding::ArrayType{0, record_type}}}};
+  const std::vector<std::uint8_t> payload{0x00, 0x00, 0x29, 0x3A, 0x08,
+                                          0x01, 0x00, 0x29, 0x10, 0x27,
+                                          0x02, 0x00, 0x21, 0xE8, 0x03};
+  const std::string topic = "AqaraHub/00158d0001234567/1/out/TemperatureMeasu"
+                            "rement/ReportAttributes";
+  const PublishPolicy policy{0, false};
+  dynamic_encoding::Context ctx;
+
+  auto decode = [&]() {
+    auto begin = payload.cbegin();
+    return dynamic_encoding::Decode(ctx, report_type, begin, payload.cend());
+  };
+
+  Measure("decode", only, iterations,
+          [&]() { sink = decode().is_object(); });
+  Measure("std::string", only, iterations, [&]() {
+    tao::json::value value = decode();
+    std::vector<MqttWrapper::Message> batch;
+    std::string topic_buffer = topic;
+    topic_buffer.reserve(topic.size() + 64);
+    FlattenValueWithStrings(topic_buffer, value, policy, batch);
+    sink = batch.size();
+  });
+  Measure("arena", only, iterations, [&]() {
+    tao::json::value value = decode();
+    std::vector<MqttWrapper::Message> batch;
+    MessageArena::Scope arena_scope;
+    ArenaString topic_buffer(topic.begin(), topic.end(),
+                             ArenaAllocator<char>(arena_scope.arena()));
+    topic_buffer.reserve(topic.size() + 64);
+    FlattenValue(topic_buffer, true, value, policy, batch);
+    sink = batch.size();
+  });
+  return 0;
+}
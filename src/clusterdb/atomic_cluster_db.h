@@ -0,0 +1,33 @@
+#ifndef _CLUSTERDB_ATOMIC_CLUSTER_DB_H_
+#define _CLUSTERDB_ATOMIC_CLUSTER_DB_H_
+#include <atomic>
+#include <memory>
+#include "clusterdb/cluster_db.h"
+
+namespace clusterdb {
+/**
+ * Holds the current ClusterDb snapshot, which may be swapped out at any time.
+ *
+ * Users should Load() a snapshot once per message and keep that shared_ptr
+ * (or aliasing pointers to its clusters and commands) for as long as they
+ * need it. A snapshot replaced by Store() stays alive until the last
+ * in-flight message using it is done.
+ */
+class AtomicClusterDb {
+ public:
+  explicit AtomicClusterDb(std::shared_ptr<const ClusterDb> initial)
+      : current_(std::move(initial)) {}
+
+  std::shared_ptr<const ClusterDb> Load() const {
+    return std::atomic_load(&current_);
+  }
+
+  void Store(std::shared_ptr<const ClusterDb> cluster_db) {
+    std::atomic_store(&current_, std::move(cluster_db));
+  }
+
+ private:
+  std::shared_ptr<const ClusterDb> current_;
+};
+}  // namespace clusterdb
+#endif  // _CLUSTERDB_ATOMIC_CLUSTER_DB_H_
@@ -1,6 +1,8 @@
 #ifndef _CLUSTERDB_ATTRIBUTE_INFO_H_
 #define _CLUSTERDB_ATTRIBUTE_INFO_H_
 #include <boost/optional.hpp>
+#include <string>
+#include <vector>
 #include "zcl/zcl.h"
 
 namespace clusterdb {
@@ -8,6 +10,8 @@ struct AttributeInfo {
   zcl::ZclAttributeId id;
   std::string name;
   boost::optional<zcl::DataType> datatype;
+  // For bitmaps, names of its bits by bit number. Unnamed bits are empty.
+  std::vector<std::string> bit_names;
 };
 }  // namespace clusterdb
 #endif  // _CLUSTERDB_ATTRIBUTE_INFO_H_
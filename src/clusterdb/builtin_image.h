@@ -0,0 +1,12 @@
+#ifndef _CLUSTERDB_BUILTIN_IMAGE_H_
+#define _CLUSTERDB_BUILTIN_IMAGE_H_
+#include <cstddef>
+#include <cstdint>
+
+namespace clusterdb {
+// Binary image of clusters.info, as generated at build-time by
+// compile_cluster_info. Only available when built with BUILTIN_CLUSTER_INFO.
+extern const std::uint8_t builtin_image[];
+extern const std::size_t builtin_image_size;
+}  // namespace clusterdb
+#endif  // _CLUSTERDB_BUILTIN_IMAGE_H_
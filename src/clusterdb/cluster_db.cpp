@@ -2,6 +2,7 @@
 #include <boost/property_tree/info_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <functional>
+#include <iostream>
 #include "clusterdb/searchable_list.h"
 #include "string_enum.h"
 #include "zcl/zcl_string_enum.h"
@@ -10,14 +11,121 @@ namespace clusterdb {
 struct ClusterDb::Context {
   SearchableList<ClusterInfo> clusters;
   SearchableList<CommandInfo> global_commands;
+
+  // Flat indexes over everything above, sorted by packed key. These are
+  // rebuilt by BuildIndexes() once parsing is done, after which the lists
+  // above no longer change and the pointers stay valid.
+  std::vector<std::pair<std::uint32_t, const CommandInfo*>> commands_by_key;
+  std::vector<std::pair<std::uint32_t, const AttributeInfo*>>
+      attributes_by_key;
 };
 
 namespace {
+std::uint32_t CommandKey(zcl::ZclClusterId cluster_id, bool is_global,
+                         zcl::ZclDirection direction,
+                         zcl::ZclCommandId command_id) {
+  if (is_global) {
+    // Global commands are the same for every cluster and either direction.
+    cluster_id = (zcl::ZclClusterId)0;
+    direction = zcl::ZclDirection::ClientToServer;
+  }
+  return (((std::uint32_t)cluster_id) << 16) |
+         ((is_global ? 1u : 0u) << 9) | (((std::uint32_t)direction) << 8) |
+         ((std::uint32_t)command_id);
+}
+
+std::uint32_t AttributeKey(zcl::ZclClusterId cluster_id,
+                           zcl::ZclAttributeId attribute_id) {
+  return (((std::uint32_t)cluster_id) << 16) | ((std::uint32_t)attribute_id);
+}
+
+template <typename T>
+const T* FindByKey(const std::vector<std::pair<std::uint32_t, const T*>>& index,
+                   std::uint32_t key) {
+  auto found = std::lower_bound(
+      index.begin(), index.end(), key,
+      [](const std::pair<std::uint32_t, const T*>& entry, std::uint32_t key) {
+        return entry.first < key;
+      });
+  if (found == index.end() || found->first != key) {
+    return nullptr;
+  }
+  return found->second;
+}
+
+void BuildIndexes(ClusterDb::Context& ctx) {
+  ctx.commands_by_key.clear();
+  ctx.attributes_by_key.clear();
+  for (const auto& command : ctx.global_commands) {
+    ctx.commands_by_key.emplace_back(
+        CommandKey((zcl::ZclClusterId)0, true,
+                   zcl::ZclDirection::ClientToServer, command.id),
+        &command);
+  }
+  for (const auto& cluster : ctx.clusters) {
+    for (const auto& command : cluster.commands_clientToServer) {
+      ctx.commands_by_key.emplace_back(
+          CommandKey(cluster.id, false, zcl::ZclDirection::ClientToServer,
+                     command.id),
+          &command);
+    }
+    for (const auto& command : cluster.commands_serverToClient) {
+      ctx.commands_by_key.emplace_back(
+          CommandKey(cluster.id, false, zcl::ZclDirection::ServerToClient,
+                     command.id),
+          &command);
+    }
+    for (const auto& attribute : cluster.attributes) {
+      ctx.attributes_by_key.emplace_back(AttributeKey(cluster.id, attribute.id),
+                                         &attribute);
+    }
+  }
+  auto by_key = [](const auto& a, const auto& b) { return a.first < b.first; };
+  std::sort(ctx.commands_by_key.begin(), ctx.commands_by_key.end(), by_key);
+  std::sort(ctx.attributes_by_key.begin(), ctx.attributes_by_key.end(),
+            by_key);
+  ctx.commands_by_key.shrink_to_fit();
+  ctx.attributes_by_key.shrink_to_fit();
+}
+
 bool ParseTypeFromPTree(dynamic_encoding::AnyType& type,
                         const std::string& type_name,
                         const boost::property_tree::ptree& tree,
                         std::function<std::string(std::string)> name_mangler);
 
+/** Parses bit number & name pairs, e.g. 0x0 "Alarm1" */
+bool ParseBitNamesFromPTree(
+    std::vector<std::string>& bit_names, zcl::DataType datatype,
+    const boost::property_tree::ptree& tree,
+    std::function<std::string(std::string)> name_mangler) {
+  std::size_t bits =
+      8 * (1 + ((std::size_t)datatype - (std::size_t)zcl::DataType::map8));
+  for (const auto& entry : tree) {
+    std::size_t end_bit;
+    unsigned long bit = std::stoul(entry.first, &end_bit, 0);
+    if (end_bit != entry.first.size()) {
+      LOG("ClusterDb", critical)
+          << "Unable to fully parse bit number " << entry.first;
+      return false;
+    }
+    if (bit >= bits) {
+      LOG("ClusterDb", critical)
+          << "Bit number " << entry.first << " does not fit in "
+          << enum_to_string(datatype);
+      return false;
+    }
+    if (bit_names.size() <= bit) {
+      bit_names.resize(bit + 1);
+    }
+    if (!bit_names[bit].empty()) {
+      LOG("ClusterDb", critical) << "Duplicate bit number " << entry.first;
+      return false;
+    }
+    bit_names[bit] = name_mangler(entry.second.data());
+  }
+  return true;
+}
+
 bool ParseObjectTypeFromPTree(
     dynamic_encoding::ObjectType& type, const boost::property_tree::ptree& tree,
     std::function<std::string(std::string)> name_mangler) {
@@ -100,6 +208,15 @@ bool ParseTypeFromPTree(dynamic_encoding::AnyType& type,
     return true;
   }
   if (auto zcl_datatype = string_to_enum<zcl::DataType>(type_name)) {
+    if (dynamic_encoding::IsBitmap(*zcl_datatype) && !tree.empty()) {
+      auto parsed_type = dynamic_encoding::BitmapType{*zcl_datatype, {}};
+      if (!ParseBitNamesFromPTree(parsed_type.bit_names, *zcl_datatype, tree,
+                                  name_mangler)) {
+        return false;
+      }
+      type = parsed_type;
+      return true;
+    }
     type = *zcl_datatype;
     return true;
   }
@@ -176,6 +293,19 @@ bool ParseArgumentListFromPTree(
     } else {
       attribute_info.datatype = boost::none;
     }
+    if (auto bits = entry.second.get_child_optional("bits")) {
+      if (!attribute_info.datatype ||
+          !dynamic_encoding::IsBitmap(*attribute_info.datatype)) {
+        LOG("ClusterDb", critical) << "Attribute " << s_attribute_id
+                                   << " has bit names, but is no bitmap";
+        return false;
+      }
+      if (!ParseBitNamesFromPTree(attribute_info.bit_names,
+                                  *attribute_info.datatype, *bits,
+                                  name_mangler)) {
+        return false;
+      }
+    }
     if (!attributes.Add(std::move(attribute_info))) {
       return false;
     }
@@ -219,9 +349,255 @@ bool ParseClusterInfoFromPTree(
   return true;
 }
 
+// Binary image format, all integers little-endian:
+//   image   := "AQCI" u8:version u16:count command* u16:count cluster*
+//   cluster := u16:id string u16:count attribute* u16:count command*
+//              u16:count command*  (serverToClient, then clientToServer)
+//   attribute := u16:id string u8:has_type u8:type bits
+//   command := u8:id string u8:is_global object
+//   object  := u16:count (string type)*
+//   type    := u8:tag [u8:datatype | object | u8:length_size type | type |
+//                      u8:datatype bits]
+//   bits    := u16:count string*  (names by bit number, empty if unnamed)
+//   string  := u16:length bytes
+const char kImageMagic[4] = {'A', 'Q', 'C', 'I'};
+const std::uint8_t kImageVersion = 2;
+
+enum class ImageTypeTag : std::uint8_t {
+  Variant = 0,
+  XiaomiFF01 = 1,
+  DataType = 2,
+  Object = 3,
+  Array = 4,
+  ErrorOr = 5,
+  Bitmap = 6
+};
+
+class ImageWriter {
+ public:
+  typedef void result_type;
+
+  ImageWriter(std::ostream& stream) : stream_(stream) {}
+
+  void WriteU8(std::uint8_t value) { stream_.put((char)value); }
+  void WriteU16(std::uint16_t value) {
+    WriteU8(value & 0xFF);
+    WriteU8(value >> 8);
+  }
+  void WriteCount(std::size_t count) {
+    if (count > std::numeric_limits<std::uint16_t>::max()) {
+      throw std::runtime_error("Too many entries for cluster info image");
+    }
+    WriteU16((std::uint16_t)count);
+  }
+  void WriteString(const std::string& value) {
+    WriteCount(value.size());
+    stream_.write(value.data(), value.size());
+  }
+  void WriteBitNames(const std::vector<std::string>& bit_names) {
+    WriteCount(bit_names.size());
+    for (const auto& name : bit_names) {
+      WriteString(name);
+    }
+  }
+
+  void operator()(const dynamic_encoding::VariantType& type) {
+    WriteU8((std::uint8_t)ImageTypeTag::Variant);
+  }
+  void operator()(const dynamic_encoding::XiaomiFF01Type& type) {
+    WriteU8((std::uint8_t)ImageTypeTag::XiaomiFF01);
+  }
+  void operator()(const zcl::DataType& type) {
+    WriteU8((std::uint8_t)ImageTypeTag::DataType);
+    WriteU8((std::uint8_t)type);
+  }
+  void operator()(const dynamic_encoding::ObjectType& type) {
+    WriteU8((std::uint8_t)ImageTypeTag::Object);
+    WriteObject(type);
+  }
+  void operator()(const dynamic_encoding::ArrayType& type) {
+    WriteU8((std::uint8_t)ImageTypeTag::Array);
+    WriteU8((std::uint8_t)type.length_size);
+    type.element_type.apply_visitor(*this);
+  }
+  void operator()(const dynamic_encoding::ErrorOrType& type) {
+    WriteU8((std::uint8_t)ImageTypeTag::ErrorOr);
+    type.success_type.apply_visitor(*this);
+  }
+  void operator()(const dynamic_encoding::BitmapType& type) {
+    WriteU8((std::uint8_t)ImageTypeTag::Bitmap);
+    WriteU8((std::uint8_t)type.datatype);
+    WriteBitNames(type.bit_names);
+  }
+
+  void WriteObject(const dynamic_encoding::ObjectType& object) {
+    WriteCount(object.properties.size());
+    for (const auto& property : object.properties) {
+      WriteString(property.name);
+      property.type.apply_visitor(*this);
+    }
+  }
+
+  void WriteCommands(const SearchableList<CommandInfo>& commands) {
+    WriteCount(commands.size());
+    for (const auto& command : commands) {
+      WriteU8((std::uint8_t)command.id);
+      WriteString(command.name);
+      WriteU8(command.is_global ? 1 : 0);
+      WriteObject(command.data);
+    }
+  }
+
+  void WriteCluster(const ClusterInfo& cluster) {
+    WriteU16((std::uint16_t)cluster.id);
+    WriteString(cluster.name);
+    WriteCount(cluster.attributes.size());
+    for (const auto& attribute : cluster.attributes) {
+      WriteU16((std::uint16_t)attribute.id);
+      WriteString(attribute.name);
+      WriteU8(attribute.datatype ? 1 : 0);
+      WriteU8(attribute.datatype ? (std::uint8_t)*attribute.datatype : 0);
+      WriteBitNames(attribute.bit_names);
+    }
+    WriteCommands(cluster.commands_serverToClient);
+    WriteCommands(cluster.commands_clientToServer);
+  }
+
+ private:
+  std::ostream& stream_;
+};
+
+class ImageReader {
+ public:
+  ImageReader(const std::uint8_t* begin, const std::uint8_t* end,
+              std::function<std::string(std::string)> name_mangler)
+      : current_(begin), end_(end), name_mangler_(std::move(name_mangler)) {}
+
+  bool AtEnd() const { return current_ == end_; }
+
+  std::uint8_t ReadU8() {
+    if (current_ == end_) {
+      throw std::runtime_error("Unexpected end of cluster info image");
+    }
+    return *(current_++);
+  }
+  std::uint16_t ReadU16() {
+    std::uint16_t low = ReadU8();
+    return low | (((std::uint16_t)ReadU8()) << 8);
+  }
+  std::string ReadName() {
+    std::size_t length = ReadU16();
+    if ((std::size_t)(end_ - current_) < length) {
+      throw std::runtime_error("Unexpected end of cluster info image");
+    }
+    std::string name((const char*)current_, length);
+    current_ += length;
+    return name_mangler_(std::move(name));
+  }
+  std::vector<std::string> ReadBitNames() {
+    std::vector<std::string> bit_names(ReadU16());
+    for (auto& name : bit_names) {
+      name = ReadName();
+    }
+    return bit_names;
+  }
+
+  dynamic_encoding::AnyType ReadType() {
+    switch ((ImageTypeTag)ReadU8()) {
+      case ImageTypeTag::Variant:
+        return dynamic_encoding::VariantType{};
+      case ImageTypeTag::XiaomiFF01:
+        return dynamic_encoding::XiaomiFF01Type{};
+      case ImageTypeTag::DataType:
+        return (zcl::DataType)ReadU8();
+      case ImageTypeTag::Object:
+        return ReadObject();
+      case ImageTypeTag::Array: {
+        dynamic_encoding::ArrayType type;
+        type.length_size = ReadU8();
+        type.element_type = ReadType();
+        return type;
+      }
+      case ImageTypeTag::ErrorOr: {
+        dynamic_encoding::ErrorOrType type;
+        type.success_type = ReadType();
+        return type;
+      }
+      case ImageTypeTag::Bitmap: {
+        dynamic_encoding::BitmapType type;
+        type.datatype = (zcl::DataType)ReadU8();
+        type.bit_names = ReadBitNames();
+        return type;
+      }
+      default:
+        throw std::runtime_error("Unknown type tag in cluster info image");
+    }
+  }
+
+  dynamic_encoding::ObjectType ReadObject() {
+    dynamic_encoding::ObjectType object;
+    std::size_t count = ReadU16();
+    object.properties.reserve(count);
+    while (count--) {
+      dynamic_encoding::ObjectEntry property;
+      property.name = ReadName();
+      property.type = ReadType();
+      object.properties.emplace_back(std::move(property));
+    }
+    return object;
+  }
+
+  void ReadCommands(SearchableList<CommandInfo>& commands) {
+    std::size_t count = ReadU16();
+    while (count--) {
+      CommandInfo command;
+      command.id = (zcl::ZclCommandId)ReadU8();
+      command.name = ReadName();
+      command.is_global = (ReadU8() != 0);
+      command.data = ReadObject();
+      if (!commands.Add(std::move(command))) {
+        throw std::runtime_error("Duplicate command in cluster info image");
+      }
+    }
+  }
+
+  ClusterInfo ReadCluster() {
+    ClusterInfo cluster;
+    cluster.id = (zcl::ZclClusterId)ReadU16();
+    cluster.name = ReadName();
+    std::size_t count = ReadU16();
+    while (count--) {
+      AttributeInfo attribute;
+      attribute.id = (zcl::ZclAttributeId)ReadU16();
+      attribute.name = ReadName();
+      bool has_datatype = (ReadU8() != 0);
+      zcl::DataType datatype = (zcl::DataType)ReadU8();
+      if (has_datatype) {
+        attribute.datatype = datatype;
+      }
+      attribute.bit_names = ReadBitNames();
+      if (!cluster.attributes.Add(std::move(attribute))) {
+        throw std::runtime_error("Duplicate attribute in cluster info image");
+      }
+    }
+    ReadCommands(cluster.commands_serverToClient);
+    ReadCommands(cluster.commands_clientToServer);
+    return cluster;
+  }
+
+ private:
+  const std::uint8_t* current_;
+  const std::uint8_t* end_;
+  std::function<std::string(std::string)> name_mangler_;
+};
+
 bool ParseFromPTree(const std::unique_ptr<ClusterDb::Context>& ctx,
                     const boost::property_tree::ptree& tree,
                     std::function<std::string(std::string)> name_mangler) {
+  // Adding to the lists below may move their items around, so don't leave
+  // the old indexes dangling if parsing fails half-way.
+  ctx->commands_by_key.clear();
+  ctx->attributes_by_key.clear();
   for (const auto& cluster_entry : tree) {
     if (cluster_entry.first == "global") {
       if (!ParseCommandListFromPTree(ctx->global_commands, true,
@@ -258,6 +634,7 @@ bool ParseFromPTree(const std::unique_ptr<ClusterDb::Context>& ctx,
       }
     }
   }
+  BuildIndexes(*ctx);
   return true;
 }
 }  // namespace
@@ -266,7 +643,7 @@ ClusterDb::ClusterDb() : ctx_(std::make_unique<ClusterDb::Context>()) {}
 ClusterDb::~ClusterDb() {}
 
 boost::optional<const ClusterInfo&> ClusterDb::ClusterByName(
-    const std::string& name) const {
+    boost::string_view name) const {
   return ctx_->clusters.FindByName(name);
 }
 boost::optional<const ClusterInfo&> ClusterDb::ClusterById(
@@ -275,7 +652,7 @@ boost::optional<const ClusterInfo&> ClusterDb::ClusterById(
 }
 
 boost::optional<const CommandInfo&> ClusterDb::GlobalCommandByName(
-    const std::string& name) const {
+    boost::string_view name) const {
   return ctx_->global_commands.FindByName(name);
 }
 
@@ -286,7 +663,7 @@ boost::optional<const CommandInfo&> ClusterDb::GlobalCommandById(
 
 boost::optional<const CommandInfo&> ClusterDb::CommandByName(
     const zcl::ZclClusterId& cluster_id, zcl::ZclDirection direction,
-    const std::string& name) const {
+    boost::string_view name) const {
   auto global_found = GlobalCommandByName(name);
   if (global_found) {
     return global_found;
@@ -308,21 +685,21 @@ boost::optional<const CommandInfo&> ClusterDb::CommandByName(
 boost::optional<const CommandInfo&> ClusterDb::CommandById(
     const zcl::ZclClusterId& cluster_id, const zcl::ZclCommandId& id,
     bool is_global, zcl::ZclDirection direction) const {
-  if (is_global) {
-    return GlobalCommandById(id);
+  if (const CommandInfo* found =
+          FindByKey(ctx_->commands_by_key,
+                    CommandKey(cluster_id, is_global, direction, id))) {
+    return *found;
   }
-  auto cluster_found = ClusterById(cluster_id);
-  if (!cluster_found) {
-    return boost::none;
-  }
-  switch (direction) {
-    case zcl::ZclDirection::ServerToClient:
-      return cluster_found->commands_serverToClient.FindById(id);
-    case zcl::ZclDirection::ClientToServer:
-      return cluster_found->commands_clientToServer.FindById(id);
-    default:
-      return boost::none;
+  return boost::none;
+}
+
+boost::optional<const AttributeInfo&> ClusterDb::AttributeById(
+    const zcl::ZclClusterId& cluster_id, const zcl::ZclAttributeId& id) const {
+  if (const AttributeInfo* found =
+          FindByKey(ctx_->attributes_by_key, AttributeKey(cluster_id, id))) {
+    return *found;
   }
+  return boost::none;
 }
 
 bool ClusterDb::ParseFromFile(
@@ -333,6 +710,59 @@ bool ClusterDb::ParseFromFile(
   return ParseFromPTree(this->ctx_, tree, name_mangler);
 }
 
+bool ClusterDb::ParseFromImage(
+    const std::uint8_t* data, std::size_t size,
+    std::function<std::string(std::string)> name_mangler) {
+  ctx_->commands_by_key.clear();
+  ctx_->attributes_by_key.clear();
+  try {
+    ImageReader reader(data, data + size, name_mangler);
+    for (char expected : kImageMagic) {
+      if (reader.ReadU8() != (std::uint8_t)expected) {
+        LOG("ClusterDb", critical) << "Not a cluster info image";
+        return false;
+      }
+    }
+    std::uint8_t version = reader.ReadU8();
+    if (version != kImageVersion) {
+      LOG("ClusterDb", critical)
+          << "Unsupported cluster info image version " << (unsigned int)version;
+      return false;
+    }
+    reader.ReadCommands(ctx_->global_commands);
+    std::size_t count = reader.ReadU16();
+    while (count--) {
+      if (!ctx_->clusters.Add(reader.ReadCluster())) {
+        LOG("ClusterDb", critical) << "Duplicate cluster in image";
+        return false;
+      }
+    }
+    if (!reader.AtEnd()) {
+      LOG("ClusterDb", critical) << "Trailing data in cluster info image";
+      return false;
+    }
+  } catch (const std::exception& ex) {
+    LOG("ClusterDb", critical)
+        << "Unable to read cluster info image: " << ex.what();
+    return false;
+  }
+  BuildIndexes(*ctx_);
+  return true;
+}
+
+void ClusterDb::WriteImage(std::ostream& stream) const {
+  ImageWriter writer(stream);
+  for (char magic : kImageMagic) {
+    writer.WriteU8((std::uint8_t)magic);
+  }
+  writer.WriteU8(kImageVersion);
+  writer.WriteCommands(ctx_->global_commands);
+  writer.WriteCount(ctx_->clusters.size());
+  for (const auto& cluster : ctx_->clusters) {
+    writer.WriteCluster(cluster);
+  }
+}
+
 bool ClusterDb::ParseFromStream(
     std::istream& stream,
     std::function<std::string(std::string)> name_mangler) {
@@ -1,5 +1,6 @@
 #ifndef _CLUSTERDB_CLUSTER_DB_H_
 #define _CLUSTERDB_CLUSTER_DB_H_
+#include <boost/utility/string_view.hpp>
 #include "clusterdb/cluster_info.h"
 #include "clusterdb/command_info.h"
 
@@ -9,24 +10,33 @@ class ClusterDb {
   ClusterDb();
   ~ClusterDb();
   boost::optional<const ClusterInfo&> ClusterByName(
-      const std::string& name) const;
+      boost::string_view name) const;
   boost::optional<const ClusterInfo&> ClusterById(
       const zcl::ZclClusterId& id) const;
   boost::optional<const CommandInfo&> GlobalCommandByName(
-      const std::string& name) const;
+      boost::string_view name) const;
   boost::optional<const CommandInfo&> GlobalCommandById(
       const zcl::ZclCommandId& id) const;
   boost::optional<const CommandInfo&> CommandByName(
       const zcl::ZclClusterId& cluster_id, zcl::ZclDirection direction,
-      const std::string& name) const;
+      boost::string_view name) const;
   boost::optional<const CommandInfo&> CommandById(
       const zcl::ZclClusterId& cluster_id, const zcl::ZclCommandId& id,
       bool is_global, zcl::ZclDirection direction) const;
+  boost::optional<const AttributeInfo&> AttributeById(
+      const zcl::ZclClusterId& cluster_id,
+      const zcl::ZclAttributeId& id) const;
 
   bool ParseFromFile(const std::string& filename,
                      std::function<std::string(std::string)> name_mangler);
   bool ParseFromStream(std::istream& stream,
                        std::function<std::string(std::string)> name_mangler);
+  /** Loads a binary image previously created with WriteImage. This skips the
+   * property-tree parsing entirely, and is used for the copy of clusters.info
+   * that is compiled into the binary. */
+  bool ParseFromImage(const std::uint8_t* data, std::size_t size,
+                      std::function<std::string(std::string)> name_mangler);
+  void WriteImage(std::ostream& stream) const;
 
   struct Context;
 
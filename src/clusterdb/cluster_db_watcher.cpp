@@ -0,0 +1,156 @@
+#include "clusterdb/cluster_db_watcher.h"
+#include <sys/inotify.h>
+#include <stlab/concurrency/default_executor.hpp>
+#include <stlab/concurrency/future.hpp>
+#include "asio_executor.h"
+#include "logging.h"
+
+namespace clusterdb {
+namespace {
+// Editors tend to touch a file several times when saving, so wait for things
+// to settle down before reloading.
+const boost::posix_time::milliseconds kDebounceDelay(500);
+}  // namespace
+
+ClusterDbWatcher::ClusterDbWatcher(
+    boost::asio::io_service& io_service, std::string filename,
+    std::function<std::string(std::string)> name_mangler,
+    std::shared_ptr<AtomicClusterDb> target)
+    : io_service_(io_service),
+      filename_(std::move(filename)),
+      name_mangler_(std::move(name_mangler)),
+      target_(std::move(target)),
+      inotify_(io_service),
+      watch_descriptor_(-1),
+      debounce_timer_(io_service) {
+  std::size_t slash = filename_.rfind('/');
+  if (slash == std::string::npos) {
+    directory_ = ".";
+    basename_ = filename_;
+  } else {
+    directory_ = filename_.substr(0, slash + 1);
+    basename_ = filename_.substr(slash + 1);
+  }
+}
+
+ClusterDbWatcher::~ClusterDbWatcher() {}
+
+std::shared_ptr<ClusterDbWatcher> ClusterDbWatcher::Create(
+    boost::asio::io_service& io_service, std::string filename,
+    std::function<std::string(std::string)> name_mangler,
+    std::shared_ptr<AtomicClusterDb> target) {
+  std::shared_ptr<ClusterDbWatcher> watcher(
+      new ClusterDbWatcher(io_service, std::move(filename),
+                           std::move(name_mangler), std::move(target)));
+  watcher->StartWatching();
+  return watcher;
+}
+
+void ClusterDbWatcher::StartWatching() {
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    throw boost::system::system_error(
+        boost::system::error_code(errno, boost::system::system_category()),
+        "inotify_init1");
+  }
+  inotify_.assign(fd);
+  watch_descriptor_ = inotify_add_watch(
+      fd, directory_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+  if (watch_descriptor_ < 0) {
+    throw boost::system::system_error(
+        boost::system::error_code(errno, boost::system::system_category()),
+        "inotify_add_watch");
+  }
+  LOG("ClusterDbWatcher", info) << "Watching '" << filename_ << "' for changes";
+  StartRead();
+}
+
+void ClusterDbWatcher::StartRead() {
+  std::weak_ptr<ClusterDbWatcher> weak_this(shared_from_this());
+  inotify_.async_read_some(
+      boost::asio::buffer(buffer_),
+      [weak_this](const boost::system::error_code& ec,
+                  std::size_t bytes_transferred) {
+        if (auto _this = weak_this.lock()) {
+          _this->ReadHandler(ec, bytes_transferred);
+        }
+      });
+}
+
+void ClusterDbWatcher::ReadHandler(const boost::system::error_code& ec,
+                                   std::size_t bytes_transferred) {
+  if (ec) {
+    if (ec != boost::asio::error::operation_aborted) {
+      LOG("ClusterDbWatcher", error)
+          << "Unable to read inotify events: " << ec.message();
+    }
+    return;
+  }
+  bool relevant = false;
+  std::size_t offset = 0;
+  while (offset + sizeof(inotify_event) <= bytes_transferred) {
+    const inotify_event* event =
+        reinterpret_cast<const inotify_event*>(buffer_.data() + offset);
+    if (event->wd == watch_descriptor_ && event->len > 0 &&
+        basename_ == event->name) {
+      relevant = true;
+    }
+    offset += sizeof(inotify_event) + event->len;
+  }
+  if (relevant) {
+    std::weak_ptr<ClusterDbWatcher> weak_this(shared_from_this());
+    debounce_timer_.expires_from_now(kDebounceDelay);
+    debounce_timer_.async_wait(
+        [weak_this](const boost::system::error_code& ec) {
+          if (auto _this = weak_this.lock()) {
+            _this->DebounceHandler(ec);
+          }
+        });
+  }
+  StartRead();
+}
+
+void ClusterDbWatcher::DebounceHandler(const boost::system::error_code& ec) {
+  if (ec == boost::asio::error::operation_aborted) {
+    // Restarted by a newer event
+    return;
+  }
+  Reload();
+}
+
+void ClusterDbWatcher::Reload() {
+  LOG("ClusterDbWatcher", info) << "'" << filename_ << "' changed, reloading";
+  std::weak_ptr<ClusterDbWatcher> weak_this(shared_from_this());
+  std::string filename(filename_);
+  auto name_mangler = name_mangler_;
+  // Parsing takes a while, so do it off the io_service, and only hop back to
+  // swap in the result. Messages being handled keep their old snapshot.
+  stlab::async(stlab::default_executor,
+               [filename, name_mangler]() {
+                 auto cluster_db = std::make_shared<ClusterDb>();
+                 if (!cluster_db->ParseFromFile(filename, name_mangler)) {
+                   throw std::runtime_error("Unable to parse '" + filename +
+                                            "'");
+                 }
+                 return std::shared_ptr<const ClusterDb>(std::move(cluster_db));
+               })
+      .then(AsioExecutor(io_service_),
+            [weak_this](std::shared_ptr<const ClusterDb> cluster_db) {
+              if (auto _this = weak_this.lock()) {
+                _this->target_->Store(std::move(cluster_db));
+                LOG("ClusterDbWatcher", info) << "Cluster information reloaded";
+                _this->on_reload_();
+              }
+            })
+      .recover([](auto f) {
+        try {
+          f.get_try();
+        } catch (const std::exception& ex) {
+          LOG("ClusterDbWatcher", error)
+              << "Reload failed, keeping old cluster information: "
+              << ex.what();
+        }
+      })
+      .detach();
+}
+}  // namespace clusterdb
@@ -0,0 +1,55 @@
+#ifndef _CLUSTERDB_CLUSTER_DB_WATCHER_H_
+#define _CLUSTERDB_CLUSTER_DB_WATCHER_H_
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/signals2/signal.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include "clusterdb/atomic_cluster_db.h"
+
+namespace clusterdb {
+/**
+ * Watches a cluster info file using inotify, and whenever it changes parses it
+ * on a background thread and swaps the result into an AtomicClusterDb.
+ *
+ * The directory containing the file is watched rather than the file itself,
+ * so editors that save by writing a new file and renaming it over the old
+ * one are picked up too.
+ */
+class ClusterDbWatcher : public std::enable_shared_from_this<ClusterDbWatcher> {
+ public:
+  ~ClusterDbWatcher();
+
+  static std::shared_ptr<ClusterDbWatcher> Create(
+      boost::asio::io_service& io_service, std::string filename,
+      std::function<std::string(std::string)> name_mangler,
+      std::shared_ptr<AtomicClusterDb> target);
+
+  // Called on the io_service after a new snapshot was swapped in.
+  boost::signals2::signal<void()> on_reload_;
+
+ private:
+  ClusterDbWatcher(boost::asio::io_service& io_service, std::string filename,
+                   std::function<std::string(std::string)> name_mangler,
+                   std::shared_ptr<AtomicClusterDb> target);
+  void StartWatching();
+  void StartRead();
+  void ReadHandler(const boost::system::error_code& ec,
+                   std::size_t bytes_transferred);
+  void DebounceHandler(const boost::system::error_code& ec);
+  void Reload();
+
+  boost::asio::io_service& io_service_;
+  const std::string filename_;
+  std::function<std::string(std::string)> name_mangler_;
+  std::shared_ptr<AtomicClusterDb> target_;
+  boost::asio::posix::stream_descriptor inotify_;
+  int watch_descriptor_;
+  std::string directory_;
+  std::string basename_;
+  boost::asio::deadline_timer debounce_timer_;
+  std::array<char, 4096> buffer_;
+};
+}  // namespace clusterdb
+#endif  // _CLUSTERDB_CLUSTER_DB_WATCHER_H_
@@ -1,57 +1,95 @@
 #ifndef _CLUSTERDB_SEARCHABLE_LIST_H_
 #define _CLUSTERDB_SEARCHABLE_LIST_H_
+#include <algorithm>
 #include <boost/format.hpp>
 #include <boost/optional.hpp>
-#include <list>
-#include <map>
+#include <boost/utility/string_view.hpp>
+#include <vector>
 #include "logging.h"
 
 namespace clusterdb {
+/**
+ * List of items that can be looked up both by ID and by name.
+ *
+ * Items are stored contiguously in insertion order, and both indexes are
+ * sorted flat arrays of (key, index) pairs, so lookups are a binary search
+ * over a small contiguous array and never allocate. Name lookups take a
+ * boost::string_view, so callers holding a substring of e.g. an MQTT topic
+ * don't have to build a std::string first.
+ */
 template <typename T>
 class SearchableList {
  public:
   typedef T Item;
   typedef decltype(T::id) Id;
-  typedef decltype(T::name) Name;
+  typedef typename std::vector<Item>::const_iterator const_iterator;
 
   bool Add(Item item) {
-    if (by_id_.count(item.id) > 0) {
+    auto id_position = LowerBoundId(item.id);
+    if (id_position != by_id_.end() && id_position->first == item.id) {
       LOG("SearchableList", warning)
           << "Duplicate ID "
           << boost::str(boost::format("0x%X") % (unsigned int)item.id);
       return false;
     }
-    if (by_name_.count(item.name) > 0) {
+    auto name_position = LowerBoundName(item.name);
+    if (name_position != by_name_.end() &&
+        items_[*name_position].name == item.name) {
       LOG("SearchableList", warning) << "Duplicate name '" << item.name << "'";
       return false;
     }
+    std::size_t index = items_.size();
+    by_id_.emplace(id_position, item.id, index);
+    by_name_.emplace(name_position, index);
     items_.emplace_back(std::move(item));
-    Item& ref = items_.back();
-    by_id_[ref.id] = &ref;
-    by_name_[ref.name] = &ref;
     return true;
   }
 
-  boost::optional<const Item&> FindByName(const Name& name) const {
-    auto found = by_name_.find(name);
-    if (found == by_name_.end()) {
+  boost::optional<const Item&> FindByName(boost::string_view name) const {
+    auto found = LowerBoundName(name);
+    if (found == by_name_.end() || items_[*found].name != name) {
       return boost::none;
     }
-    return *found->second;
+    return items_[*found];
   }
 
   boost::optional<const Item&> FindById(const Id& id) const {
-    auto found = by_id_.find(id);
-    if (found == by_id_.end()) {
+    auto found = LowerBoundId(id);
+    if (found == by_id_.end() || found->first != id) {
       return boost::none;
     }
-    return *found->second;
+    return items_[found->second];
   }
 
+  std::size_t size() const { return items_.size(); }
+  const_iterator begin() const { return items_.begin(); }
+  const_iterator end() const { return items_.end(); }
+
  private:
-  std::list<Item> items_;
-  std::map<Id, Item*> by_id_;
-  std::map<Name, Item*> by_name_;
+  // Items in order of insertion, as they appeared in the cluster info file.
+  std::vector<Item> items_;
+  // (id, index into items_), sorted by id.
+  std::vector<std::pair<Id, std::size_t>> by_id_;
+  // Indexes into items_, sorted by name.
+  std::vector<std::size_t> by_name_;
+
+  typename std::vector<std::pair<Id, std::size_t>>::const_iterator LowerBoundId(
+      const Id& id) const {
+    return std::lower_bound(
+        by_id_.begin(), by_id_.end(), id,
+        [](const std::pair<Id, std::size_t>& entry, const Id& id) {
+          return entry.first < id;
+        });
+  }
+
+  std::vector<std::size_t>::const_iterator LowerBoundName(
+      boost::string_view name) const {
+    return std::lower_bound(by_name_.begin(), by_name_.end(), name,
+                            [this](std::size_t index, boost::string_view name) {
+                              return boost::string_view(items_[index].name) <
+                                     name;
+                            });
+  }
 };
 }  // namespace clusterdb
 #endif  // _CLUSTERDB_SEARCHABLE_LIST_H_
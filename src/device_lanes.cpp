@@ -0,0 +1,13 @@
+#include "device_lanes.h"
+
+DeviceLanes::DeviceLanes(boost::asio::io_service& io_service,
+                         stlab::executor_t pool)
+    : io_service_(io_service), pool_(std::move(pool)) {}
+
+stlab::serial_queue_t& DeviceLanes::Lane(znp::IEEEAddress device) {
+  auto it = lanes_.find(device);
+  if (it == lanes_.end()) {
+    it = lanes_.emplace(device, stlab::serial_queue_t(pool_)).first;
+  }
+  return it->second;
+}
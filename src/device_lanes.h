@@ -0,0 +1,46 @@
+#ifndef _DEVICE_LANES_H_
+#define _DEVICE_LANES_H_
+#include <boost/asio.hpp>
+#include <stlab/concurrency/serial_queue.hpp>
+#include <unordered_map>
+#include <utility>
+#include "asio_executor.h"
+#include "znp/znp.h"
+
+/**
+ * Runs CPU-heavy work, like decoding and encoding payloads, on a thread pool,
+ * and hands the results back to the io_service.
+ *
+ * Work for one device runs in a serial lane, so its results are delivered in
+ * the order the work was posted. Work for different devices runs in parallel.
+ *
+ * Only to be used from the io_service thread. The work itself must not touch
+ * anything else owned by that thread.
+ */
+class DeviceLanes {
+ public:
+  DeviceLanes(boost::asio::io_service& io_service, stlab::executor_t pool);
+
+  /** Runs work() on the pool, then deliver(work()) on the io_service. */
+  template <typename Work, typename Deliver>
+  void Post(znp::IEEEAddress device, Work work, Deliver deliver) {
+    AsioExecutor executor(io_service_);
+    Lane(device)([work, deliver, executor]() {
+      auto result = work();
+      executor([deliver, result = std::move(result)]() mutable {
+        deliver(std::move(result));
+      });
+    })
+        .detach();
+  }
+
+  std::size_t size() const { return lanes_.size(); }
+
+ private:
+  stlab::serial_queue_t& Lane(znp::IEEEAddress device);
+
+  boost::asio::io_service& io_service_;
+  stlab::executor_t pool_;
+  std::unordered_map<znp::IEEEAddress, stlab::serial_queue_t> lanes_;
+};
+#endif  // _DEVICE_LANES_H_
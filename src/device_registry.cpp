@@ -0,0 +1,89 @@
+#include "device_registry.h"
+#include <boost/format.hpp>
+
+namespace {
+std::uint64_t CommandTopicKey(uint8_t endpoint, zcl::ZclDirection direction,
+                              zcl::ZclClusterId cluster_id, bool is_global,
+                              zcl::ZclCommandId command_id) {
+  return (((std::uint64_t)endpoint) << 32) |
+         (((std::uint64_t)cluster_id) << 16) |
+         (((std::uint64_t)(is_global ? 1 : 0)) << 9) |
+         (((std::uint64_t)direction) << 8) | ((std::uint64_t)command_id);
+}
+}  // namespace
+
+DeviceRegistry::DeviceRegistry(std::string mqtt_prefix)
+    : mqtt_prefix_(std::move(mqtt_prefix)) {}
+
+DeviceRegistry::Device& DeviceRegistry::Get(znp::IEEEAddress address) {
+  auto found = devices_.find(address);
+  if (found != devices_.end()) {
+    return found->second;
+  }
+  Device& device = devices_[address];
+  device.address = address;
+  device.topic_prefix =
+      boost::str(boost::format("%s%016X/") % mqtt_prefix_ % address);
+  return device;
+}
+
+void DeviceRegistry::SetShortAddress(znp::IEEEAddress address,
+                                     znp::ShortAddress short_address) {
+  Device& device = Get(address);
+  if (device.short_address == short_address) {
+    return;
+  }
+  if (device.short_address) {
+    // Device rejoined with a new short address.
+    auto found = short_addresses_.find(*device.short_address);
+    if (found != short_addresses_.end() && found->second == address) {
+      short_addresses_.erase(found);
+    }
+  }
+  auto previous = short_addresses_.find(short_address);
+  if (previous != short_addresses_.end() && previous->second != address) {
+    // Short address was reassigned to another device.
+    devices_[previous->second].short_address = boost::none;
+  }
+  device.short_address = short_address;
+  short_addresses_[short_address] = address;
+}
+
+DeviceRegistry::Device* DeviceRegistry::FindByShortAddress(
+    znp::ShortAddress short_address) {
+  auto found = short_addresses_.find(short_address);
+  if (found == short_addresses_.end()) {
+    return nullptr;
+  }
+  return &devices_[found->second];
+}
+
+const std::string& DeviceRegistry::CommandTopic(
+    znp::IEEEAddress address, uint8_t endpoint, zcl::ZclDirection direction,
+    const clusterdb::ClusterInfo& cluster_info,
+    const clusterdb::CommandInfo& command_info) {
+  Device& device = Get(address);
+  std::uint64_t key = CommandTopicKey(endpoint, direction, cluster_info.id,
+                                      command_info.is_global, command_info.id);
+  auto found = device.command_topics.find(key);
+  if (found != device.command_topics.end()) {
+    return found->second;
+  }
+  std::string endpoint_str(std::to_string((unsigned int)endpoint));
+  std::string topic;
+  topic.reserve(device.topic_prefix.size() + endpoint_str.size() + 5 +
+                cluster_info.name.size() + command_info.name.size());
+  topic += device.topic_prefix;
+  topic += endpoint_str;
+  topic += "/in/";
+  topic += cluster_info.name;
+  topic += '/';
+  topic += command_info.name;
+  return device.command_topics.emplace(key, std::move(topic)).first->second;
+}
+
+void DeviceRegistry::ClearTopics() {
+  for (auto& device : devices_) {
+    device.second.command_topics.clear();
+  }
+}
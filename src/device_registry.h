@@ -0,0 +1,60 @@
+#ifndef _DEVICE_REGISTRY_H_
+#define _DEVICE_REGISTRY_H_
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include "clusterdb/cluster_info.h"
+#include "clusterdb/command_info.h"
+#include "link_quality.h"
+#include "zcl/zcl.h"
+#include "znp/znp.h"
+
+/**
+ * Information on each device AqaraHub has heard from, keyed by IEEE address.
+ *
+ * Only to be used from the io_service thread.
+ */
+class DeviceRegistry {
+ public:
+  struct Device {
+    znp::IEEEAddress address;
+    boost::optional<znp::ShortAddress> short_address;
+    // MQTT topic all of this device's topics start with, e.g.
+    // "AqaraHub/00158D000152D7B2/".
+    std::string topic_prefix;
+    // Incoming command topics, keyed by CommandTopicKey().
+    std::unordered_map<std::uint64_t, std::string> command_topics;
+    // Link quality as last published.
+    boost::optional<LinkQualityStats> link_quality;
+  };
+
+  explicit DeviceRegistry(std::string mqtt_prefix);
+
+  Device& Get(znp::IEEEAddress address);
+
+  /** Records that address currently uses short_address on the network. */
+  void SetShortAddress(znp::IEEEAddress address,
+                       znp::ShortAddress short_address);
+  /** Device using short_address, if known. Saves a UtilAddrmgrNwkAddrLookup
+   * round trip to the dongle. */
+  Device* FindByShortAddress(znp::ShortAddress short_address);
+
+  /** Topic to publish incoming commands to, e.g.
+   * "AqaraHub/00158D000152D7B2/1/in/On/Off/Report Attributes". Built once and
+   * cached, the reference stays valid until ClearTopics(). */
+  const std::string& CommandTopic(znp::IEEEAddress address, uint8_t endpoint,
+                                  zcl::ZclDirection direction,
+                                  const clusterdb::ClusterInfo& cluster_info,
+                                  const clusterdb::CommandInfo& command_info);
+
+  /** Drops the cached command topics, e.g. after cluster names changed. */
+  void ClearTopics();
+
+ private:
+  const std::string mqtt_prefix_;
+  std::map<znp::IEEEAddress, Device> devices_;
+  std::unordered_map<znp::ShortAddress, znp::IEEEAddress> short_addresses_;
+};
+#endif  // _DEVICE_REGISTRY_H_
@@ -0,0 +1,68 @@
+#include "device_state.h"
+#include "logging.h"
+
+namespace {
+/** Returns the object property key of parent, turning it into an (empty)
+ * object first if it was anything else. */
+tao::json::value& ObjectProperty(tao::json::value& parent,
+                                 const std::string& key) {
+  tao::json::value& child = parent.get_object()[key];
+  if (!child.is_object()) {
+    child = tao::json::empty_object;
+  }
+  return child;
+}
+}  // namespace
+
+DeviceStateAggregator::DeviceStateAggregator(
+    boost::asio::io_service& io_service,
+    boost::posix_time::time_duration debounce)
+    : io_service_(io_service), debounce_(debounce) {}
+
+void DeviceStateAggregator::Merge(znp::IEEEAddress address,
+                                  std::uint8_t endpoint,
+                                  const std::string& cluster,
+                                  const std::string& attribute,
+                                  const tao::json::value& value) {
+  auto found = devices_.find(address);
+  if (found == devices_.end()) {
+    Device device{tao::json::empty_object,
+                  std::make_unique<boost::asio::deadline_timer>(io_service_),
+                  false};
+    found = devices_.emplace(address, std::move(device)).first;
+  }
+  Device& device = found->second;
+
+  tao::json::value& attributes = ObjectProperty(
+      ObjectProperty(device.state, std::to_string(endpoint)), cluster);
+  tao::json::value& current = attributes.get_object()[attribute];
+  if (current == value) {
+    return;
+  }
+  current = value;
+
+  if (device.pending) {
+    // Already scheduled, this change will go out along with the others.
+    return;
+  }
+  device.pending = true;
+  device.timer->expires_from_now(debounce_);
+  device.timer->async_wait(
+      [this, address](const boost::system::error_code& ec) {
+        if (ec) {
+          // Cancelled, we may already have been destroyed.
+          return;
+        }
+        OnDebounceTimer(address);
+      });
+}
+
+void DeviceStateAggregator::OnDebounceTimer(znp::IEEEAddress address) {
+  auto found = devices_.find(address);
+  if (found == devices_.end()) {
+    LOG("DeviceStateAggregator", warning) << "Timer for unknown device";
+    return;
+  }
+  found->second.pending = false;
+  on_state_(address, found->second.state);
+}
@@ -0,0 +1,49 @@
+#ifndef _DEVICE_STATE_H_
+#define _DEVICE_STATE_H_
+#include <boost/asio.hpp>
+#include <boost/signals2/signal.hpp>
+#include <map>
+#include <memory>
+#include <string>
+#include <tao/json/value.hpp>
+#include "znp/znp.h"
+
+/**
+ * Keeps a JSON state document per device, and merges reported attributes into
+ * it.
+ *
+ * The document has the form {"<endpoint>": {"<cluster>": {"<attribute>":
+ * value}}}. After a merge changed a device's state, on_state_ is raised once
+ * the debounce interval has passed, so a burst of reports (e.g. a weather
+ * sensor reporting temperature, humidity, and pressure in separate frames)
+ * results in a single update.
+ *
+ * Only to be used from the io_service thread.
+ */
+class DeviceStateAggregator {
+ public:
+  DeviceStateAggregator(boost::asio::io_service& io_service,
+                        boost::posix_time::time_duration debounce);
+
+  void Merge(znp::IEEEAddress address, std::uint8_t endpoint,
+             const std::string& cluster, const std::string& attribute,
+             const tao::json::value& value);
+
+  boost::signals2::signal<void(znp::IEEEAddress address,
+                               const tao::json::value& state)>
+      on_state_;
+
+ private:
+  struct Device {
+    tao::json::value state;
+    std::unique_ptr<boost::asio::deadline_timer> timer;
+    bool pending;
+  };
+
+  boost::asio::io_service& io_service_;
+  const boost::posix_time::time_duration debounce_;
+  std::map<znp::IEEEAddress, Device> devices_;
+
+  void OnDebounceTimer(znp::IEEEAddress address);
+};
+#endif  // _DEVICE_STATE_H_
@@ -1,4 +1,5 @@
 #include "dynamic_encoding/common.h"
+#include "clusterdb/cluster_info.h"
 
 namespace dynamic_encoding {
 bool operator==(const VariantType& a, const VariantType& b) { return true; }
@@ -17,4 +18,24 @@ bool operator==(const XiaomiFF01Type& a, const XiaomiFF01Type& b) {
 bool operator==(const ErrorOrType& a, const ErrorOrType& b) {
   return a.success_type == b.success_type;
 }
+bool operator==(const BitmapType& a, const BitmapType& b) {
+  return a.datatype == b.datatype && a.bit_names == b.bit_names;
+}
+
+bool IsBitmap(zcl::DataType datatype) {
+  return datatype >= zcl::DataType::map8 && datatype <= zcl::DataType::map64;
+}
+
+const std::vector<std::string>& LastAttributeBitNames(const Context& ctx) {
+  static const std::vector<std::string> no_bit_names;
+  if (!ctx.cluster || !ctx.last_attribute_id) {
+    return no_bit_names;
+  }
+  auto attribute_info =
+      ctx.cluster->attributes.FindById(*ctx.last_attribute_id);
+  if (!attribute_info) {
+    return no_bit_names;
+  }
+  return attribute_info->bit_names;
+}
 }  // namespace dynamic_encoding
@@ -2,26 +2,46 @@
 #define _DYNAMIC_ENCODING_COMMON_H_
 #include <boost/variant.hpp>
 #include <memory>
+#include <string>
+#include <vector>
+#include "string_enum.h"
 #include "zcl/zcl.h"
 
 namespace clusterdb {
 struct ClusterInfo;
 }
 namespace dynamic_encoding {
+/** How Decode() represents values that are not plain numbers or strings. The
+ * encoder accepts either. */
+enum class ValueProfile {
+  // Bitmaps as arrays of booleans, data8-data64 and octet strings as arrays of
+  // bytes.
+  Verbose,
+  // Bitmaps as integers, or objects of booleans when clusters.info names their
+  // bits. data8-data64 and octet strings as hexadecimal strings.
+  Compact,
+};
+
 struct Context {
   boost::optional<const clusterdb::ClusterInfo&> cluster;
   mutable boost::optional<zcl::ZclAttributeId> last_attribute_id;
+  ValueProfile profile = ValueProfile::Verbose;
 };
 struct XiaomiFF01Type {};
 struct VariantType {};
 struct ObjectType;
 struct ArrayType;
 struct ErrorOrType;
+// map8 - map64 with names for (some of) its bits, indexed by bit number.
+struct BitmapType {
+  zcl::DataType datatype;
+  std::vector<std::string> bit_names;
+};
 
 typedef boost::variant<VariantType, XiaomiFF01Type, zcl::DataType,
                        boost::recursive_wrapper<ObjectType>,
                        boost::recursive_wrapper<ArrayType>,
-                       boost::recursive_wrapper<ErrorOrType>>
+                       boost::recursive_wrapper<ErrorOrType>, BitmapType>
     AnyType;
 
 struct ObjectEntry {
@@ -46,5 +66,20 @@ bool operator==(const ObjectEntry& a, const ObjectEntry& b);
 bool operator==(const ObjectType& a, const ObjectType& b);
 bool operator==(const ArrayType& a, const ArrayType& b);
 bool operator==(const ErrorOrType& a, const ErrorOrType& b);
+bool operator==(const BitmapType& a, const BitmapType& b);
+
+/** Whether datatype is one of map8 - map64. */
+bool IsBitmap(zcl::DataType datatype);
+/** Names of the bits of ctx.last_attribute_id, if it's a bitmap and
+ * clusters.info names them. */
+const std::vector<std::string>& LastAttributeBitNames(const Context& ctx);
 }  // namespace dynamic_encoding
+
+template <>
+struct StringEnumHelper<dynamic_encoding::ValueProfile> {
+  static std::map<dynamic_encoding::ValueProfile, std::string> lookup() {
+    return {{dynamic_encoding::ValueProfile::Verbose, "verbose"},
+            {dynamic_encoding::ValueProfile::Compact, "compact"}};
+  }
+};
 #endif  // _DYNAMIC_ENCODING_COMMON_H_
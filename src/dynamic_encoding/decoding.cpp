@@ -1,4 +1,6 @@
 #include "dynamic_encoding/decoding.h"
+#include <boost/algorithm/hex.hpp>
+#include <iterator>
 #include <type_traits>
 #include "clusterdb/cluster_info.h"
 #include "string_enum.h"
@@ -15,9 +17,9 @@ IT DecodeInteger(std::size_t bytes, std::vector<uint8_t>::const_iterator& begin,
     if (begin == end) {
       throw std::runtime_error("Not enough data to decode integer");
     }
-    unsigned_value |= ((IT) * (begin++)) << (byte * 8);
+    unsigned_value |= ((UT) * (begin++)) << (byte * 8);
   }
-  if (std::is_signed<IT>::value) {
+  if (std::is_signed<IT>::value && bytes < sizeof(UT)) {
     if (unsigned_value >> ((bytes * 8) - 1) == 1) {
       unsigned_value |= ((UT)~0) << (bytes * 8);
     }
@@ -41,7 +43,53 @@ struct Decoder {
       return (*this)(XiaomiFF01Type{});
     }
     ret["type"] = enum_to_string<zcl::DataType>(type);
-    ret["value"] = (*this)(type);
+    if (IsBitmap(type)) {
+      ret["value"] = DecodeBitmap(type, LastAttributeBitNames(ctx));
+    } else {
+      ret["value"] = (*this)(type);
+    }
+    return ret;
+  }
+
+  tao::json::value operator()(const BitmapType& bitmap) {
+    return DecodeBitmap(bitmap.datatype, bitmap.bit_names);
+  }
+
+  tao::json::value DecodeBitmap(zcl::DataType datatype,
+                                const std::vector<std::string>& bit_names) {
+    std::size_t length =
+        1 + ((std::size_t)datatype - (std::size_t)zcl::DataType::map8);
+    std::uint64_t value = DecodeInteger<std::uint64_t>(length, begin, end);
+    if (ctx.profile == ValueProfile::Verbose) {
+      tao::json::value::array_t ret;
+      for (std::size_t bit = 0; bit < length * 8; bit++) {
+        ret.push_back(((value >> bit) & 0x1) != 0);
+      }
+      return ret;
+    }
+    if (bit_names.empty()) {
+      return value;
+    }
+    tao::json::value::object_t ret;
+    for (std::size_t bit = 0; bit < length * 8; bit++) {
+      bool is_set = ((value >> bit) & 0x1) != 0;
+      if (bit < bit_names.size() && !bit_names[bit].empty()) {
+        ret[bit_names[bit]] = is_set;
+      } else if (is_set) {
+        // Don't lose bits clusters.info has no name for.
+        ret[std::to_string(bit)] = true;
+      }
+    }
+    return ret;
+  }
+
+  std::string DecodeHex(std::size_t size) {
+    if ((std::size_t)std::distance(begin, end) < size) {
+      throw std::runtime_error("Not enough data to decode octets");
+    }
+    std::string ret;
+    boost::algorithm::hex(begin, begin + size, std::back_inserter(ret));
+    begin += size;
     return ret;
   }
 
@@ -59,6 +107,9 @@ struct Decoder {
       case zcl::DataType::data64: {
         std::size_t length =
             1 + ((std::size_t)datatype - (std::size_t)zcl::DataType::data8);
+        if (ctx.profile == ValueProfile::Compact) {
+          return DecodeHex(length);
+        }
         tao::json::value::array_t ret;
         for (std::size_t i = 0; i < length; i++) {
           ret.push_back(DecodeInteger<unsigned int>(1, begin, end));
@@ -81,14 +132,8 @@ struct Decoder {
       case zcl::DataType::map48:
       case zcl::DataType::map56:
       case zcl::DataType::map64: {
-        std::size_t length =
-            1 + ((std::size_t)datatype - (std::size_t)zcl::DataType::map8);
-        std::uint64_t value = DecodeInteger<std::uint64_t>(length, begin, end);
-        tao::json::value::array_t ret;
-        for (std::size_t bit = 0; bit < length * 8; bit++) {
-          ret.push_back(((value >> bit) & 0x1) != 0);
-        }
-        return ret;
+        static const std::vector<std::string> no_bit_names;
+        return DecodeBitmap(datatype, no_bit_names);
       }
       case zcl::DataType::uint8:
       case zcl::DataType::uint16:
@@ -149,6 +194,9 @@ struct Decoder {
         if ((std::size_t)std::distance(begin, end) < size) {
           throw std::runtime_error("Not enough data to decode octet string");
         }
+        if (ctx.profile == ValueProfile::Compact) {
+          return DecodeHex(size);
+        }
         tao::json::value::array_t ret;
         while (size--) {
           ret.push_back((unsigned int)*(begin++));
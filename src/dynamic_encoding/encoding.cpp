@@ -1,4 +1,7 @@
 #include "dynamic_encoding/encoding.h"
+#include <algorithm>
+#include <boost/algorithm/hex.hpp>
+#include <iterator>
 #include "clusterdb/cluster_info.h"
 #include "zcl/zcl_string_enum.h"
 #include "znp/encoding.h"
@@ -34,9 +37,11 @@ void EncodeInteger(const IT& value, std::size_t bytes,
                    std::vector<uint8_t>& target) {
   typedef typename std::make_unsigned<IT>::type UT;
   UT unsigned_value = (UT)value;
-  UT rest = unsigned_value >> (bytes * 8);
+  // Shifting by the full width of UT is undefined, everything fits then.
+  UT rest = (bytes < sizeof(UT)) ? unsigned_value >> (bytes * 8) : 0;
   if (std::is_signed<IT>::value) {
-    const UT rest_negative = ((UT)~0) >> (bytes * 8);
+    const UT rest_negative =
+        (bytes < sizeof(UT)) ? ((UT)~0) >> (bytes * 8) : 0;
     if (rest != 0 && rest != rest_negative) {
       throw std::runtime_error(
           boost::str(boost::format("Value %d does not fit in %d bits") %
@@ -54,6 +59,79 @@ void EncodeInteger(const IT& value, std::size_t bytes,
   }
 }
 
+/** Appends the bytes of a hexadecimal string, returns how many. */
+std::size_t EncodeHex(const tao::json::value& value,
+                      std::vector<uint8_t>& target) {
+  const std::string& hex_value = value.get_string();
+  std::size_t target_size = target.size();
+  boost::algorithm::unhex(hex_value.begin(), hex_value.end(),
+                          std::back_inserter(target));
+  return target.size() - target_size;
+}
+
+/** Bit number of a named-bit object key, a name or a decimal bit number. */
+std::size_t BitNumber(const std::vector<std::string>& bit_names,
+                      const std::string& key, std::size_t bits) {
+  if (key.empty()) {
+    throw std::runtime_error("Empty bit name");
+  }
+  auto found = std::find(bit_names.begin(), bit_names.end(), key);
+  if (found != bit_names.end()) {
+    return (std::size_t)std::distance(bit_names.begin(), found);
+  }
+  std::size_t bit = 0;
+  for (char c : key) {
+    if (c < '0' || c > '9' || bit >= bits) {
+      bit = bits;
+      break;
+    }
+    bit = bit * 10 + (c - '0');
+  }
+  if (bit >= bits) {
+    throw std::runtime_error("Unknown bit '" + key + "'");
+  }
+  return bit;
+}
+
+/** Accepts an integer, an array of booleans, or an object of booleans by
+ * bit name or number. */
+void EncodeBitmap(zcl::DataType datatype,
+                  const std::vector<std::string>& bit_names,
+                  const tao::json::value& value,
+                  std::vector<uint8_t>& target) {
+  std::size_t length =
+      1 + ((std::size_t)datatype - (std::size_t)zcl::DataType::map8);
+  if (value.is_integer()) {
+    EncodeInteger(value.as<std::uint64_t>(), length, target);
+    return;
+  }
+  std::uint64_t bitmask = 0;
+  if (value.is_object()) {
+    for (const auto& item : value.get_object()) {
+      if (item.second.as<bool>()) {
+        bitmask |= ((std::uint64_t)1)
+                   << BitNumber(bit_names, item.first, length * 8);
+      }
+    }
+  } else {
+    const tao::json::value::array_t& array_value = value.get_array();
+    if (array_value.size() != length * 8) {
+      throw std::runtime_error(boost::str(
+          boost::format("Type %s expects array of length %d, got %d") %
+          enum_to_string<zcl::DataType>(datatype) % (length * 8) %
+          array_value.size()));
+    }
+    std::size_t current_bit = 0;
+    for (const auto& item : array_value) {
+      if (item.as<bool>()) {
+        bitmask |= ((std::uint64_t)1) << current_bit;
+      }
+      current_bit++;
+    }
+  }
+  EncodeInteger(bitmask, length, target);
+}
+
 void EncodeTyped(const Context& ctx, const VariantType& type,
                  const tao::json::value::object_t& value,
                  std::vector<uint8_t>& target);
@@ -84,10 +162,13 @@ void EncodeTyped(const Context& ctx, const VariantType& type,
                              tao::json::to_string(found_type->second) + "'");
   }
   NormalEncodeAppend(datatype, target);
-  EncodeTyped(
-      ctx, datatype,
-      (found_value == value.end()) ? tao::json::null : found_value->second,
-      target);
+  const tao::json::value& variant_value =
+      (found_value == value.end()) ? tao::json::null : found_value->second;
+  if (IsBitmap(datatype)) {
+    EncodeBitmap(datatype, LastAttributeBitNames(ctx), variant_value, target);
+  } else {
+    EncodeTyped(ctx, datatype, variant_value, target);
+  }
 }
 void EncodeTyped(const Context& ctx, const VariantType& type,
                  const tao::json::value& value, std::vector<uint8_t>& target) {
@@ -117,6 +198,11 @@ void EncodeTyped(const Context& ctx, const XiaomiFF01Type& type,
   throw std::runtime_error("Xiaomi FF01 encoding not implemented");
 }
 
+void EncodeTyped(const Context& ctx, const BitmapType& type,
+                 const tao::json::value& value, std::vector<uint8_t>& target) {
+  EncodeBitmap(type.datatype, type.bit_names, value, target);
+}
+
 void EncodeTyped(const Context& ctx, const zcl::DataType& datatype,
                  const tao::json::value& value, std::vector<uint8_t>& target) {
   switch (datatype) {
@@ -137,6 +223,14 @@ void EncodeTyped(const Context& ctx, const zcl::DataType& datatype,
     case zcl::DataType::data64: {
       std::size_t length =
           1 + ((std::size_t)datatype - (std::size_t)zcl::DataType::data8);
+      if (value.is_string()) {
+        if (EncodeHex(value, target) != length) {
+          throw std::runtime_error(
+              boost::str(boost::format("Type %s expects %d bytes") %
+                         enum_to_string<zcl::DataType>(datatype) % length));
+        }
+        return;
+      }
       const tao::json::value::array_t& array_value = value.get_array();
       if (array_value.size() != length) {
         throw std::runtime_error(
@@ -164,24 +258,7 @@ void EncodeTyped(const Context& ctx, const zcl::DataType& datatype,
     case zcl::DataType::map48:
     case zcl::DataType::map56:
     case zcl::DataType::map64: {
-      std::size_t length =
-          1 + ((std::size_t)datatype - (std::size_t)zcl::DataType::map8);
-      const tao::json::value::array_t& array_value = value.get_array();
-      if (array_value.size() != length * 8) {
-        throw std::runtime_error(boost::str(
-            boost::format("Type %s expects array of length %d, got %d") %
-            enum_to_string<zcl::DataType>(datatype) % (length * 8) %
-            array_value.size()));
-      }
-      std::size_t current_bit = 0;
-      std::uint64_t bitmask = 0;
-      for (const auto& item : array_value) {
-        if (item.as<bool>()) {
-          bitmask |= (1 << current_bit);
-        }
-        current_bit++;
-      }
-      EncodeInteger(bitmask, length, target);
+      EncodeBitmap(datatype, {}, value, target);
       return;
     }
     case zcl::DataType::uint8:
@@ -235,6 +312,17 @@ void EncodeTyped(const Context& ctx, const zcl::DataType& datatype,
       std::size_t invalid_size = (1 << (size_bytes * 8)) - 1;
       if (value == tao::json::null) {
         EncodeInteger(invalid_size, size_bytes, target);
+      } else if (value.is_string()) {
+        // Fill in the length once the hexadecimal string is decoded.
+        std::size_t length_offset = target.size();
+        target.resize(length_offset + size_bytes);
+        std::size_t size = EncodeHex(value, target);
+        if (size >= invalid_size) {
+          throw std::runtime_error("Octet string too long");
+        }
+        for (std::size_t byte = 0; byte < size_bytes; byte++) {
+          target[length_offset + byte] = (std::uint8_t)(size >> (byte * 8));
+        }
       } else {
         const tao::json::value::array_t& array_value = value.get_array();
         EncodeInteger(array_value.size(), size_bytes, target);
@@ -316,6 +404,7 @@ void EncodeTyped(const Context& ctx, const zcl::DataType& datatype,
             if (auto attribute_info =
                     ctx.cluster->attributes.FindByName(value.get_string())) {
               NormalEncodeAppend(attribute_info->id, target);
+              ctx.last_attribute_id = attribute_info->id;
             } else {
               throw std::runtime_error("Unknown attribute id '" +
                                        value.get_string() + "'");
@@ -326,6 +415,7 @@ void EncodeTyped(const Context& ctx, const zcl::DataType& datatype,
           }
         } else if (value.is_integer()) {
           EncodeInteger(value.as<unsigned int>(), 2, target);
+          ctx.last_attribute_id = (zcl::ZclAttributeId)value.as<unsigned int>();
         } else {
           throw std::runtime_error(
               "Expected either string or integer for attribute ID");
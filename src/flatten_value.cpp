@@ -0,0 +1,182 @@
+#include "flatten_value.h"
+#include <iterator>
+#include <ostream>
+#include <streambuf>
+#include <tao/json.hpp>
+#include "logging.h"
+
+namespace {
+/** Appends everything written to it to an ArenaString. */
+class ArenaStringBuf : public std::streambuf {
+ public:
+  explicit ArenaStringBuf(ArenaString& out) : out_(out) {}
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      out_ += traits_type::to_char_type(c);
+    }
+    return traits_type::not_eof(c);
+  }
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    out_.append(s, n);
+    return n;
+  }
+
+ private:
+  ArenaString& out_;
+};
+
+void AppendIndex(ArenaString& out, std::size_t index) {
+  char digits[20];
+  char* begin = std::end(digits);
+  do {
+    *--begin = '0' + index % 10;
+    index /= 10;
+  } while (index > 0);
+  out.append(begin, std::end(digits));
+}
+}  // namespace
+
+void AppendJsonString(ArenaString& out, const std::string& text) {
+  static const char hex_digits[] = "0123456789abcdef";
+  out += '"';
+  for (char c : text) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\b':
+        out += "\\b";
+        break;
+      case '\f':
+        out += "\\f";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          out += "\\u00";
+          out += hex_digits[(c >> 4) & 0xF];
+          out += hex_digits[c & 0xF];
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+namespace {
+/** Number of messages FlattenNode() adds to the batch for value. */
+std::size_t CountMessages(bool recursive, const tao::json::value& value) {
+  std::size_t count = 1;
+  if (recursive && value.is_object()) {
+    for (const auto& item : value.get_object()) {
+      count += CountMessages(recursive, item.second);
+    }
+  } else if (recursive && value.is_array()) {
+    for (const auto& item : value.get_array()) {
+      count += CountMessages(recursive, item);
+    }
+  }
+  return count;
+}
+
+std::size_t FlattenNode(ArenaString& topic, bool recursive,
+                        const tao::json::value& value,
+                        const PublishPolicy& policy,
+                        std::vector<MqttWrapper::Message>& batch) {
+  const std::size_t index = batch.size();
+  batch.push_back(MqttWrapper::Message{std::string(topic.data(), topic.size()),
+                                       std::string(), policy.qos,
+                                       policy.retain, policy.expiry,
+                                       policy.durable});
+  const std::size_t topic_size = topic.size();
+  if (policy.format != PayloadFormat::Json) {
+    if (recursive && value.is_object()) {
+      for (const auto& item : value.get_object()) {
+        topic += '/';
+        topic.append(item.first.data(), item.first.size());
+        FlattenNode(topic, recursive, item.second, policy, batch);
+        topic.resize(topic_size);
+      }
+    } else if (recursive && value.is_array()) {
+      const tao::json::value::array_t& array_value = value.get_array();
+      for (std::size_t i = 0; i < array_value.size(); i++) {
+        topic += '/';
+        AppendIndex(topic, i);
+        FlattenNode(topic, recursive, array_value[i], policy, batch);
+        topic.resize(topic_size);
+      }
+    }
+    batch[index].message = EncodePayload(policy.format, value);
+    LOG("FlattenValue", debug)
+        << "Publishing to '" << batch[index].topic_name << "': "
+        << PayloadForLog(policy.format, batch[index].message);
+    return index;
+  }
+  ArenaString payload(topic.get_allocator());
+  if (recursive && value.is_object()) {
+    payload += '{';
+    for (const auto& item : value.get_object()) {
+      if (payload.size() > 1) {
+        payload += ',';
+      }
+      AppendJsonString(payload, item.first);
+      payload += ':';
+      topic += '/';
+      topic.append(item.first.data(), item.first.size());
+      const std::string& child =
+          batch[FlattenNode(topic, recursive, item.second, policy, batch)]
+              .message;
+      payload.append(child.data(), child.size());
+      topic.resize(topic_size);
+    }
+    payload += '}';
+  } else if (recursive && value.is_array()) {
+    const tao::json::value::array_t& array_value = value.get_array();
+    payload += '[';
+    for (std::size_t i = 0; i < array_value.size(); i++) {
+      if (i > 0) {
+        payload += ',';
+      }
+      topic += '/';
+      AppendIndex(topic, i);
+      const std::string& child =
+          batch[FlattenNode(topic, recursive, array_value[i], policy, batch)]
+              .message;
+      payload.append(child.data(), child.size());
+      topic.resize(topic_size);
+    }
+    payload += ']';
+  } else {
+    ArenaStringBuf buffer(payload);
+    std::ostream stream(&buffer);
+    tao::json::to_stream(stream, value);
+  }
+  batch[index].message.assign(payload.data(), payload.size());
+  LOG("FlattenValue", debug) << "Publishing to '" << batch[index].topic_name
+                            << "': " << batch[index].message;
+  return index;
+}
+}  // namespace
+
+std::size_t FlattenValue(ArenaString& topic, bool recursive,
+                         const tao::json::value& value,
+                         const PublishPolicy& policy,
+                         std::vector<MqttWrapper::Message>& batch) {
+  // Size the batch once instead of letting it grow message by message.
+  batch.reserve(batch.size() + CountMessages(recursive, value));
+  return FlattenNode(topic, recursive, value, policy, batch);
+}
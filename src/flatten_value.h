@@ -0,0 +1,29 @@
+#ifndef _FLATTEN_VALUE_H_
+#define _FLATTEN_VALUE_H_
+#include <string>
+#include <tao/json/value.hpp>
+#include <vector>
+#include "message_arena.h"
+#include "mqtt_wrapper.h"
+#include "publish_policy.h"
+
+/** Appends text as a JSON string literal to out. */
+void AppendJsonString(ArenaString& out, const std::string& text);
+
+/** Appends a message publishing value to topic to batch, and if recursive
+ * also one for each of its properties or elements to sub-topics. Every node
+ * is serialized only once, objects and arrays are assembled from the payloads
+ * of their children. topic is used as a scratch buffer for building the
+ * sub-topics, but is restored before returning.
+ *
+ * Returns the index of value's message in batch. Its slot is reserved before
+ * recursing, so parents are published before their children. Binary payload
+ * formats encode every node on its own.
+ *
+ * JSON payloads are assembled in topic's arena, and only copied out once
+ * complete. */
+std::size_t FlattenValue(ArenaString& topic, bool recursive,
+                         const tao::json::value& value,
+                         const PublishPolicy& policy,
+                         std::vector<MqttWrapper::Message>& batch);
+#endif  // _FLATTEN_VALUE_H_
@@ -0,0 +1,146 @@
+#include "flight_recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+const char kMagic[8] = {'A', 'Q', 'H', 'U', 'B', 'F', 'R', '1'};
+
+struct DumpHeader {
+  char magic[8];
+  std::uint32_t entry_size;
+  std::uint32_t count;
+};
+
+static_assert(sizeof(FlightRecorder::Entry) == 64,
+              "Entries are one cache line, and dumps depend on their layout");
+
+std::size_t RoundUpToPowerOfTwo(std::size_t value) {
+  std::size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+}  // namespace
+
+const std::size_t FlightRecorder::kMaxData;
+const std::size_t FlightRecorder::kGlobalCapacity;
+
+FlightRecorder::FlightRecorder(std::size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(capacity) - 1), slots_(new Slot[mask_ + 1]) {}
+
+FlightRecorder& FlightRecorder::Global() {
+  static FlightRecorder recorder(kGlobalCapacity);
+  return recorder;
+}
+
+void FlightRecorder::Add(Kind kind, std::uint16_t code,
+                         const std::uint8_t* data, std::size_t size) {
+  const std::uint64_t index = next_.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = slots_[index & mask_];
+  slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  Entry& entry = slot.entry;
+  entry.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+  entry.size = (std::uint32_t)std::min<std::size_t>(size, UINT32_MAX);
+  entry.kind = kind;
+  entry.reserved = 0;
+  entry.code = code;
+  std::copy(data, data + std::min(size, kMaxData), entry.data);
+  slot.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+void FlightRecorder::Add(Kind kind, std::uint16_t code,
+                         boost::string_view first, boost::string_view second) {
+  std::uint8_t data[kMaxData];
+  const std::size_t size = first.size() + 1 + second.size();
+  std::uint8_t* end =
+      std::copy_n(first.data(), std::min(first.size(), kMaxData), data);
+  if (end != std::end(data)) {
+    *end++ = '\0';
+    const std::size_t room = std::end(data) - end;
+    std::copy_n(second.data(), std::min(second.size(), room), end);
+  }
+  Add(kind, code, data, size);
+}
+
+std::vector<FlightRecorder::Entry> FlightRecorder::Snapshot() const {
+  std::vector<std::pair<std::uint64_t, Entry>> entries;
+  entries.reserve(mask_ + 1);
+  for (std::size_t i = 0; i <= mask_; i++) {
+    const Slot& slot = slots_[i];
+    const std::uint64_t before = slot.sequence.load(std::memory_order_acquire);
+    if (before == 0 || (before & 1) != 0) {
+      continue;
+    }
+    Entry entry = slot.entry;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != before) {
+      // Overwritten while copying it.
+      continue;
+    }
+    entries.emplace_back(before, entry);
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+  std::vector<Entry> result;
+  result.reserve(entries.size());
+  for (const auto& entry : entries) {
+    result.push_back(entry.second);
+  }
+  return result;
+}
+
+void FlightRecorder::Write(std::ostream& out) const {
+  const std::vector<Entry> entries = Snapshot();
+  DumpHeader header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.entry_size = sizeof(Entry);
+  header.count = entries.size();
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(entries.data()),
+            entries.size() * sizeof(Entry));
+}
+
+std::vector<FlightRecorder::Entry> FlightRecorder::Read(std::istream& in) {
+  DumpHeader header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    throw std::runtime_error("Not a flight recorder dump");
+  }
+  if (header.entry_size != sizeof(Entry)) {
+    throw std::runtime_error(
+        "Flight recorder dump from a different architecture or version");
+  }
+  std::vector<Entry> entries(header.count);
+  if (!in.read(reinterpret_cast<char*>(entries.data()),
+               entries.size() * sizeof(Entry))) {
+    throw std::runtime_error("Flight recorder dump is truncated");
+  }
+  return entries;
+}
+
+std::ostream& operator<<(std::ostream& stream, FlightRecorder::Kind kind) {
+  switch (kind) {
+    case FlightRecorder::Kind::FrameIn:
+      return stream << "FrameIn";
+    case FlightRecorder::Kind::FrameOut:
+      return stream << "FrameOut";
+    case FlightRecorder::Kind::MqttIn:
+      return stream << "MqttIn";
+    case FlightRecorder::Kind::MqttOut:
+      return stream << "MqttOut";
+    case FlightRecorder::Kind::MqttConnected:
+      return stream << "MqttConnected";
+    case FlightRecorder::Kind::MqttDisconnected:
+      return stream << "MqttDisconnected";
+    case FlightRecorder::Kind::DecodeError:
+      return stream << "DecodeError";
+    default:
+      return stream << (unsigned int)kind;
+  }
+}
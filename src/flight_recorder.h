@@ -0,0 +1,87 @@
+#ifndef _FLIGHT_RECORDER_H_
+#define _FLIGHT_RECORDER_H_
+#include <atomic>
+#include <boost/utility/string_view.hpp>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Always-on ring of the most recent ZNP frames, MQTT operations, and decode
+ * errors, to be dumped when something went wrong.
+ *
+ * Entries have a fixed size, data is cut off after kMaxData bytes. Adding one
+ * claims a slot with a single atomic increment and copies the entry in, so it
+ * takes nanoseconds, and may be done from any thread. Dumping skips entries
+ * being written at the same time.
+ */
+class FlightRecorder {
+ public:
+  enum class Kind : std::uint8_t {
+    // code: the frame's two command bytes, data: its payload.
+    FrameIn = 1,
+    FrameOut = 2,
+    // code: the QoS, data: the topic, a NUL, and the message.
+    MqttIn = 3,
+    MqttOut = 4,
+    // code: whether the session was present.
+    MqttConnected = 5,
+    MqttDisconnected = 6,
+    // code: the cluster id, data: the ZCL payload that failed to decode.
+    DecodeError = 7,
+  };
+
+  static const std::size_t kMaxData = 48;
+  // Entries kept by Global().
+  static const std::size_t kGlobalCapacity = 4096;
+
+  /** Also the layout of dumps, in the host's byte order. */
+  struct Entry {
+    std::uint64_t timestamp_us;  // Since the epoch.
+    // Size of the data before it was cut off.
+    std::uint32_t size;
+    Kind kind;
+    std::uint8_t reserved;
+    std::uint16_t code;
+    std::uint8_t data[kMaxData];
+  };
+
+  /** capacity is rounded up to a power of two. */
+  explicit FlightRecorder(std::size_t capacity);
+  FlightRecorder(const FlightRecorder&) = delete;
+  FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+  /** The process-wide recorder. */
+  static FlightRecorder& Global();
+
+  void Add(Kind kind, std::uint16_t code, const std::uint8_t* data,
+           std::size_t size);
+  /** Adds an entry with first, a NUL, and second as its data. */
+  void Add(Kind kind, std::uint16_t code, boost::string_view first,
+           boost::string_view second);
+
+  /** The entries currently kept, oldest first. */
+  std::vector<Entry> Snapshot() const;
+
+  /** Writes Snapshot() as a dump, which Read() reads back. */
+  void Write(std::ostream& out) const;
+  /** Throws std::runtime_error if in doesn't hold a complete dump. */
+  static std::vector<Entry> Read(std::istream& in);
+
+ private:
+  struct Slot {
+    // Twice the entry's index, plus one while it's being written. Zero if
+    // never written.
+    std::atomic<std::uint64_t> sequence{0};
+    Entry entry;
+  };
+
+  std::size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  std::atomic<std::uint64_t> next_{0};
+};
+
+std::ostream& operator<<(std::ostream& stream, FlightRecorder::Kind kind);
+#endif  // _FLIGHT_RECORDER_H_
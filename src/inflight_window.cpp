@@ -0,0 +1,86 @@
+#include "inflight_window.h"
+#include <algorithm>
+#include <limits>
+
+InflightWindow::InflightWindow(std::size_t capacity)
+    : slots_(std::max<std::size_t>(
+          1, std::min<std::size_t>(
+                 capacity, std::numeric_limits<std::uint16_t>::max()))),
+      slot_by_packet_id_(std::numeric_limits<std::uint16_t>::max() + 1, 0) {
+  // Hand out the lowest slots first.
+  for (std::size_t i = slots_.size(); i > 0; i--) {
+    free_slots_.push_back(i - 1);
+  }
+}
+
+void InflightWindow::Add(std::uint16_t packet_id, Entry entry,
+                         Clock::time_point now) {
+  std::uint16_t index = free_slots_.back();
+  free_slots_.pop_back();
+  Slot& slot = slots_[index];
+  slot.packet_id = packet_id;
+  slot.sequence = next_sequence_++;
+  slot.sent_at = now;
+  slot.entry = std::move(entry);
+  slot_by_packet_id_[packet_id] = index + 1;
+  stats_.max_depth = std::max(stats_.max_depth, size());
+}
+
+const InflightWindow::Entry* InflightWindow::Find(
+    std::uint16_t packet_id) const {
+  std::uint16_t index = slot_by_packet_id_[packet_id];
+  if (index == 0) {
+    return nullptr;
+  }
+  return slots_[index - 1].entry.get_ptr();
+}
+
+boost::optional<InflightWindow::Entry> InflightWindow::Acknowledge(
+    std::uint16_t packet_id, Clock::time_point now) {
+  std::uint16_t index = slot_by_packet_id_[packet_id];
+  if (index == 0) {
+    return boost::none;
+  }
+  Clock::duration latency = now - slots_[index - 1].sent_at;
+  stats_.acknowledged++;
+  stats_.total_latency += latency;
+  stats_.max_latency = std::max(stats_.max_latency, latency);
+  return Remove(packet_id);
+}
+
+boost::optional<InflightWindow::Entry> InflightWindow::Remove(
+    std::uint16_t packet_id) {
+  std::uint16_t index = slot_by_packet_id_[packet_id];
+  if (index == 0) {
+    return boost::none;
+  }
+  slot_by_packet_id_[packet_id] = 0;
+  Slot& slot = slots_[index - 1];
+  boost::optional<Entry> entry = std::move(slot.entry);
+  slot.entry = boost::none;
+  free_slots_.push_back(index - 1);
+  return entry;
+}
+
+std::vector<InflightWindow::Entry> InflightWindow::TakeAll() {
+  std::vector<Slot*> in_use;
+  for (Slot& slot : slots_) {
+    if (slot.entry) {
+      in_use.push_back(&slot);
+    }
+  }
+  std::sort(in_use.begin(), in_use.end(), [](const Slot* a, const Slot* b) {
+    return a->sequence < b->sequence;
+  });
+  std::vector<Entry> entries;
+  for (Slot* slot : in_use) {
+    entries.push_back(std::move(*Remove(slot->packet_id)));
+  }
+  return entries;
+}
+
+InflightWindow::Stats InflightWindow::stats() const {
+  Stats stats = stats_;
+  stats.depth = size();
+  return stats;
+}
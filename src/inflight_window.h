@@ -0,0 +1,73 @@
+#ifndef _INFLIGHT_WINDOW_H_
+#define _INFLIGHT_WINDOW_H_
+#include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include "publish_queue.h"
+
+/**
+ * QoS 1 and 2 messages sent to the MQTT server, waiting for their PUBACK or
+ * PUBCOMP.
+ *
+ * Holds at most capacity messages, so the sender can hold back further
+ * messages until earlier ones are acknowledged, like the receive maximum of
+ * MQTT 5. Messages are kept in a flat array of slots, found through a table
+ * indexed by packet id.
+ */
+class InflightWindow {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Entry {
+    PublishQueue::Item item;
+    // Whether the message is also kept in the PublishSpool.
+    bool spooled;
+  };
+
+  struct Stats {
+    std::size_t depth = 0;
+    std::size_t max_depth = 0;
+    std::uint64_t acknowledged = 0;
+    Clock::duration total_latency = Clock::duration::zero();
+    Clock::duration max_latency = Clock::duration::zero();
+  };
+
+  explicit InflightWindow(std::size_t capacity);
+
+  bool full() const { return free_slots_.empty(); }
+  std::size_t size() const { return slots_.size() - free_slots_.size(); }
+
+  /** Adds a message sent with packet_id. The window must not be full. */
+  void Add(std::uint16_t packet_id, Entry entry,
+           Clock::time_point now = Clock::now());
+  /** Message sent with packet_id, or nullptr. */
+  const Entry* Find(std::uint16_t packet_id) const;
+  /** Removes the message sent with packet_id, recording the time it took to
+   * be acknowledged. */
+  boost::optional<Entry> Acknowledge(std::uint16_t packet_id,
+                                     Clock::time_point now = Clock::now());
+  /** Removes the message sent with packet_id, without counting it as
+   * acknowledged. */
+  boost::optional<Entry> Remove(std::uint16_t packet_id);
+  /** Removes all messages, in the order they were added. */
+  std::vector<Entry> TakeAll();
+
+  Stats stats() const;
+
+ private:
+  struct Slot {
+    std::uint16_t packet_id;
+    // Order the messages were added in, as several can share a sent_at.
+    std::uint64_t sequence;
+    Clock::time_point sent_at;
+    boost::optional<Entry> entry;
+  };
+  std::vector<Slot> slots_;
+  std::vector<std::uint16_t> free_slots_;
+  // Slot index + 1 by packet id, 0 when the packet id isn't in flight.
+  std::vector<std::uint16_t> slot_by_packet_id_;
+  std::uint64_t next_sequence_ = 0;
+  Stats stats_;
+};
+#endif  // _INFLIGHT_WINDOW_H_
@@ -0,0 +1,43 @@
+#include "last_value_cache.h"
+#include <functional>
+
+void LastValueCache::Enable(TopicClass topic_class,
+                            Clock::duration refresh_interval) {
+  refresh_intervals_[topic_class] = refresh_interval;
+}
+
+bool LastValueCache::ShouldPublish(TopicClass topic_class,
+                                   const std::string& topic,
+                                   const std::string& payload,
+                                   Clock::time_point now) {
+  auto refresh_interval = refresh_intervals_.find(topic_class);
+  if (refresh_interval == refresh_intervals_.end()) {
+    published_++;
+    return true;
+  }
+  std::size_t payload_hash = std::hash<std::string>()(payload);
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = entries_.find(topic);
+  if (found == entries_.end()) {
+    entries_.emplace(topic, Entry{payload_hash, now});
+    published_++;
+    return true;
+  }
+  Entry& entry = found->second;
+  bool refresh_due =
+      refresh_interval->second != Clock::duration::zero() &&
+      now - entry.published_at >= refresh_interval->second;
+  if (entry.payload_hash == payload_hash && !refresh_due) {
+    suppressed_++;
+    return false;
+  }
+  entry.payload_hash = payload_hash;
+  entry.published_at = now;
+  published_++;
+  return true;
+}
+
+void LastValueCache::Forget(const std::string& topic) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.erase(topic);
+}
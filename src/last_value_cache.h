@@ -0,0 +1,56 @@
+#ifndef _LAST_VALUE_CACHE_H_
+#define _LAST_VALUE_CACHE_H_
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "topic_class.h"
+
+/**
+ * Suppresses publishes that would repeat the last payload sent to a topic.
+ *
+ * Suppression is enabled per topic class. Only a hash of the last payload is
+ * kept per topic, and a publish is forced anyway once the refresh interval of
+ * its class has passed, so consumers still see a periodic heartbeat.
+ *
+ * Only to be used from the io_service thread, except for Forget(), which is
+ * also called from the MQTT thread when a publish failed.
+ */
+class LastValueCache {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /** Enables suppression for topic_class. A refresh_interval of zero never
+   * forces a repeated payload out. */
+  void Enable(TopicClass topic_class, Clock::duration refresh_interval);
+  bool enabled(TopicClass topic_class) const {
+    return refresh_intervals_.count(topic_class) > 0;
+  }
+
+  /** Returns whether payload should be published to topic, and if so records
+   * it as the topic's last value. */
+  bool ShouldPublish(TopicClass topic_class, const std::string& topic,
+                     const std::string& payload,
+                     Clock::time_point now = Clock::now());
+
+  /** Forgets the last value of topic, e.g. because publishing it failed. */
+  void Forget(const std::string& topic);
+
+  std::uint64_t published() const { return published_; }
+  std::uint64_t suppressed() const { return suppressed_; }
+
+ private:
+  struct Entry {
+    std::size_t payload_hash;
+    Clock::time_point published_at;
+  };
+  std::map<TopicClass, Clock::duration> refresh_intervals_;
+  // Guards entries_.
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::uint64_t published_ = 0;
+  std::uint64_t suppressed_ = 0;
+};
+#endif  // _LAST_VALUE_CACHE_H_
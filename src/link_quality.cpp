@@ -0,0 +1,51 @@
+#include "link_quality.h"
+#include <algorithm>
+#include <cmath>
+
+LinkQualityAggregator::LinkQualityAggregator(double smoothing, double band)
+    : smoothing_(smoothing), band_(band) {}
+
+bool LinkQualityAggregator::Add(znp::ShortAddress address,
+                                std::uint8_t link_quality) {
+  auto found = devices_.find(address);
+  if (found == devices_.end()) {
+    devices_.emplace(address, Device{{link_quality, link_quality, 1,
+                                      (double)link_quality},
+                                     boost::none});
+    return true;
+  }
+  LinkQualityStats& stats = found->second.stats;
+  if (stats.samples == 0) {
+    stats.min = stats.max = link_quality;
+  } else {
+    stats.min = std::min(stats.min, link_quality);
+    stats.max = std::max(stats.max, link_quality);
+  }
+  stats.samples++;
+  stats.average += smoothing_ * ((double)link_quality - stats.average);
+  const auto& taken_average = found->second.taken_average;
+  return !taken_average ||
+         std::fabs(stats.average - *taken_average) > band_;
+}
+
+boost::optional<LinkQualityStats> LinkQualityAggregator::Take(
+    znp::ShortAddress address) {
+  auto found = devices_.find(address);
+  if (found == devices_.end() || found->second.stats.samples == 0) {
+    return boost::none;
+  }
+  LinkQualityStats stats = found->second.stats;
+  found->second.stats.samples = 0;
+  found->second.taken_average = stats.average;
+  return stats;
+}
+
+std::vector<znp::ShortAddress> LinkQualityAggregator::Pending() const {
+  std::vector<znp::ShortAddress> pending;
+  for (const auto& device : devices_) {
+    if (device.second.stats.samples > 0) {
+      pending.push_back(device.first);
+    }
+  }
+  return pending;
+}
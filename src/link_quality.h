@@ -0,0 +1,51 @@
+#ifndef _LINK_QUALITY_H_
+#define _LINK_QUALITY_H_
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "znp/znp.h"
+
+struct LinkQualityStats {
+  // Minimum, maximum & number of samples since the stats were last taken.
+  std::uint8_t min;
+  std::uint8_t max;
+  std::uint64_t samples;
+  // Exponentially weighted moving average over all samples.
+  double average;
+};
+
+/**
+ * Aggregates the link quality of incoming frames per device, keyed by short
+ * address so no address lookup is needed per frame.
+ *
+ * Stats are meant to be taken and published periodically. Add() additionally
+ * signals when a device's average moved more than band away from the value
+ * last taken, so significant changes can be published right away.
+ */
+class LinkQualityAggregator {
+ public:
+  /** smoothing is the weight of a new sample in the moving average. */
+  LinkQualityAggregator(double smoothing, double band);
+
+  /** Returns true if the stats of address should be taken and published now,
+   * i.e. its first sample, or when the average left the band. */
+  bool Add(znp::ShortAddress address, std::uint8_t link_quality);
+
+  /** Returns the stats of address and starts a new min/max window, or
+   * boost::none if there were no samples since the last Take(). */
+  boost::optional<LinkQualityStats> Take(znp::ShortAddress address);
+
+  /** Addresses with samples since their last Take(). */
+  std::vector<znp::ShortAddress> Pending() const;
+
+ private:
+  struct Device {
+    LinkQualityStats stats;
+    boost::optional<double> taken_average;
+  };
+  const double smoothing_;
+  const double band_;
+  std::map<znp::ShortAddress, Device> devices_;
+};
+#endif  // _LINK_QUALITY_H_
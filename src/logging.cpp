@@ -1,4 +1,19 @@
 #include "logging.h"
+#include <algorithm>
+#include <atomic>
+#include <boost/align/aligned_allocator.hpp>
+#include <boost/core/null_deleter.hpp>
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <boost/make_shared.hpp>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
 
 std::ostream& operator<<(std::ostream& stream, const severity_level& level) {
 	switch (level) {
@@ -11,3 +26,217 @@ std::ostream& operator<<(std::ostream& stream, const severity_level& level) {
 		default: return stream << (unsigned int)level;
 	}
 }
+
+namespace {
+struct LogLevels {
+  severity_level default_level = info;
+  std::map<std::string, severity_level, std::less<>> channels;
+};
+
+// Replaced as a whole by SetLogLevels(), so readers never see half of a spec.
+std::shared_ptr<const LogLevels> current_levels =
+    std::make_shared<const LogLevels>();
+// Lowest and highest level of any channel, so most records are decided
+// without looking at current_levels.
+std::atomic<int> lowest_level(info);
+std::atomic<int> highest_level(info);
+
+std::atomic<std::uint64_t> records_dropped(0);
+
+bool ParseSeverity(boost::string_view text, severity_level& level) {
+  static const std::pair<const char*, severity_level> names[] = {
+      {"trace", trace},     {"debug", debug}, {"info", info},
+      {"warning", warning}, {"error", error}, {"critical", critical}};
+  for (const auto& name : names) {
+    if (text == name.first) {
+      level = name.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Queueing strategy for boost::log::sinks::asynchronous_sink: a bounded
+ * lock-free queue, which drops records instead of blocking the logging
+ * thread when full. The feeding thread only sleeps when the queue is empty.
+ */
+class DroppingQueue {
+ protected:
+  DroppingQueue() : queue_(ConsoleLog::kQueueSize) {}
+  template <typename ArgsT>
+  explicit DroppingQueue(const ArgsT&) : DroppingQueue() {}
+  ~DroppingQueue() {
+    boost::log::record_view* rec;
+    while (queue_.pop(rec)) {
+      delete rec;
+    }
+  }
+
+  void enqueue(const boost::log::record_view& rec) { try_enqueue(rec); }
+
+  bool try_enqueue(const boost::log::record_view& rec) {
+    std::unique_ptr<boost::log::record_view> copy(
+        new boost::log::record_view(rec));
+    if (!queue_.bounded_push(copy.get())) {
+      // Still report success, or the core retries with a blocking enqueue().
+      records_dropped++;
+      return true;
+    }
+    copy.release();
+    // The push is only a release store, which a later load may be ordered
+    // before. Pairs with the fence in dequeue_ready(), so that either the
+    // feeding thread sees this record or this thread sees it waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.notify_one();
+    }
+    return true;
+  }
+
+  bool try_dequeue_ready(boost::log::record_view& rec) { return Pop(rec); }
+
+  bool try_dequeue(boost::log::record_view& rec) { return Pop(rec); }
+
+  bool dequeue_ready(boost::log::record_view& rec) {
+    if (Pop(rec)) {
+      return true;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      if (interrupted_) {
+        interrupted_ = false;
+        return false;
+      }
+      // Announce the wait before checking once more, so a record pushed in
+      // between either is seen here or notifies.
+      waiting_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (Pop(rec)) {
+        waiting_ = false;
+        return true;
+      }
+      ready_.wait(lock);
+      waiting_ = false;
+      if (Pop(rec)) {
+        return true;
+      }
+    }
+  }
+
+  void interrupt_dequeue() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    interrupted_ = true;
+    ready_.notify_one();
+  }
+
+ private:
+  bool Pop(boost::log::record_view& rec) {
+    boost::log::record_view* popped;
+    if (!queue_.pop(popped)) {
+      return false;
+    }
+    rec.swap(*popped);
+    delete popped;
+    return true;
+  }
+
+  // The queue's nodes are cache line aligned, which std::allocator doesn't
+  // guarantee before C++17.
+  boost::lockfree::queue<
+      boost::log::record_view*,
+      boost::lockfree::allocator<
+          boost::alignment::aligned_allocator<boost::log::record_view*, 64>>>
+      queue_;
+  std::atomic<bool> waiting_{false};
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool interrupted_ = false;
+};
+
+typedef boost::log::sinks::asynchronous_sink<
+    boost::log::sinks::text_ostream_backend, DroppingQueue>
+    ConsoleSink;
+}  // namespace
+
+bool LogEnabled(boost::string_view channel, severity_level severity) {
+  if (severity >= highest_level.load(std::memory_order_relaxed)) {
+    return true;
+  }
+  if (severity < lowest_level.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  std::shared_ptr<const LogLevels> levels = std::atomic_load(&current_levels);
+  auto found = levels->channels.find(channel);
+  return severity >= (found == levels->channels.end() ? levels->default_level
+                                                      : found->second);
+}
+
+bool SetLogLevels(const std::string& spec) {
+  auto levels = std::make_shared<LogLevels>();
+  boost::string_view remaining(spec);
+  bool first = true;
+  bool more = true;
+  while (more) {
+    const std::size_t comma = remaining.find(',');
+    boost::string_view item = remaining.substr(0, comma);
+    more = comma != boost::string_view::npos;
+    remaining.remove_prefix(more ? comma + 1 : remaining.size());
+    std::size_t equals = item.find('=');
+    if (equals == boost::string_view::npos) {
+      if (!first || !ParseSeverity(item, levels->default_level)) {
+        return false;
+      }
+    } else {
+      boost::string_view channel = item.substr(0, equals);
+      severity_level level;
+      if (channel.empty() || !ParseSeverity(item.substr(equals + 1), level)) {
+        return false;
+      }
+      levels->channels[channel.to_string()] = level;
+    }
+    first = false;
+  }
+  int lowest = levels->default_level;
+  int highest = levels->default_level;
+  for (const auto& channel : levels->channels) {
+    lowest = std::min<int>(lowest, channel.second);
+    highest = std::max<int>(highest, channel.second);
+  }
+  // Widen the range before publishing the new levels, and narrow it after,
+  // so no record is decided on a range that doesn't cover them.
+  lowest_level = std::min<int>(lowest, lowest_level);
+  highest_level = std::max<int>(highest, highest_level);
+  std::atomic_store(&current_levels,
+                    std::shared_ptr<const LogLevels>(std::move(levels)));
+  lowest_level = lowest;
+  highest_level = highest;
+  return true;
+}
+
+std::uint64_t LogRecordsDropped() { return records_dropped; }
+
+struct ConsoleLog::Impl {
+  boost::shared_ptr<ConsoleSink> sink;
+};
+
+ConsoleLog::ConsoleLog() : impl_(new Impl) {
+  impl_->sink = boost::make_shared<ConsoleSink>();
+  impl_->sink->locked_backend()->add_stream(
+      boost::shared_ptr<std::ostream>(&std::cerr, boost::null_deleter()));
+  impl_->sink->locked_backend()->auto_flush(true);
+  impl_->sink->set_formatter(
+      boost::log::expressions::stream
+      << "<" << boost::log::expressions::attr<severity_level>("Severity") << ">"
+      << " "
+      << "[" << boost::log::expressions::attr<std::string>("Channel") << "] "
+      << boost::log::expressions::message);
+  boost::log::core::get()->add_sink(impl_->sink);
+}
+
+ConsoleLog::~ConsoleLog() {
+  boost::log::core::get()->remove_sink(impl_->sink);
+  impl_->sink->stop();
+  impl_->sink->flush();
+}
@@ -4,11 +4,60 @@
 #include <boost/log/sources/channel_logger.hpp>
 #include <boost/log/sources/severity_channel_logger.hpp>
 #include <boost/log/sources/severity_logger.hpp>
+#include <boost/utility/string_view.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
 
 enum severity_level { trace, debug, info, warning, error, critical };
 
 std::ostream& operator<<(std::ostream& stream, const severity_level& level);
 
+// Logging below this severity is left out of the build altogether. Configure
+// with -DLOG_TRACE=ON to keep trace logging.
+#if defined(LOG_TRACE)
+constexpr severity_level kMinCompiledSeverity = trace;
+#else
+constexpr severity_level kMinCompiledSeverity = debug;
+#endif
+
+/** Whether records of severity on channel pass the runtime filter. Only looks
+ * up channel when some channel has a level of its own between the levels of
+ * the others. */
+bool LogEnabled(boost::string_view channel, severity_level severity);
+
+/** Sets the minimum severity to log at from a comma-separated spec like
+ * "info,FRAME=debug,OnPublish=warning": optionally a default level for all
+ * channels, followed by levels of specific channels. Levels are trace, debug,
+ * info, warning, error, or critical. Returns false, changing nothing, if spec
+ * is malformed. Not to be called from several threads at once. */
+bool SetLogLevels(const std::string& spec);
+
+/** Number of records dropped because the console couldn't keep up. */
+std::uint64_t LogRecordsDropped();
+
+/**
+ * Logs to the console (stderr) while alive.
+ *
+ * Records are formatted and written on a thread of their own, so logging never
+ * waits for the console. At most kQueueSize records wait to be written,
+ * further ones are dropped and counted by LogRecordsDropped(). Records still
+ * waiting are written out on destruction.
+ */
+class ConsoleLog {
+ public:
+  static const std::size_t kQueueSize = 4096;
+
+  ConsoleLog();
+  ~ConsoleLog();
+  ConsoleLog(const ConsoleLog&) = delete;
+  ConsoleLog& operator=(const ConsoleLog&) = delete;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+};
+
 typedef boost::log::sources::severity_channel_logger_mt<severity_level,
                                                         std::string>
     my_logger_mt;
@@ -18,6 +67,12 @@ BOOST_LOG_INLINE_GLOBAL_LOGGER_CTOR_ARGS(
     (boost::log::keywords::severity = debug)(
         boost::log::keywords::channel = "main"))
 
-#define LOG(channel, severity) \
+// Checks the filters before Boost.Log opens a record, and the streamed
+// arguments, like boost::log::dump(), are only evaluated when it's logged. A
+// loop rather than an if, so it can't capture the else of an enclosing if.
+#define LOG(channel, severity)                                           \
+  for (bool log_enabled_ = (severity) >= kMinCompiledSeverity &&         \
+                           LogEnabled((channel), (severity));            \
+       log_enabled_; log_enabled_ = false)                               \
   BOOST_LOG_CHANNEL_SEV(main_logger::get(), channel, severity)
 #endif  // _LOGGING_H_
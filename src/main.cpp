@@ -1,32 +1,54 @@
 // vim: set shiftwidth=2 tabstop=2 expandtab:
+#include <unistd.h>
 #include <boost/algorithm/hex.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio.hpp>
 #include <boost/format.hpp>
-#include <boost/log/expressions.hpp>
 #include <boost/log/utility/manipulators/dump.hpp>
-#include <boost/log/utility/setup/console.hpp>
 #include <boost/program_options.hpp>
+#include <cerrno>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <regex>
 #include <sstream>
+#include <stlab/concurrency/default_executor.hpp>
 #include <stlab/concurrency/future.hpp>
 #include <stlab/concurrency/immediate_executor.hpp>
 #include <stlab/concurrency/utility.hpp>
+#include <thread>
 
 #include "asio_executor.h"
+#include "clusterdb/atomic_cluster_db.h"
+#include "clusterdb/builtin_image.h"
 #include "clusterdb/cluster_db.h"
+#include "clusterdb/cluster_db_watcher.h"
 #include "coro.h"
+#include "device_lanes.h"
+#include "device_registry.h"
+#include "device_state.h"
 #include "dynamic_encoding/decoding.h"
 #include "dynamic_encoding/encoding.h"
+#include "flatten_value.h"
+#include "flight_recorder.h"
+#include "last_value_cache.h"
+#include "link_quality.h"
 #include "logging.h"
+#include "message_arena.h"
+#include "mqtt_router.h"
 #include "mqtt_wrapper.h"
+#include "network_monitor.h"
+#include "payload_format.h"
+#include "publish_policy.h"
 #include "string_enum.h"
 #include "zcl/encoding.h"
 #include "zcl/zcl.h"
 #include "zcl/zcl_endpoint.h"
 #include "zcl/zcl_string_enum.h"
 #include "znp/encoding.h"
+#include "znp/threaded_znp_port.h"
 #include "znp/znp_api.h"
 #include "znp/znp_port.h"
 
@@ -132,6 +154,68 @@ void OnPublishPermitJoin(std::shared_ptr<znp::ZnpApi> api,
   return;
 }
 
+void OnPublishLogLevel(const std::string& message) {
+  if (!SetLogLevels(message)) {
+    LOG("OnPublishLogLevel", warning)
+        << "Unable to parse loglevel contents '" << message << "'";
+    return;
+  }
+  LOG("OnPublishLogLevel", info) << "Log levels set to '" << message << "'";
+}
+
+/** Writes the flight recorder's entries to filename, for
+ * tools/flight_recorder_dump to read.
+ *
+ * The dump goes to a new, randomly named file next to filename, which is then
+ * renamed over it. filename may be in a world-writable directory such as /tmp,
+ * and this never opens, and so never follows, a link someone placed there. */
+void DumpFlightRecorder(const std::string& filename) {
+  std::ostringstream dump;
+  FlightRecorder::Global().Write(dump);
+  const std::string data = dump.str();
+
+  std::string temp_path = filename + ".XXXXXX";
+  // Opens with O_CREAT | O_EXCL, so fails rather than follows a link, and
+  // creates the file with mode 0600.
+  int fd = mkstemp(&temp_path[0]);
+  if (fd < 0) {
+    LOG("FlightRecorder", error) << "Unable to create a file next to '"
+                                 << filename << "': " << std::strerror(errno);
+    return;
+  }
+  bool ok = true;
+  std::size_t written = 0;
+  while (ok && written < data.size()) {
+    ssize_t result = write(fd, data.data() + written, data.size() - written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    ok = result > 0;
+    written += ok ? result : 0;
+  }
+  ok = close(fd) == 0 && ok;
+  ok = ok && std::rename(temp_path.c_str(), filename.c_str()) == 0;
+  if (!ok) {
+    LOG("FlightRecorder", error) << "Unable to write '" << filename
+                                 << "': " << std::strerror(errno);
+    unlink(temp_path.c_str());
+    return;
+  }
+  LOG("FlightRecorder", info) << "Dumped to '" << filename << "'";
+}
+
+void DumpFlightRecorderOnSignal(
+    std::shared_ptr<boost::asio::signal_set> signals, std::string filename) {
+  signals->async_wait(
+      [signals, filename](const boost::system::error_code& ec, int) {
+        if (ec) {
+          return;
+        }
+        DumpFlightRecorder(filename);
+        DumpFlightRecorderOnSignal(signals, filename);
+      });
+}
+
 void OnPublishDirectJoin(std::shared_ptr<znp::ZnpApi> api,
                          znp::IEEEAddress device_address) {
   api->ZdoMgmtDirectJoin(0x0000, device_address)
@@ -196,13 +280,13 @@ void SendCommand(std::shared_ptr<znp::ZnpApi> api,
 
 /** Called on MQTT publish of a long-form command, e.g. the command name is part
  * of the MQTT topic. */
-void OnPublishCommandLong(std::shared_ptr<znp::ZnpApi> api,
-                          std::shared_ptr<zcl::ZclEndpoint> endpoint,
-                          std::shared_ptr<clusterdb::ClusterDb> cluster_db,
-                          znp::IEEEAddress destination_address,
-                          std::uint8_t destination_endpoint,
-                          std::string cluster_name, std::string command_name,
-                          std::string message) {
+void OnPublishCommandLong(
+    std::shared_ptr<znp::ZnpApi> api,
+    std::shared_ptr<zcl::ZclEndpoint> endpoint,
+    std::shared_ptr<const clusterdb::ClusterDb> cluster_db,
+    znp::IEEEAddress destination_address, std::uint8_t destination_endpoint,
+    boost::string_view cluster_name, boost::string_view command_name,
+    PayloadFormat format, const std::string& message) {
   LOG("OnPublishCommandLong", debug)
       << "Destination " << destination_address << ", endpoint "
       << (unsigned int)destination_endpoint << ", cluster name '"
@@ -224,10 +308,11 @@ void OnPublishCommandLong(std::shared_ptr<znp::ZnpApi> api,
   tao::json::value json_data = tao::json::null;
   if (message.size() > 0) {
     try {
-      json_data = tao::json::from_string(message);
+      json_data = DecodePayload(format, message);
     } catch (const std::exception& ex) {
       LOG("OnPublishCommandLong", error)
-          << "Unable to decode message payload as JSON: " << ex.what();
+          << "Unable to decode message payload as " << enum_to_string(format)
+          << ": " << ex.what();
       return;
     }
   }
@@ -241,13 +326,14 @@ void OnPublishCommandLong(std::shared_ptr<znp::ZnpApi> api,
 }
 
 /** Called on MQTT publish of a short-form command, e.g. command name part of
- * the JSON payload. */
-void OnPublishCommandShort(std::shared_ptr<znp::ZnpApi> api,
-                           std::shared_ptr<zcl::ZclEndpoint> endpoint,
-                           std::shared_ptr<clusterdb::ClusterDb> cluster_db,
-                           znp::IEEEAddress destination_address,
-                           std::uint8_t destination_endpoint,
-                           std::string cluster_name, std::string message) {
+ * the payload object. */
+void OnPublishCommandShort(
+    std::shared_ptr<znp::ZnpApi> api,
+    std::shared_ptr<zcl::ZclEndpoint> endpoint,
+    std::shared_ptr<const clusterdb::ClusterDb> cluster_db,
+    znp::IEEEAddress destination_address, std::uint8_t destination_endpoint,
+    boost::string_view cluster_name, PayloadFormat format,
+    const std::string& message) {
   LOG("OnPublishCommandShort", debug)
       << "Destination " << destination_address << ", endpoint "
       << (unsigned int)destination_endpoint << ", cluster name '"
@@ -260,17 +346,17 @@ void OnPublishCommandShort(std::shared_ptr<znp::ZnpApi> api,
   }
   std::map<std::string, tao::json::value> obj_message;
   try {
-    obj_message = tao::json::from_string(message).get_object();
+    obj_message = DecodePayload(format, message).get_object();
   } catch (const std::exception& ex) {
-    LOG("OnPublishCommandShort", error) << "Unable to decode message payload, "
-                                           "or message was not a JSON object. "
-                                        << ex.what();
+    LOG("OnPublishCommandShort", error)
+        << "Unable to decode message payload as " << enum_to_string(format)
+        << ", or message was not an object. " << ex.what();
     return;
   }
   auto found_command = obj_message.find("command");
   if (found_command == obj_message.end()) {
     LOG("OnPublishCommandShort", error)
-        << "JSON object did not contain a 'command' property";
+        << "Message object did not contain a 'command' property";
     return;
   }
   auto command_info = cluster_db->CommandByName(
@@ -295,10 +381,49 @@ void OnPublishCommandShort(std::shared_ptr<znp::ZnpApi> api,
               arguments);
 }
 
-void OnPublish(std::shared_ptr<znp::ZnpApi> api,
-               std::shared_ptr<zcl::ZclEndpoint> endpoint,
-               std::string mqtt_prefix,
-               std::shared_ptr<clusterdb::ClusterDb> cluster_db,
+/** Builds the router for all topics we handle below our MQTT prefix. */
+std::shared_ptr<MqttRouter> MakeRouter(
+    std::shared_ptr<znp::ZnpApi> api,
+    std::shared_ptr<zcl::ZclEndpoint> endpoint,
+    std::shared_ptr<clusterdb::AtomicClusterDb> cluster_db,
+    PayloadFormat command_format, std::string flight_recorder_file) {
+  auto router = std::make_shared<MqttRouter>();
+  router->Add("write/permitjoin",
+              [api](const MqttRouter::Match&, const std::string& message) {
+                OnPublishPermitJoin(api, message);
+              });
+  router->Add("write/loglevel",
+              [](const MqttRouter::Match&, const std::string& message) {
+                OnPublishLogLevel(message);
+              });
+  router->Add("write/flightrecorder",
+              [flight_recorder_file](const MqttRouter::Match&,
+                                     const std::string&) {
+                DumpFlightRecorder(flight_recorder_file);
+              });
+  router->Add("write/directjoin/{hex}",
+              [api](const MqttRouter::Match& match, const std::string&) {
+                OnPublishDirectJoin(api, match.Number(0));
+              });
+  router->Add("{hex}/{uint}/out/{name}",
+              [api, endpoint, cluster_db, command_format](
+                  const MqttRouter::Match& match, const std::string& message) {
+                OnPublishCommandShort(api, endpoint, cluster_db->Load(),
+                                      match.Number(0), match.Number(1),
+                                      match.Text(2), command_format, message);
+              });
+  router->Add("{hex}/{uint}/out/{name}/{name}",
+              [api, endpoint, cluster_db, command_format](
+                  const MqttRouter::Match& match, const std::string& message) {
+                OnPublishCommandLong(api, endpoint, cluster_db->Load(),
+                                     match.Number(0), match.Number(1),
+                                     match.Text(2), match.Text(3),
+                                     command_format, message);
+              });
+  return router;
+}
+
+void OnPublish(std::shared_ptr<MqttRouter> router, std::string mqtt_prefix,
                std::string topic, std::string message, std::uint8_t qos,
                bool retain) {
   try {
@@ -307,49 +432,25 @@ void OnPublish(std::shared_ptr<znp::ZnpApi> api,
           << "Ignoring publish not starting with our prefix";
       return;
     }
-    topic = topic.substr(mqtt_prefix.size());
-
-    std::smatch match;
-    static std::regex re_write_permitjoin("write/permitjoin");
-    if (std::regex_match(topic, re_write_permitjoin)) {
-      OnPublishPermitJoin(api, message);
-      return;
-    }
-    static std::regex re_write_directjoin("write/directjoin/([0-9a-fA-F]+)");
-    if (std::regex_match(topic, match, re_write_directjoin)) {
-      OnPublishDirectJoin(api, std::stoull(match[1], 0, 16));
-      return;
+    boost::string_view relative_topic(topic);
+    relative_topic.remove_prefix(mqtt_prefix.size());
+    if (!router->Dispatch(relative_topic, message)) {
+      LOG("OnPublish", debug) << "Unhandled MQTT publish to " << relative_topic;
     }
-
-    static std::regex re_command_short("([0-9a-fA-F]+)/([0-9]+)/out/([^/]+)");
-    if (std::regex_match(topic, match, re_command_short)) {
-      OnPublishCommandShort(api, endpoint, cluster_db,
-                            std::stoull(match[1], 0, 16),
-                            std::stoul(match[2], 0, 10), match[3], message);
-      return;
-    }
-
-    static std::regex re_command_long(
-        "([0-9a-fA-F]+)/([0-9]+)/out/([^/]+)/([^/]+)");
-    if (std::regex_match(topic, match, re_command_long)) {
-      OnPublishCommandLong(
-          api, endpoint, cluster_db, std::stoull(match[1], 0, 16),
-          std::stoul(match[2], 0, 10), match[3], match[4], message);
-      return;
-    }
-
-    LOG("OnPublish", debug) << "Unhandled MQTT publish to " << topic;
   } catch (const std::exception& ex) {
     LOG("OnPublish", debug) << "Exception: " << ex.what();
   }
 }
 
 void OnPermitJoin(std::shared_ptr<MqttWrapper> mqtt_wrapper,
-                  std::string mqtt_prefix, uint8_t duration) {
+                  std::string mqtt_prefix,
+                  std::shared_ptr<const PublishPolicies> policies,
+                  uint8_t duration) {
+  const PublishPolicy& policy = policies->Get(TopicClass::Report);
   mqtt_wrapper
       ->Publish(mqtt_prefix + "report/permitjoin",
-                boost::str(boost::format("%d") % (unsigned int)duration),
-                mqtt::qos::at_least_once, false)
+                EncodePayload(policy.format, (unsigned int)duration),
+                policy.qos, policy.retain, policy.expiry)
       .recover([](auto f) {
         try {
           f.get_try();
@@ -362,9 +463,13 @@ void OnPermitJoin(std::shared_ptr<MqttWrapper> mqtt_wrapper,
 }
 
 void OnTcDevice(std::shared_ptr<MqttWrapper> mqtt_wrapper,
-                std::string mqtt_prefix, znp::ShortAddress network_address,
+                std::string mqtt_prefix,
+                std::shared_ptr<const PublishPolicies> policies,
+                std::shared_ptr<DeviceRegistry> device_registry,
+                znp::ShortAddress network_address,
                 znp::IEEEAddress ieee_address,
                 znp::ShortAddress parent_address) {
+  device_registry->SetShortAddress(ieee_address, network_address);
   const tao::json::value information = {
       {"network_address", network_address},
       {"ieee_address", boost::str(boost::format("%016X") % ieee_address)},
@@ -373,10 +478,11 @@ void OnTcDevice(std::shared_ptr<MqttWrapper> mqtt_wrapper,
   LOG("OnTcDevice", info) << "Device added to trustcenter: "
                           << boost::str(boost::format("%016X") % ieee_address);
 
+  const PublishPolicy& policy = policies->Get(TopicClass::Report);
   mqtt_wrapper
       ->Publish(mqtt_prefix + "report/trustcenter_device",
-                tao::json::to_string(information), mqtt::qos::at_least_once,
-                false)
+                EncodePayload(policy.format, information), policy.qos,
+                policy.retain, policy.expiry)
       .recover([](auto f) {
         try {
           f.get_try();
@@ -390,9 +496,12 @@ void OnTcDevice(std::shared_ptr<MqttWrapper> mqtt_wrapper,
 
 void OnEndDeviceAnnounce(std::shared_ptr<MqttWrapper> mqtt_wrapper,
                          std::string mqtt_prefix,
+                         std::shared_ptr<const PublishPolicies> policies,
+                         std::shared_ptr<DeviceRegistry> device_registry,
                          znp::ShortAddress source_address,
                          znp::ShortAddress network_address,
                          znp::IEEEAddress ieee_address, uint8_t capabilities) {
+  device_registry->SetShortAddress(ieee_address, network_address);
   const tao::json::value information = {
       {"source", source_address},
       {"network_address", network_address},
@@ -403,10 +512,11 @@ void OnEndDeviceAnnounce(std::shared_ptr<MqttWrapper> mqtt_wrapper,
       << "End device announced: "
       << boost::str(boost::format("%016X") % ieee_address);
 
+  const PublishPolicy& policy = policies->Get(TopicClass::Report);
   mqtt_wrapper
       ->Publish(mqtt_prefix + "report/end_device_announce",
-                tao::json::to_string(information), mqtt::qos::at_least_once,
-                false)
+                EncodePayload(policy.format, information), policy.qos,
+                policy.retain, policy.expiry)
       .recover([](auto f) {
         try {
           f.get_try();
@@ -418,70 +528,246 @@ void OnEndDeviceAnnounce(std::shared_ptr<MqttWrapper> mqtt_wrapper,
       .detach();
 }
 
-void OnIncomingMsg(std::shared_ptr<znp::ZnpApi> api,
-                   std::shared_ptr<MqttWrapper> mqtt_wrapper,
-                   std::string mqtt_prefix, const znp::IncomingMsg& message) {
-  api->UtilAddrmgrNwkAddrLookup(message.SrcAddr)
-      .then([message, mqtt_wrapper, mqtt_prefix](znp::IEEEAddress ieee_addr) {
-        return mqtt_wrapper->Publish(
-            boost::str(boost::format("%s%016X/linkquality") % mqtt_prefix %
-                       ieee_addr),
-            boost::str(boost::format("%d") % (unsigned int)message.LinkQuality),
-            mqtt::qos::at_least_once, false);
+/** Topics of batch, to forget their last values in case publishing them fails,
+ * or none if topic_class isn't suppressed anyway. */
+std::vector<std::string> TopicsToForget(
+    const LastValueCache& last_value_cache, TopicClass topic_class,
+    const std::vector<MqttWrapper::Message>& batch) {
+  std::vector<std::string> topics;
+  if (last_value_cache.enabled(topic_class)) {
+    topics.reserve(batch.size());
+    for (const auto& message : batch) {
+      topics.push_back(message.topic_name);
+    }
+  }
+  return topics;
+}
+
+void OnDeviceState(std::shared_ptr<MqttWrapper> mqtt_wrapper,
+                   std::shared_ptr<DeviceRegistry> device_registry,
+                   std::shared_ptr<LastValueCache> last_value_cache,
+                   std::shared_ptr<const PublishPolicies> policies,
+                   znp::IEEEAddress address, const tao::json::value& state) {
+  std::string topic = device_registry->Get(address).topic_prefix + "state";
+  const PublishPolicy& policy = policies->Get(TopicClass::State);
+  std::string payload = EncodePayload(policy.format, state);
+  if (!last_value_cache->ShouldPublish(TopicClass::State, topic, payload)) {
+    return;
+  }
+  LOG("OnDeviceState", info) << "Publishing to '" << topic
+                             << "': " << PayloadForLog(policy.format, payload);
+  mqtt_wrapper->Publish(topic, payload, policy.qos, policy.retain,
+                        policy.expiry)
+      .recover([last_value_cache, topic](auto f) {
+        try {
+          f.get_try();
+        } catch (const std::exception& ex) {
+          LOG("OnDeviceState", warning)
+              << "Unable to publish device state: " << ex.what();
+          last_value_cache->Forget(topic);
+        }
       })
-      .recover([](auto f) {
+      .detach();
+}
+
+/** Publishes how many messages the last value cache saved, every interval. */
+void PublishLastValueCacheStats(
+    std::shared_ptr<boost::asio::deadline_timer> timer,
+    boost::posix_time::time_duration interval,
+    std::shared_ptr<MqttWrapper> mqtt_wrapper, std::string mqtt_prefix,
+    std::shared_ptr<const PublishPolicies> policies,
+    std::shared_ptr<LastValueCache> last_value_cache) {
+  timer->expires_from_now(interval);
+  timer->async_wait([timer, interval, mqtt_wrapper, mqtt_prefix, policies,
+                     last_value_cache](const boost::system::error_code& ec) {
+    if (ec) {
+      return;
+    }
+    const tao::json::value stats = {
+        {"published", last_value_cache->published()},
+        {"suppressed", last_value_cache->suppressed()}};
+    LOG("LastValueCache", info)
+        << "Statistics: " << tao::json::to_string(stats);
+    const PublishPolicy& policy = policies->Get(TopicClass::Report);
+    mqtt_wrapper
+        ->Publish(mqtt_prefix + "report/last_value_cache",
+                  EncodePayload(policy.format, stats), policy.qos,
+                  policy.retain, policy.expiry)
+        .recover([](auto f) {
+          try {
+            f.get_try();
+          } catch (const std::exception& ex) {
+            LOG("LastValueCache", debug) << "Publish failure: " << ex.what();
+          }
+        })
+        .detach();
+    PublishLastValueCacheStats(timer, interval, mqtt_wrapper, mqtt_prefix,
+                               policies, last_value_cache);
+  });
+}
+
+void PublishMqttStats(std::shared_ptr<boost::asio::deadline_timer> timer,
+                      boost::posix_time::time_duration interval,
+                      std::shared_ptr<MqttWrapper> mqtt_wrapper,
+                      std::string mqtt_prefix,
+                      std::shared_ptr<const PublishPolicies> policies) {
+  timer->expires_from_now(interval);
+  timer->async_wait([timer, interval, mqtt_wrapper, mqtt_prefix,
+                     policies](const boost::system::error_code& ec) {
+    if (ec) {
+      return;
+    }
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+    MqttWrapper::Stats stats = mqtt_wrapper->stats();
+    const InflightWindow::Stats& inflight = stats.inflight;
+    const MqttWrapper::ConnectionStats& connection = stats.connection;
+    const tao::json::value json_stats = {
+        {"queue",
+         {{"queued", stats.queue.queued},
+          {"dropped", stats.queue.dropped},
+          {"coalesced", stats.queue.coalesced},
+          {"expired", stats.queue.expired}}},
+        {"inflight",
+         {{"depth", inflight.depth},
+          {"max_depth", inflight.max_depth},
+          {"acknowledged", inflight.acknowledged},
+          {"average_latency_ms",
+           inflight.acknowledged == 0
+               ? 0.0
+               : Milliseconds(inflight.total_latency).count() /
+                     inflight.acknowledged},
+          {"max_latency_ms", Milliseconds(inflight.max_latency).count()}}},
+        {"connection",
+         {{"reconnects", connection.reconnects},
+          {"last_outage_ms", Milliseconds(connection.last_outage).count()},
+          {"max_outage_ms", Milliseconds(connection.max_outage).count()},
+          {"last_drain_ms", Milliseconds(connection.last_drain).count()}}},
+        {"log", {{"dropped", LogRecordsDropped()}}}};
+    LOG("MqttWrapper", info)
+        << "Statistics: " << tao::json::to_string(json_stats);
+    const PublishPolicy& policy = policies->Get(TopicClass::Report);
+    mqtt_wrapper
+        ->Publish(mqtt_prefix + "report/mqtt",
+                  EncodePayload(policy.format, json_stats), policy.qos,
+                  policy.retain, policy.expiry)
+        .recover([](auto f) {
+          try {
+            f.get_try();
+          } catch (const std::exception& ex) {
+            LOG("MqttWrapper", debug) << "Publish failure: " << ex.what();
+          }
+        })
+        .detach();
+    PublishMqttStats(timer, interval, mqtt_wrapper, mqtt_prefix, policies);
+  });
+}
+
+void PublishLinkQuality(std::shared_ptr<MqttWrapper> mqtt_wrapper,
+                        std::shared_ptr<DeviceRegistry> device_registry,
+                        std::shared_ptr<LastValueCache> last_value_cache,
+                        std::shared_ptr<const PublishPolicies> policies,
+                        znp::IEEEAddress address,
+                        const LinkQualityStats& stats) {
+  DeviceRegistry::Device& device = device_registry->Get(address);
+  device.link_quality = stats;
+  const tao::json::value json_stats = {{"min", (unsigned int)stats.min},
+                                       {"max", (unsigned int)stats.max},
+                                       {"average", stats.average},
+                                       {"samples", stats.samples}};
+  const PublishPolicy& policy = policies->Get(TopicClass::LinkQuality);
+  std::vector<MqttWrapper::Message> batch{
+      {device.topic_prefix + "linkquality",
+       EncodePayload(policy.format, std::lround(stats.average)), policy.qos,
+       policy.retain, policy.expiry},
+      {device.topic_prefix + "linkquality/stats",
+       EncodePayload(policy.format, json_stats), policy.qos, policy.retain,
+       policy.expiry}};
+  batch.erase(std::remove_if(batch.begin(), batch.end(),
+                             [&last_value_cache](const auto& message) {
+                               return !last_value_cache->ShouldPublish(
+                                   TopicClass::LinkQuality, message.topic_name,
+                                   message.message);
+                             }),
+              batch.end());
+  std::vector<std::string> topics =
+      TopicsToForget(*last_value_cache, TopicClass::LinkQuality, batch);
+  mqtt_wrapper->PublishBatch(std::move(batch))
+      .recover([last_value_cache, topics](auto f) {
         try {
           f.get_try();
         } catch (const std::exception& ex) {
-          LOG("OnIncomingMsg", warning)
+          LOG("PublishLinkQuality", warning)
               << "Unable to publish link quality: " << ex.what();
+          for (const auto& topic : topics) {
+            last_value_cache->Forget(topic);
+          }
         }
       })
       .detach();
 }
 
-stlab::future<void> PublishValue(std::shared_ptr<MqttWrapper> mqtt_wrapper,
-                                 const std::string& topic, bool recursive,
-                                 const tao::json::value& value) {
-  std::string value_as_string(tao::json::to_string(value));
-  LOG("PublishValue", info)
-      << "Publishing to '" << topic << "': " << value_as_string;
-  std::vector<stlab::future<void>> futures;
-  futures.push_back(
-      mqtt_wrapper
-          ->Publish(topic, value_as_string, mqtt::qos::at_least_once, false)
-          .recover([](auto f) {
-            try {
-              f.get_try();
-            } catch (const std::exception& ex) {
-              LOG("PublishValue", warning)
-                  << "Unable to publish to MQTT: " << ex.what();
-            }
-          }));
-  if (recursive) {
-    if (value.is_object()) {
-      const tao::json::value::object_t& object_value = value.get_object();
-      for (const auto& item : object_value) {
-        futures.push_back(PublishValue(
-            mqtt_wrapper,
-            boost::str(boost::format("%s/%s") % topic % item.first), recursive,
-            item.second));
-      }
-    } else if (value.is_array()) {
-      const tao::json::value::array_t& array_value = value.get_array();
-      for (std::size_t index = 0; index < array_value.size(); index++) {
-        futures.push_back(PublishValue(
-            mqtt_wrapper, boost::str(boost::format("%s/%d") % topic % index),
-            recursive, array_value[index]));
-      }
-    }
+/** Takes the link quality stats of the device using short_address and
+ * publishes them. Only looks up its IEEE address with the dongle if the
+ * device registry doesn't know it yet. */
+void FlushLinkQuality(std::shared_ptr<znp::ZnpApi> api,
+                      std::shared_ptr<MqttWrapper> mqtt_wrapper,
+                      std::shared_ptr<DeviceRegistry> device_registry,
+                      std::shared_ptr<LastValueCache> last_value_cache,
+                      std::shared_ptr<const PublishPolicies> policies,
+                      std::shared_ptr<LinkQualityAggregator> link_quality,
+                      znp::ShortAddress short_address) {
+  auto stats = link_quality->Take(short_address);
+  if (!stats) {
+    return;
   }
-  if (futures.size() == 1) {
-    return futures[0];
-  } else {
-    return stlab::when_all(
-        stlab::immediate_executor, []() {},
-        std::make_pair(futures.begin(), futures.end()));
+  if (auto* device = device_registry->FindByShortAddress(short_address)) {
+    PublishLinkQuality(mqtt_wrapper, device_registry, last_value_cache,
+                       policies, device->address, *stats);
+    return;
+  }
+  api->UtilAddrmgrNwkAddrLookup(short_address)
+      .then([mqtt_wrapper, device_registry, last_value_cache, policies,
+             short_address, stats](znp::IEEEAddress address) {
+        device_registry->SetShortAddress(address, short_address);
+        PublishLinkQuality(mqtt_wrapper, device_registry, last_value_cache,
+                           policies, address, *stats);
+      })
+      .recover([](auto f) {
+        try {
+          f.get_try();
+        } catch (const std::exception& ex) {
+          LOG("FlushLinkQuality", warning)
+              << "Unable to look up long address of device: " << ex.what();
+        }
+      })
+      .detach();
+}
+
+/** Publishes the link quality of every device that sent frames since, every
+ * interval. */
+void FlushLinkQualityPeriodically(
+    std::shared_ptr<boost::asio::deadline_timer> timer,
+    boost::posix_time::time_duration interval,
+    std::function<void(znp::ShortAddress)> flush,
+    std::shared_ptr<LinkQualityAggregator> link_quality) {
+  timer->expires_from_now(interval);
+  timer->async_wait([timer, interval, flush,
+                     link_quality](const boost::system::error_code& ec) {
+    if (ec) {
+      return;
+    }
+    for (znp::ShortAddress short_address : link_quality->Pending()) {
+      flush(short_address);
+    }
+    FlushLinkQualityPeriodically(timer, interval, flush, link_quality);
+  });
+}
+
+void OnIncomingMsg(std::shared_ptr<LinkQualityAggregator> link_quality,
+                   std::function<void(znp::ShortAddress)> flush,
+                   const std::shared_ptr<const znp::IncomingMsg>& message) {
+  if (link_quality->Add(message->SrcAddr, message->LinkQuality)) {
+    flush(message->SrcAddr);
   }
 }
 
@@ -507,92 +793,215 @@ const tao::json::value::array_t& JsonAsArray(const tao::json::value& array) {
   return array.get_array();
 }
 
-void OnZclCommand(std::shared_ptr<MqttWrapper> mqtt_wrapper,
-                  std::string mqtt_prefix, bool mqtt_recursive_publish,
-                  znp::IEEEAddress source_address, uint8_t source_endpoint,
-                  std::shared_ptr<const clusterdb::ClusterInfo> cluster_info,
-                  std::shared_ptr<const clusterdb::CommandInfo> command_info,
-                  std::vector<uint8_t> payload) {
-  std::string topic(boost::str(
-      boost::format("%s%016X/%d/in/%s/%s") % mqtt_prefix % source_address %
-      (unsigned int)source_endpoint % cluster_info->name % command_info->name));
+// Weight of a new link quality sample in the moving average.
+const double kLinkQualitySmoothing = 0.2;
+
+// Cluster whose commands & attributes are published as TopicClass::Alarm.
+const zcl::ZclClusterId kIasZoneClusterId = (zcl::ZclClusterId)0x0500;
+
+/** If command's payload is a list of per-attribute records (e.g. Report
+ * Attributes), returns the type of those records. Their first property is the
+ * attribute ID, the second its value. */
+const dynamic_encoding::ObjectType* AttributeRecordType(
+    const clusterdb::CommandInfo& command_info) {
+  if (command_info.data.properties.size() == 0) {
+    return nullptr;
+  }
+  const auto* repeated_type = boost::relaxed_get<dynamic_encoding::ArrayType>(
+      &command_info.data.properties[0].type);
+  if (!repeated_type) {
+    return nullptr;
+  }
+  const auto* repeated_object_type =
+      boost::relaxed_get<dynamic_encoding::ObjectType>(
+          &repeated_type->element_type);
+  if (!repeated_object_type ||
+      repeated_object_type->properties.size() < 2 ||
+      !(repeated_object_type->properties[0].type ==
+        dynamic_encoding::AnyType(zcl::DataType::attribId))) {
+    return nullptr;
+  }
+  return repeated_object_type;
+}
+
+/** Name to publish an attribute under, its ID when the name is unknown. */
+std::string AttributeName(const tao::json::value& attribute_id) {
+  if (attribute_id.is_string()) {
+    return attribute_id.get_string();
+  } else if (attribute_id.is_unsigned()) {
+    return boost::str(boost::format("0x%04X") % attribute_id.get_unsigned());
+  } else {
+    return tao::json::to_string(attribute_id);
+  }
+}
+
+struct DecodedCommand {
   tao::json::value json_payload;
+  std::vector<MqttWrapper::Message> batch;
+};
+
+/** Decodes a command's payload, and unless topic is empty, encodes the
+ * messages to publish it with. Touches nothing but its arguments, so it may
+ * run on any thread. */
+boost::optional<DecodedCommand> DecodeZclCommand(
+    bool mqtt_recursive_publish, dynamic_encoding::ValueProfile value_profile,
+    const clusterdb::ClusterInfo& cluster_info,
+    const clusterdb::CommandInfo& command_info, const zcl::ZclMessage& message,
+    std::string topic, const PublishPolicy& policy) {
+  DecodedCommand decoded;
   try {
     dynamic_encoding::Context ctx;
-    ctx.cluster = *cluster_info;
-    auto parsed_until = payload.cbegin();
-    json_payload = dynamic_encoding::Decode(ctx, command_info->data,
-                                            parsed_until, payload.cend());
-    if (parsed_until != payload.cend()) {
+    ctx.cluster = cluster_info;
+    ctx.profile = value_profile;
+    auto parsed_until = message.payload_begin();
+    decoded.json_payload = dynamic_encoding::Decode(
+        ctx, command_info.data, parsed_until, message.payload_end());
+    if (parsed_until != message.payload_end()) {
       LOG("OnZclCommand", warning) << "Not all data properly parsed";
     }
   } catch (const std::exception& ex) {
     LOG("OnZclCommand", warning)
         << "Unable to decode command payload: " << ex.what();
-    return;
+    FlightRecorder::Global().Add(
+        FlightRecorder::Kind::DecodeError, message.cluster_id(),
+        message.payload_size() == 0 ? nullptr : &*message.payload_begin(),
+        message.payload_size());
+    return boost::none;
   }
-  std::vector<stlab::future<void>> futures;
-  futures.push_back(
-      PublishValue(mqtt_wrapper, topic, mqtt_recursive_publish, json_payload));
-
-  // Is this a repeated object type, with attribId as first property?
-  if (command_info->data.properties.size() > 0) {
-    if (const auto* repeated_type =
-            boost::relaxed_get<dynamic_encoding::ArrayType>(
-                &command_info->data.properties[0].type)) {
-      if (const auto* repeated_object_type =
-              boost::relaxed_get<dynamic_encoding::ObjectType>(
-                  &repeated_type->element_type)) {
-        if (repeated_object_type->properties.size() >= 2 &&
-            repeated_object_type->properties[0].type ==
-                dynamic_encoding::AnyType(zcl::DataType::attribId)) {
-          LOG("OnZclCommand", info) << "Looks like something per-attribute. "
-                                       "Publishing per-attribute too";
-          // All checks succeeded, let's attempt to unpack the JSON!
-          const tao::json::value::array_t& reports =
-              JsonAsArray(JsonGetProperty(
-                  json_payload, command_info->data.properties[0].name));
-          for (const auto& report : reports) {
-            const tao::json::value& attribute_id = JsonGetProperty(
-                report, repeated_object_type->properties[0].name);
-            const tao::json::value& attribute_value = JsonGetProperty(
-                report, repeated_object_type->properties[1].name);
-            std::string subtopic;
-            if (attribute_id.is_string()) {
-              subtopic = attribute_id.get_string();
-            } else if (attribute_id.is_unsigned()) {
-              subtopic = boost::str(boost::format("0x%04X") %
-                                    attribute_id.get_unsigned());
-            } else {
-              subtopic = tao::json::to_string(attribute_id);
-            }
-            futures.push_back(PublishValue(mqtt_wrapper, topic + "/" + subtopic,
-                                           mqtt_recursive_publish,
-                                           attribute_value));
-          }
-        }
-      }
+  if (topic.empty()) {
+    return decoded;
+  }
+
+  // Topics and payloads are put together in this thread's arena, only the
+  // finished messages are copied out of it.
+  MessageArena::Scope arena_scope;
+  ArenaString topic_buffer(topic.begin(), topic.end(),
+                           ArenaAllocator<char>(arena_scope.arena()));
+  // Sub-topics are appended to the topic, so reserve some room for them.
+  topic_buffer.reserve(topic.size() + 64);
+  FlattenValue(topic_buffer, mqtt_recursive_publish, decoded.json_payload,
+               policy, decoded.batch);
+
+  if (const dynamic_encoding::ObjectType* record_type =
+          AttributeRecordType(command_info)) {
+    LOG("OnZclCommand", info) << "Looks like something per-attribute. "
+                                 "Publishing per-attribute too";
+    for (const auto& record : JsonAsArray(JsonGetProperty(
+             decoded.json_payload, command_info.data.properties[0].name))) {
+      const std::string attribute_name = AttributeName(
+          JsonGetProperty(record, record_type->properties[0].name));
+      topic_buffer.resize(topic.size());
+      topic_buffer += '/';
+      topic_buffer.append(attribute_name.data(), attribute_name.size());
+      FlattenValue(topic_buffer, mqtt_recursive_publish,
+                   JsonGetProperty(record, record_type->properties[1].name),
+                   policy, decoded.batch);
     }
   }
+  return decoded;
+}
 
-  if (futures.size() == 1) {
-    futures[0].detach();
-  } else {
-    stlab::when_all(
-        stlab::immediate_executor, []() {},
-        std::make_pair(futures.begin(), futures.end()))
+void OnZclCommand(std::shared_ptr<MqttWrapper> mqtt_wrapper,
+                  std::shared_ptr<DeviceRegistry> device_registry,
+                  std::shared_ptr<LastValueCache> last_value_cache,
+                  std::shared_ptr<DeviceStateAggregator> device_state,
+                  std::shared_ptr<DeviceLanes> decode_lanes,
+                  std::shared_ptr<const PublishPolicies> policies,
+                  bool mqtt_recursive_publish,
+                  dynamic_encoding::ValueProfile value_profile,
+                  znp::IEEEAddress source_address,
+                  std::shared_ptr<const zcl::ZclMessage> message,
+                  std::shared_ptr<const clusterdb::ClusterInfo> cluster_info,
+                  std::shared_ptr<const clusterdb::CommandInfo> command_info) {
+  const uint8_t source_endpoint = message->source_endpoint();
+  const dynamic_encoding::ObjectType* record_type =
+      AttributeRecordType(*command_info);
+  // Attributes only go out as part of the device's state document.
+  const bool merge_into_state = record_type && device_state;
+  std::string topic;
+  if (!merge_into_state) {
+    topic = device_registry->CommandTopic(
+        source_address, source_endpoint, message->header().direction,
+        *cluster_info, *command_info);
+  }
+  const TopicClass topic_class = cluster_info->id == kIasZoneClusterId
+                                     ? TopicClass::Alarm
+                                     : TopicClass::Telemetry;
+  const PublishPolicy policy = policies->Get(topic_class);
+
+  auto decode = [mqtt_recursive_publish, value_profile, cluster_info,
+                 command_info, message, topic, policy]() {
+    return DecodeZclCommand(mqtt_recursive_publish, value_profile,
+                            *cluster_info, *command_info, *message, topic,
+                            policy);
+  };
+  auto deliver = [mqtt_wrapper, last_value_cache, device_state,
+                  merge_into_state, topic_class, source_address,
+                  source_endpoint, cluster_info, command_info,
+                  record_type](boost::optional<DecodedCommand> decoded) {
+    if (!decoded) {
+      return;
+    }
+    if (merge_into_state) {
+      for (const auto& record : JsonAsArray(
+               JsonGetProperty(decoded->json_payload,
+                               command_info->data.properties[0].name))) {
+        device_state->Merge(
+            source_address, source_endpoint, cluster_info->name,
+            AttributeName(
+                JsonGetProperty(record, record_type->properties[0].name)),
+            JsonGetProperty(record, record_type->properties[1].name));
+      }
+      return;
+    }
+    std::vector<MqttWrapper::Message>& batch = decoded->batch;
+    batch.erase(std::remove_if(batch.begin(), batch.end(),
+                               [&last_value_cache,
+                                topic_class](const auto& message) {
+                                 return !last_value_cache->ShouldPublish(
+                                     topic_class, message.topic_name,
+                                     message.message);
+                               }),
+                batch.end());
+    std::vector<std::string> topics =
+        TopicsToForget(*last_value_cache, topic_class, batch);
+    mqtt_wrapper->PublishBatch(std::move(batch))
+        .recover([last_value_cache, topics](auto f) {
+          try {
+            f.get_try();
+          } catch (const std::exception& ex) {
+            LOG("OnZclCommand", warning)
+                << "Unable to publish to MQTT: " << ex.what();
+            for (const auto& topic : topics) {
+              last_value_cache->Forget(topic);
+            }
+          }
+        })
         .detach();
+  };
+  if (decode_lanes) {
+    decode_lanes->Post(source_address, std::move(decode), std::move(deliver));
+  } else {
+    deliver(decode());
   }
 }
-
-void OnZclCommand(std::shared_ptr<clusterdb::ClusterDb> cluster_db,
+void OnZclCommand(std::shared_ptr<clusterdb::AtomicClusterDb> atomic_cluster_db,
                   std::shared_ptr<znp::ZnpApi> api,
                   std::shared_ptr<MqttWrapper> mqtt_wrapper,
-                  std::string mqtt_prefix, bool mqtt_recursive_publish,
-                  znp::ShortAddress source_address, uint8_t source_endpoint,
-                  zcl::ZclClusterId cluster_id, bool is_global_command,
-                  zcl::ZclDirection direction, zcl::ZclCommandId command_id,
-                  std::vector<uint8_t> payload) {
+                  std::shared_ptr<DeviceRegistry> device_registry,
+                  std::shared_ptr<LastValueCache> last_value_cache,
+                  std::shared_ptr<DeviceStateAggregator> device_state,
+                  std::shared_ptr<DeviceLanes> decode_lanes,
+                  std::shared_ptr<const PublishPolicies> policies,
+                  bool mqtt_recursive_publish,
+                  dynamic_encoding::ValueProfile value_profile,
+                  std::shared_ptr<const zcl::ZclMessage> message) {
+  const zcl::ZclClusterId cluster_id = message->cluster_id();
+  const zcl::ZclCommandId command_id = message->header().command_identifier;
+  // Pin the current snapshot, a reload while we're waiting for the address
+  // lookup below should not affect this message.
+  std::shared_ptr<const clusterdb::ClusterDb> cluster_db =
+      atomic_cluster_db->Load();
   auto cluster_info = cluster_db->ClusterById(cluster_id);
   if (!cluster_info) {
     LOG("OnZclCommand", warning)
@@ -601,8 +1010,9 @@ void OnZclCommand(std::shared_ptr<clusterdb::ClusterDb> cluster_db,
     return;
   }
   boost::optional<const clusterdb::CommandInfo&> command_info =
-      cluster_db->CommandById(cluster_id, command_id, is_global_command,
-                              direction);
+      cluster_db->CommandById(cluster_id, command_id,
+                              message->is_global_command(),
+                              message->header().direction);
   if (!command_info) {
     LOG("OnZclCommand", warning) << boost::str(
         boost::format("Unknown command ID 0x%02X in cluster '%s', ignoring") %
@@ -614,13 +1024,24 @@ void OnZclCommand(std::shared_ptr<clusterdb::ClusterDb> cluster_db,
   std::shared_ptr<const clusterdb::ClusterInfo> ptr_cluster_info(
       cluster_db, cluster_info.get_ptr());
 
+  const znp::ShortAddress source_address = message->source_address();
+  if (auto* device = device_registry->FindByShortAddress(source_address)) {
+    OnZclCommand(mqtt_wrapper, device_registry, last_value_cache,
+                 device_state, decode_lanes, policies, mqtt_recursive_publish,
+                 value_profile, device->address, std::move(message),
+                 ptr_cluster_info, ptr_command_info);
+    return;
+  }
   api->UtilAddrmgrNwkAddrLookup(source_address)
-      .then([mqtt_wrapper, mqtt_prefix, mqtt_recursive_publish, source_endpoint,
-             ptr_cluster_info, ptr_command_info,
-             payload](znp::IEEEAddress source_address) {
-        OnZclCommand(mqtt_wrapper, mqtt_prefix, mqtt_recursive_publish,
-                     source_address, source_endpoint, ptr_cluster_info,
-                     ptr_command_info, payload);
+      .then([mqtt_wrapper, device_registry, last_value_cache, device_state,
+             decode_lanes, policies, mqtt_recursive_publish, value_profile,
+             message, ptr_cluster_info,
+             ptr_command_info](znp::IEEEAddress address) {
+        device_registry->SetShortAddress(address, message->source_address());
+        OnZclCommand(mqtt_wrapper, device_registry, last_value_cache,
+                     device_state, decode_lanes, policies,
+                     mqtt_recursive_publish, value_profile, address, message,
+                     ptr_cluster_info, ptr_command_info);
       })
       .recover([](auto f) {
         try {
@@ -635,11 +1056,20 @@ void OnZclCommand(std::shared_ptr<clusterdb::ClusterDb> cluster_db,
 }
 
 std::shared_ptr<zcl::ZclEndpoint> Initialize(
-    coro::Await await, std::shared_ptr<znp::ZnpApi> api, uint16_t pan_id,
-    uint32_t chan_list, std::array<uint8_t, 16> presharedkey,
+    coro::Await await, AsioExecutor executor, std::shared_ptr<znp::ZnpApi> api,
+    uint16_t pan_id, uint32_t chan_list, std::array<uint8_t, 16> presharedkey,
     std::shared_ptr<MqttWrapper> mqtt_wrapper, std::string mqtt_prefix,
-    bool mqtt_recursive_publish,
-    std::shared_ptr<clusterdb::ClusterDb> cluster_db) {
+    bool mqtt_recursive_publish, dynamic_encoding::ValueProfile value_profile,
+    PayloadFormat command_format, std::string flight_recorder_file,
+    std::shared_ptr<clusterdb::AtomicClusterDb> cluster_db,
+    std::shared_ptr<DeviceRegistry> device_registry,
+    std::shared_ptr<LastValueCache> last_value_cache,
+    std::shared_ptr<DeviceStateAggregator> device_state,
+    std::shared_ptr<DeviceLanes> decode_lanes,
+    std::shared_ptr<const PublishPolicies> policies,
+    std::shared_ptr<LinkQualityAggregator> link_quality,
+    std::shared_ptr<boost::asio::deadline_timer> link_quality_timer,
+    boost::posix_time::time_duration link_quality_interval) {
   LOG("Initialize", debug) << "Doing initial reset (this may take up to a full "
                               "minute after a dongle power-cycle)";
   std::ignore = await(api->SysReset(true));
@@ -690,33 +1120,45 @@ std::shared_ptr<zcl::ZclEndpoint> Initialize(
   std::weak_ptr<znp::ZnpApi> weak_api(api);
 
   endpoint->on_command_.connect(
-      [cluster_db, weak_api, mqtt_wrapper, mqtt_prefix, mqtt_recursive_publish](
-          znp::ShortAddress source_address, uint8_t source_endpoint,
-          zcl::ZclClusterId cluster_id, bool is_global_command,
-          zcl::ZclDirection direction, zcl::ZclCommandId command_id,
-          std::vector<uint8_t> payload) {
+      [cluster_db, weak_api, mqtt_wrapper, device_registry, last_value_cache,
+       device_state, decode_lanes, policies, mqtt_recursive_publish,
+       value_profile](const std::shared_ptr<const zcl::ZclMessage>& message) {
         if (auto api = weak_api.lock()) {
-          OnZclCommand(cluster_db, api, mqtt_wrapper, mqtt_prefix,
-                       mqtt_recursive_publish, source_address, source_endpoint,
-                       cluster_id, is_global_command, direction, command_id,
-                       std::move(payload));
+          OnZclCommand(cluster_db, api, mqtt_wrapper, device_registry,
+                       last_value_cache, device_state, decode_lanes, policies,
+                       mqtt_recursive_publish, value_profile, message);
         }
       });
 
-  api->zdo_on_permit_join_.connect(std::bind(
-      &OnPermitJoin, mqtt_wrapper, mqtt_prefix, std::placeholders::_1));
-  api->af_on_incoming_msg_.connect(std::bind(
-      &OnIncomingMsg, api, mqtt_wrapper, mqtt_prefix, std::placeholders::_1));
-  api->zdo_on_trustcenter_device_.connect(
-      std::bind(&OnTcDevice, mqtt_wrapper, mqtt_prefix, std::placeholders::_1,
-                std::placeholders::_2, std::placeholders::_3));
+  api->zdo_on_permit_join_.connect(std::bind(&OnPermitJoin, mqtt_wrapper,
+                                             mqtt_prefix, policies,
+                                             std::placeholders::_1));
+  std::function<void(znp::ShortAddress)> flush_link_quality = std::bind(
+      &FlushLinkQuality, api, mqtt_wrapper, device_registry, last_value_cache,
+      policies, link_quality, std::placeholders::_1);
+  api->af_on_incoming_msg_.connect(std::bind(&OnIncomingMsg, link_quality,
+                                             flush_link_quality,
+                                             std::placeholders::_1));
+  FlushLinkQualityPeriodically(link_quality_timer, link_quality_interval,
+                               flush_link_quality, link_quality);
+  api->zdo_on_trustcenter_device_.connect(std::bind(
+      &OnTcDevice, mqtt_wrapper, mqtt_prefix, policies, device_registry,
+      std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
   api->zdo_on_end_device_announce_.connect(std::bind(
-      &OnEndDeviceAnnounce, mqtt_wrapper, mqtt_prefix, std::placeholders::_1,
-      std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+      &OnEndDeviceAnnounce, mqtt_wrapper, mqtt_prefix, policies,
+      device_registry, std::placeholders::_1, std::placeholders::_2,
+      std::placeholders::_3, std::placeholders::_4));
 
-  mqtt_wrapper->on_publish_.connect(std::bind(
-      &OnPublish, api, endpoint, mqtt_prefix, cluster_db, std::placeholders::_1,
-      std::placeholders::_2, std::placeholders::_3, std::placeholders::_4));
+  // Emitted on the MQTT io_service, which may run on a thread of its own.
+  auto router = MakeRouter(api, endpoint, cluster_db, command_format,
+                           flight_recorder_file);
+  mqtt_wrapper->on_publish_.connect(
+      [executor, router, mqtt_prefix](std::string topic, std::string message,
+                                      std::uint8_t qos, bool retain) {
+        executor([router, mqtt_prefix, topic, message, qos, retain]() {
+          OnPublish(router, mqtt_prefix, topic, message, qos, retain);
+        });
+      });
   await(mqtt_wrapper->Subscribe({
       {mqtt_prefix + "write/#", mqtt::qos::at_least_once},
       {mqtt_prefix + "+/+/out/#", mqtt::qos::at_least_once},
@@ -724,13 +1166,23 @@ std::shared_ptr<zcl::ZclEndpoint> Initialize(
   return endpoint;
 }
 
-void OnFrameDebug(std::string prefix, znp::ZnpCommandType cmdtype,
+void OnFrameDebug(const char* prefix, znp::ZnpCommandType cmdtype,
                   znp::ZnpCommand command,
                   const std::vector<uint8_t>& payload) {
   LOG("FRAME", debug) << prefix << " " << cmdtype << " " << command << " "
                       << boost::log::dump(payload.data(), payload.size());
 }
 
+void RecordFrame(FlightRecorder::Kind kind, znp::ZnpCommandType cmdtype,
+                 znp::ZnpCommand command,
+                 const std::vector<uint8_t>& payload) {
+  // The command bytes as they are on the wire.
+  const std::uint8_t cmd0 =
+      ((unsigned int)cmdtype << 4) | (unsigned int)command.Subsystem();
+  FlightRecorder::Global().Add(kind, (cmd0 << 8) | command.RawCommand(),
+                               payload.data(), payload.size());
+}
+
 std::string MakeNameSafeForMqtt(std::string name) {
   auto new_end = std::remove(name.begin(), name.end(), '/');
   return std::string(name.begin(), new_end);
@@ -738,14 +1190,7 @@ std::string MakeNameSafeForMqtt(std::string name) {
 
 int main(int argc, const char** argv) {
   // Set up logging to console (stderr)
-  auto console_log = boost::log::add_console_log(std::cerr);
-  boost::log::formatter formatter =
-      boost::log::expressions::stream
-      << "<" << boost::log::expressions::attr<severity_level>("Severity") << ">"
-      << " "
-      << "[" << boost::log::expressions::attr<std::string>("Channel") << "] "
-      << boost::log::expressions::message;
-  console_log->set_formatter(formatter);
+  ConsoleLog console_log;
 
   // Parse command line
   boost::program_options::options_description description(
@@ -763,6 +1208,35 @@ int main(int argc, const char** argv) {
     ("mqtt,m",
      boost::program_options::value<std::string>()->default_value("mqtt://127.0.0.1:1883/"),
      "MQTT Server, e.g. mqtt://127.0.0.1:1883/")
+    ("mqtt-queue-bytes",
+     boost::program_options::value<std::size_t>()->default_value(4 * 1024 * 1024),
+     "Maximum size in bytes of the messages kept while the MQTT server is unreachable")
+    ("mqtt-queue-policy",
+     boost::program_options::value<std::string>()->default_value("drop-oldest"),
+     "What to drop when the MQTT queue is full: drop-oldest, drop-qos0-first (keeps messages with a higher QoS, such as alarms, longest), or coalesce (keeps only the latest message per topic)")
+    ("mqtt-replay-rate",
+     boost::program_options::value<unsigned int>()->default_value(100),
+     "Maximum number of queued messages per second to send after reconnecting to the MQTT server, 0 for unlimited")
+    ("mqtt-max-inflight",
+     boost::program_options::value<std::size_t>()->default_value(16),
+     "Maximum number of QoS 1 and 2 messages to wait for confirmation of at once, further messages are queued")
+    ("mqtt-persistent-session",
+     "Ask the MQTT server to keep our session while disconnected, so subscriptions and unconfirmed QoS 1 and 2 messages in both directions survive a reconnect. Use a fixed ?clientid= in the --mqtt URL when running several hubs")
+    ("mqtt-reconnect-min",
+     boost::program_options::value<unsigned int>()->default_value(1000),
+     "Minimum delay in milliseconds between attempts to reconnect to the MQTT server. The first attempt is immediate, later ones back off exponentially")
+    ("mqtt-reconnect-max",
+     boost::program_options::value<unsigned int>()->default_value(60000),
+     "Maximum delay in milliseconds between attempts to reconnect to the MQTT server")
+    ("mqtt-spool",
+     boost::program_options::value<std::string>(),
+     "Directory to keep QoS 1 and 2 messages in while the MQTT server is unreachable, so they survive a restart")
+    ("mqtt-spool-bytes",
+     boost::program_options::value<std::size_t>()->default_value(64 * 1024 * 1024),
+     "Maximum size in bytes of the --mqtt-spool directory, further messages are queued in memory")
+    ("mqtt-spool-sync",
+     boost::program_options::value<unsigned int>()->default_value(1000),
+     "Milliseconds to collect spooled messages for before flushing them to disk together. QoS 2 messages are flushed right away")
     ("topic,t",
      boost::program_options::value<std::string>()->default_value("AqaraHub"),
      "MQTT Root topic, e.g. AqaraHub")
@@ -775,11 +1249,50 @@ int main(int argc, const char** argv) {
     ("pskhex",
      boost::program_options::value<std::string>(),
      "Zigbee Network pre-shared key in hexadecimal notation, maximum of 16 bytes (32 hex characters), will be padded with 0-bytes.")
+#if defined(BUILTIN_CLUSTER_INFO)
+    ("cluster-info",
+     boost::program_options::value<std::string>(),
+     "Boost property-tree info file containing cluster, attribute, and command information. Defaults to the clusters.info built into AqaraHub")
+#else
     ("cluster-info",
      boost::program_options::value<std::string>()->default_value("../clusters.info"),
      "Boost property-tree info file containing cluster, attribute, and command information")
+#endif
+    ("watch-cluster-info",
+     "Watch the --cluster-info file for changes, and reload it without restarting")
+    ("threaded",
+     "Run the serial port and MQTT I/O on threads of their own, so slow message processing can't delay reading frames from the dongle")
+    ("parallel-decode",
+     "Decode ZCL commands and encode their MQTT payloads on a pool of worker threads, one per core. Messages of one device stay in order")
     ("recursive-publish",
      "Recursively publish object properties and array elements to sub-topics")
+    ("value-profile",
+     boost::program_options::value<std::string>()->default_value("verbose"),
+     "How to publish bitmaps, data8-data64, and octet strings: verbose (arrays of booleans or bytes) or compact (bitmaps as integers, or objects of booleans when clusters.info names their bits, and the others as hexadecimal strings). Commands accept either")
+    ("publish-policy",
+     boost::program_options::value<std::string>(),
+     "Boost property-tree info file with the QoS, retain flag, expiry in seconds, and payload format (json, cbor, msgpack, or ubjson) to publish each topic class (telemetry, linkquality, report, state, alarm) with")
+    ("command-format",
+     boost::program_options::value<std::string>()->default_value("json"),
+     "Payload format of commands published to <IEEE>/<endpoint>/out/...: json, cbor, msgpack, or ubjson")
+    ("linkquality-interval",
+     boost::program_options::value<unsigned int>()->default_value(60),
+     "Interval in seconds to publish link quality statistics of each device at")
+    ("linkquality-band",
+     boost::program_options::value<double>()->default_value(10),
+     "Publish link quality right away when its average moved more than this away from the last published value")
+    ("device-state",
+     boost::program_options::value<unsigned int>()->implicit_value(50),
+     "Merge reported attributes into a retained per-device state document at <IEEE>/state instead of publishing them separately. Optionally takes the debounce interval in milliseconds (default 50)")
+    ("suppress-unchanged",
+     boost::program_options::value<std::vector<std::string>>()->composing(),
+     "Don't republish unchanged values to topics of the given class (telemetry, linkquality, or state). Pass CLASS=SECONDS to still republish unchanged values every SECONDS. May be given multiple times")
+    ("log-level",
+     boost::program_options::value<std::string>()->default_value("info"),
+     "Minimum severity to log at (trace, debug, info, warning, error, or critical), optionally followed by levels for specific channels, e.g. info,FRAME=debug. Can be changed at runtime by publishing the same to <topic>/write/loglevel")
+    ("flight-recorder-file",
+     boost::program_options::value<std::string>()->default_value("/tmp/aqarahub-flight-recorder.bin"),
+     "File to dump the last few thousand ZNP frames, MQTT operations, and decode errors to on SIGUSR1, or when anything is published to <topic>/write/flightrecorder. Read it with flight_recorder_dump")
     ("channelmask,c",
      boost::program_options::value<std::string>()->default_value("0x0800"),
      "Allowed channel mask. Bit 0 channel 1 to bit 31 channel 32, i.e. channel 11 - 0x0800, channel 26 = 0x04000000")
@@ -802,43 +1315,135 @@ int main(int argc, const char** argv) {
     return EXIT_SUCCESS;
   }
 
+  if (!SetLogLevels(variables["log-level"].as<std::string>())) {
+    LOG("Main", critical) << "Invalid --log-level '"
+                          << variables["log-level"].as<std::string>() << "'";
+    return EXIT_FAILURE;
+  }
+
   std::string serial_port = variables["port"].as<std::string>();
   LOG("Main", info) << "Serial port: " << serial_port;
 
   // Read cluster, command, & attribute names
-  auto cluster_db = std::make_shared<clusterdb::ClusterDb>();
-  if (!cluster_db->ParseFromFile(variables["cluster-info"].as<std::string>(),
-                                 MakeNameSafeForMqtt)) {
-    LOG("Main", critical) << "Unable to read '"
-                          << variables["cluster-info"].as<std::string>()
-                          << "' for cluster information";
-    return EXIT_FAILURE;
+  auto initial_cluster_db = std::make_shared<clusterdb::ClusterDb>();
+  if (variables.count("cluster-info")) {
+    if (!initial_cluster_db->ParseFromFile(
+            variables["cluster-info"].as<std::string>(), MakeNameSafeForMqtt)) {
+      LOG("Main", critical) << "Unable to read '"
+                            << variables["cluster-info"].as<std::string>()
+                            << "' for cluster information";
+      return EXIT_FAILURE;
+    }
+  } else {
+#if defined(BUILTIN_CLUSTER_INFO)
+    LOG("Main", info) << "Using built-in cluster information";
+    if (!initial_cluster_db->ParseFromImage(clusterdb::builtin_image,
+                                            clusterdb::builtin_image_size,
+                                            MakeNameSafeForMqtt)) {
+      LOG("Main", critical) << "Unable to load built-in cluster information";
+      return EXIT_FAILURE;
+    }
+#endif
   }
+  auto cluster_db =
+      std::make_shared<clusterdb::AtomicClusterDb>(initial_cluster_db);
 
   // Start working
   boost::asio::io_service io_service;
   boost::asio::io_service::work work(io_service);
+  bool threaded = (variables.count("threaded") > 0);
+  // MQTT I/O, and everything only safe to touch from it, runs here.
+  boost::asio::io_service mqtt_thread_io_service;
+  boost::asio::io_service& mqtt_io_service =
+      threaded ? mqtt_thread_io_service : io_service;
+  boost::asio::io_service::work mqtt_work(mqtt_thread_io_service);
+
+  std::shared_ptr<clusterdb::ClusterDbWatcher> cluster_db_watcher;
+  if (variables.count("watch-cluster-info")) {
+    if (variables.count("cluster-info") == 0) {
+      LOG("Main", critical) << "--watch-cluster-info requires --cluster-info";
+      return EXIT_FAILURE;
+    }
+    try {
+      cluster_db_watcher = clusterdb::ClusterDbWatcher::Create(
+          io_service, variables["cluster-info"].as<std::string>(),
+          MakeNameSafeForMqtt, cluster_db);
+    } catch (const std::exception& ex) {
+      LOG("Main", critical) << "Unable to watch cluster information: "
+                            << ex.what();
+      return EXIT_FAILURE;
+    }
+  }
 
   LOG("Main", info) << "Setting up ZNP connection";
-  auto port = std::make_shared<znp::ZnpPort>(io_service, serial_port);
+  std::shared_ptr<znp::ZnpRawInterface> port;
+  if (threaded) {
+    port = znp::ThreadedZnpPort::Create(io_service, serial_port);
+  } else {
+    port = std::make_shared<znp::ZnpPort>(io_service, serial_port);
+  }
   port->on_frame_.connect(std::bind(OnFrameDebug, "<<", std::placeholders::_1,
                                     std::placeholders::_2,
                                     std::placeholders::_3));
   port->on_sent_.connect(std::bind(OnFrameDebug, ">>", std::placeholders::_1,
                                    std::placeholders::_2,
                                    std::placeholders::_3));
+  port->on_frame_.connect(std::bind(
+      RecordFrame, FlightRecorder::Kind::FrameIn, std::placeholders::_1,
+      std::placeholders::_2, std::placeholders::_3));
+  port->on_sent_.connect(std::bind(
+      RecordFrame, FlightRecorder::Kind::FrameOut, std::placeholders::_1,
+      std::placeholders::_2, std::placeholders::_3));
   auto api = std::make_shared<znp::ZnpApi>(io_service, port);
 
   LOG("Main", info) << "Setting up MQTT connection";
 
+  MqttWrapper::Options mqtt_options;
+  mqtt_options.max_queue_bytes =
+      variables["mqtt-queue-bytes"].as<std::size_t>();
+  mqtt_options.replay_rate = variables["mqtt-replay-rate"].as<unsigned int>();
+  mqtt_options.max_inflight = variables["mqtt-max-inflight"].as<std::size_t>();
+  mqtt_options.clean_session = variables.count("mqtt-persistent-session") == 0;
+  mqtt_options.reconnect_min_delay = std::chrono::milliseconds(
+      variables["mqtt-reconnect-min"].as<unsigned int>());
+  mqtt_options.reconnect_max_delay = std::chrono::milliseconds(
+      variables["mqtt-reconnect-max"].as<unsigned int>());
+  if (variables.count("mqtt-spool")) {
+    mqtt_options.spool_directory = variables["mqtt-spool"].as<std::string>();
+  }
+  mqtt_options.spool_max_bytes =
+      variables["mqtt-spool-bytes"].as<std::size_t>();
+  mqtt_options.spool_sync_ms =
+      variables["mqtt-spool-sync"].as<unsigned int>();
+  std::string queue_policy = variables["mqtt-queue-policy"].as<std::string>();
+  if (queue_policy == "drop-oldest") {
+    mqtt_options.queue_policy = PublishQueue::Policy::DropOldest;
+  } else if (queue_policy == "drop-qos0-first") {
+    mqtt_options.queue_policy = PublishQueue::Policy::DropQos0First;
+  } else if (queue_policy == "coalesce") {
+    mqtt_options.queue_policy = PublishQueue::Policy::CoalesceTopic;
+  } else {
+    std::cerr << "Invalid --mqtt-queue-policy '" << queue_policy << "'"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
   std::shared_ptr<MqttWrapper> mqtt_wrapper;
   try {
-    mqtt_wrapper =
-        MqttWrapper::FromUrl(io_service, variables["mqtt"].as<std::string>());
+    mqtt_wrapper = MqttWrapper::FromUrl(
+        mqtt_io_service, variables["mqtt"].as<std::string>(), mqtt_options);
   } catch (const std::exception& ex) {
     std::cerr << ex.what() << std::endl;
     return EXIT_FAILURE;
   }
+  std::shared_ptr<NetworkMonitor> network_monitor;
+  try {
+    network_monitor = NetworkMonitor::Create(mqtt_io_service);
+    network_monitor->on_change_.connect(
+        std::bind(&MqttWrapper::NetworkChanged, mqtt_wrapper));
+  } catch (const std::exception& ex) {
+    LOG("Main", warning) << "Not watching for network changes: " << ex.what();
+  }
 
   std::string mqtt_prefix = variables["topic"].as<std::string>();
   if (mqtt_prefix.size() > 0 && mqtt_prefix[mqtt_prefix.size() - 1] != '/') {
@@ -846,8 +1451,106 @@ int main(int argc, const char** argv) {
   }
   LOG("Main", info) << "Using MQTT prefix '" << mqtt_prefix << "'";
   bool mqtt_recursive_publish = (variables.count("recursive-publish") > 0);
+  auto device_registry = std::make_shared<DeviceRegistry>(mqtt_prefix);
+  if (cluster_db_watcher) {
+    // Cached topics contain cluster & command names, which may have changed.
+    cluster_db_watcher->on_reload_.connect(
+        [device_registry]() { device_registry->ClearTopics(); });
+  }
   LOG("Main", info) << "Recursively publishing object and array properties";
 
+  auto value_profile = string_to_enum<dynamic_encoding::ValueProfile>(
+      variables["value-profile"].as<std::string>());
+  if (!value_profile) {
+    LOG("Main", critical) << "Unknown value profile '"
+                          << variables["value-profile"].as<std::string>()
+                          << "'";
+    return EXIT_FAILURE;
+  }
+
+  auto command_format = string_to_enum<PayloadFormat>(
+      variables["command-format"].as<std::string>());
+  if (!command_format) {
+    LOG("Main", critical) << "Unknown command format '"
+                          << variables["command-format"].as<std::string>()
+                          << "'";
+    return EXIT_FAILURE;
+  }
+
+  auto policies = std::make_shared<PublishPolicies>();
+  if (variables.count("publish-policy")) {
+    if (!policies->ParseFromFile(
+            variables["publish-policy"].as<std::string>())) {
+      LOG("Main", critical) << "Unable to read '"
+                            << variables["publish-policy"].as<std::string>()
+                            << "' for publish policies";
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::shared_ptr<DeviceStateAggregator> device_state;
+  if (variables.count("device-state")) {
+    unsigned int debounce_ms = variables["device-state"].as<unsigned int>();
+    LOG("Main", info) << "Publishing per-device state, debounced by "
+                      << debounce_ms << " ms";
+    device_state = std::make_shared<DeviceStateAggregator>(
+        io_service, boost::posix_time::milliseconds(debounce_ms));
+  }
+
+  std::shared_ptr<DeviceLanes> decode_lanes;
+  if (variables.count("parallel-decode")) {
+    LOG("Main", info) << "Decoding commands on worker threads";
+    decode_lanes =
+        std::make_shared<DeviceLanes>(io_service, stlab::default_executor);
+  }
+
+  auto link_quality = std::make_shared<LinkQualityAggregator>(
+      kLinkQualitySmoothing, variables["linkquality-band"].as<double>());
+
+  auto last_value_cache = std::make_shared<LastValueCache>();
+  if (variables.count("suppress-unchanged")) {
+    for (const auto& setting :
+         variables["suppress-unchanged"].as<std::vector<std::string>>()) {
+      std::size_t equals = setting.find('=');
+      auto topic_class = string_to_enum<TopicClass>(setting.substr(0, equals));
+      unsigned long seconds = 0;
+      try {
+        if (equals != std::string::npos) {
+          seconds = std::stoul(setting.substr(equals + 1));
+        }
+      } catch (const std::exception&) {
+        topic_class = boost::none;
+      }
+      // Reports and alarms always go out.
+      if (topic_class != TopicClass::Telemetry &&
+          topic_class != TopicClass::LinkQuality &&
+          topic_class != TopicClass::State) {
+        topic_class = boost::none;
+      }
+      if (!topic_class) {
+        LOG("Main", critical)
+            << "Invalid --suppress-unchanged setting '" << setting << "'";
+        return EXIT_FAILURE;
+      }
+      LOG("Main", info) << "Suppressing unchanged "
+                        << enum_to_string(*topic_class) << " values";
+      last_value_cache->Enable(*topic_class, std::chrono::seconds(seconds));
+    }
+    PublishLastValueCacheStats(
+        std::make_shared<boost::asio::deadline_timer>(io_service),
+        boost::posix_time::minutes(5), mqtt_wrapper, mqtt_prefix, policies,
+        last_value_cache);
+  }
+  PublishMqttStats(
+      std::make_shared<boost::asio::deadline_timer>(mqtt_io_service),
+      boost::posix_time::minutes(5), mqtt_wrapper, mqtt_prefix, policies);
+  if (device_state) {
+    device_state->on_state_.connect(
+        std::bind(&OnDeviceState, mqtt_wrapper, device_registry,
+                  last_value_cache, policies, std::placeholders::_1,
+                  std::placeholders::_2));
+  }
+
   // Creating pre-shared-key
   std::array<uint8_t, 16> presharedkey;
   presharedkey.fill(0);
@@ -899,12 +1602,18 @@ int main(int argc, const char** argv) {
   int exit_code = EXIT_SUCCESS;
   auto endpoint =
       coro::Run(
-          AsioExecutor(io_service), Initialize, api,
+          AsioExecutor(io_service), Initialize, AsioExecutor(io_service), api,
           variables["panid"].as<uint16_t>(),
           std::stoul(variables["channelmask"].as<std::string>(), nullptr, 0) &
               CHANNEL_ALL_MASK,
           presharedkey, mqtt_wrapper, mqtt_prefix, mqtt_recursive_publish,
-          cluster_db)
+          *value_profile, *command_format,
+          variables["flight-recorder-file"].as<std::string>(), cluster_db,
+          device_registry, last_value_cache, device_state, decode_lanes,
+          policies, link_quality,
+          std::make_shared<boost::asio::deadline_timer>(io_service),
+          boost::posix_time::seconds(
+              variables["linkquality-interval"].as<unsigned int>()))
           .then([](auto r) {
             LOG("Main", info) << "Initialization complete!";
             return r;
@@ -922,6 +1631,10 @@ int main(int argc, const char** argv) {
             }
           });
 
+  DumpFlightRecorderOnSignal(
+      std::make_shared<boost::asio::signal_set>(io_service, SIGUSR1),
+      variables["flight-recorder-file"].as<std::string>());
+
   port->on_error_.connect([&io_service,
                            &exit_code](const boost::system::error_code& error) {
     LOG("Main", critical) << "Exiting because of IO error: " << error.message();
@@ -929,8 +1642,18 @@ int main(int argc, const char** argv) {
     io_service.stop();
   });
 
+  std::thread mqtt_thread;
+  if (threaded) {
+    mqtt_thread = std::thread([&mqtt_thread_io_service]() {
+      mqtt_thread_io_service.run();
+    });
+  }
   std::cout << "IO Service starting" << std::endl;
   io_service.run();
   std::cout << "IO Service done" << std::endl;
+  if (mqtt_thread.joinable()) {
+    mqtt_thread_io_service.stop();
+    mqtt_thread.join();
+  }
   return exit_code;
 }
@@ -0,0 +1,43 @@
+#include "message_arena.h"
+
+void* MessageArena::Allocate(std::size_t size, std::size_t alignment) {
+  used_ += size;
+  if (size > kBlockSize / 4) {
+    // Would waste too much of a block, or not fit at all.
+    large_blocks_.emplace_back(new char[size]);
+    return large_blocks_.back().get();
+  }
+  while (true) {
+    if (current_ == blocks_.size()) {
+      blocks_.emplace_back(new char[kBlockSize]);
+      offset_ = 0;
+    }
+    std::size_t aligned = (offset_ + alignment - 1) / alignment * alignment;
+    if (aligned + size <= kBlockSize) {
+      offset_ = aligned + size;
+      return blocks_[current_].get() + aligned;
+    }
+    current_++;
+    offset_ = 0;
+  }
+}
+
+void MessageArena::Reset() {
+  large_blocks_.clear();
+  current_ = 0;
+  offset_ = 0;
+  used_ = 0;
+}
+
+MessageArena& MessageArena::ThisThread() {
+  static thread_local MessageArena arena;
+  return arena;
+}
+
+MessageArena::Scope::Scope() : arena_(ThisThread()) { arena_.scopes_++; }
+
+MessageArena::Scope::~Scope() {
+  if (--arena_.scopes_ == 0) {
+    arena_.Reset();
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef _MESSAGE_ARENA_H_
+#define _MESSAGE_ARENA_H_
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Monotonic allocator for the scratch memory of handling one message, like
+ * topics being built and payloads being assembled.
+ *
+ * Allocating just bumps a pointer, and memory is only released all at once
+ * when the message is done. The blocks are then reused for the next message,
+ * so in the steady state handling a message doesn't call malloc for its
+ * scratch memory at all.
+ */
+class MessageArena {
+ public:
+  static const std::size_t kBlockSize = 4096;
+
+  MessageArena() = default;
+  MessageArena(const MessageArena&) = delete;
+  MessageArena& operator=(const MessageArena&) = delete;
+
+  void* Allocate(std::size_t size, std::size_t alignment);
+  /** Makes all memory available again. Blocks of the normal size are kept,
+   * larger ones are freed. */
+  void Reset();
+
+  /** Bytes handed out since the last Reset(). */
+  std::size_t used() const { return used_; }
+  std::size_t blocks() const { return blocks_.size(); }
+
+  /** The calling thread's arena. */
+  static MessageArena& ThisThread();
+
+  /** Resets the calling thread's arena when the outermost Scope ends. Must be
+   * declared before anything allocated from the arena. */
+  class Scope {
+   public:
+    Scope();
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    MessageArena& arena() const { return arena_; }
+
+   private:
+    MessageArena& arena_;
+  };
+
+ private:
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  std::vector<std::unique_ptr<char[]>> large_blocks_;
+  // Index into blocks_ of the block being allocated from.
+  std::size_t current_ = 0;
+  std::size_t offset_ = 0;
+  std::size_t used_ = 0;
+  unsigned int scopes_ = 0;
+};
+
+/** Standard allocator handing out memory from a MessageArena. */
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(MessageArena& arena) : arena_(&arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, std::size_t) {}
+
+  MessageArena* arena() const { return arena_; }
+
+ private:
+  MessageArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>
+    ArenaString;
+#endif  // _MESSAGE_ARENA_H_
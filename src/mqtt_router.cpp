@@ -0,0 +1,199 @@
+#include "mqtt_router.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+constexpr std::size_t MqttRouter::kMaxCaptures;
+constexpr std::size_t MqttRouter::kNoNode;
+
+namespace {
+/** Splits off the first segment of topic, and advances topic past it and the
+ * following '/', if any. */
+boost::string_view NextSegment(boost::string_view& topic) {
+  std::size_t slash = topic.find('/');
+  if (slash == boost::string_view::npos) {
+    boost::string_view segment = topic;
+    topic = boost::string_view();
+    return segment;
+  }
+  boost::string_view segment = topic.substr(0, slash);
+  topic = topic.substr(slash + 1);
+  return segment;
+}
+
+bool ParseHex(boost::string_view segment, std::uint64_t& value) {
+  if (segment.empty() || segment.size() > 16) {
+    return false;
+  }
+  value = 0;
+  for (char c : segment) {
+    std::uint64_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    value = (value << 4) | digit;
+  }
+  return true;
+}
+
+bool ParseUint(boost::string_view segment, std::uint64_t& value) {
+  if (segment.empty()) {
+    return false;
+  }
+  value = 0;
+  for (char c : segment) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    std::uint64_t digit = c - '0';
+    if (value > (std::numeric_limits<std::uint64_t>::max() - digit) / 10) {
+      return false;
+    }
+    value = value * 10 + digit;
+  }
+  return true;
+}
+}  // namespace
+
+void MqttRouter::Add(boost::string_view pattern, Handler handler) {
+  if (!handler) {
+    throw std::invalid_argument("No handler given for MQTT route");
+  }
+  if (pattern.empty() || pattern.back() == '/') {
+    throw std::invalid_argument("Empty segment in MQTT route '" +
+                                pattern.to_string() + "'");
+  }
+  if (nodes_.empty()) {
+    nodes_.emplace_back();
+  }
+  std::size_t node = 0;
+  std::size_t capture_count = 0;
+  boost::string_view remaining = pattern;
+  do {
+    boost::string_view segment = NextSegment(remaining);
+    if (segment.empty()) {
+      throw std::invalid_argument("Empty segment in MQTT route '" +
+                                  pattern.to_string() + "'");
+    }
+    std::size_t next;
+    if (segment.front() == '{') {
+      CaptureType type;
+      if (segment == "{hex}") {
+        type = kHex;
+      } else if (segment == "{uint}") {
+        type = kUint;
+      } else if (segment == "{name}") {
+        type = kName;
+      } else {
+        throw std::invalid_argument("Unknown capture '" + segment.to_string() +
+                                    "' in MQTT route");
+      }
+      if (++capture_count > kMaxCaptures) {
+        throw std::invalid_argument("Too many captures in MQTT route '" +
+                                    pattern.to_string() + "'");
+      }
+      next = nodes_[node].captures[type];
+      if (next == kNoNode) {
+        next = nodes_.size();
+        nodes_[node].captures[type] = next;
+        nodes_.emplace_back();
+      }
+    } else {
+      next = FindLiteral(nodes_[node], segment);
+      if (next == kNoNode) {
+        next = nodes_.size();
+        auto& literals = nodes_[node].literals;
+        auto position = std::lower_bound(
+            literals.begin(), literals.end(), segment,
+            [](const std::pair<std::string, std::size_t>& entry,
+               boost::string_view segment) {
+              return boost::string_view(entry.first) < segment;
+            });
+        literals.emplace(position, segment.to_string(), next);
+        nodes_.emplace_back();
+      }
+    }
+    node = next;
+  } while (!remaining.empty());
+  if (nodes_[node].handler) {
+    throw std::invalid_argument("Duplicate MQTT route '" + pattern.to_string() +
+                                "'");
+  }
+  nodes_[node].handler = std::move(handler);
+}
+
+bool MqttRouter::Dispatch(boost::string_view topic,
+                          const std::string& message) const {
+  // NextSegment() can't tell "a/b/" from "a/b", so reject the trailing empty
+  // segment up front. Empty segments elsewhere never match.
+  if (nodes_.empty() || topic.empty() || topic.back() == '/') {
+    return false;
+  }
+  MqttRouter::Match match;
+  const Handler* handler = nullptr;
+  if (!Find(0, topic, match, handler)) {
+    return false;
+  }
+  (*handler)(match, message);
+  return true;
+}
+
+std::size_t MqttRouter::FindLiteral(const Node& node,
+                                    boost::string_view segment) const {
+  auto found = std::lower_bound(
+      node.literals.begin(), node.literals.end(), segment,
+      [](const std::pair<std::string, std::size_t>& entry,
+         boost::string_view segment) {
+        return boost::string_view(entry.first) < segment;
+      });
+  if (found == node.literals.end() || found->first != segment) {
+    return kNoNode;
+  }
+  return found->second;
+}
+
+bool MqttRouter::Find(std::size_t node, boost::string_view remaining,
+                      MqttRouter::Match& match, const Handler*& handler) const {
+  if (remaining.empty()) {
+    handler = &nodes_[node].handler;
+    return (bool)nodes_[node].handler;
+  }
+  const Node& current = nodes_[node];
+  boost::string_view segment = NextSegment(remaining);
+  if (segment.empty()) {
+    return false;
+  }
+  std::size_t next = FindLiteral(current, segment);
+  if (next != kNoNode && Find(next, remaining, match, handler)) {
+    return true;
+  }
+
+  const std::size_t size = match.size_;
+  for (int type = kHex; type < kCaptureTypeCount; type++) {
+    next = current.captures[type];
+    if (next == kNoNode) {
+      continue;
+    }
+    MqttRouter::Match::Capture& capture = match.captures_[size];
+    capture.text = segment;
+    capture.number = 0;
+    if (type == kHex && !ParseHex(segment, capture.number)) {
+      continue;
+    }
+    if (type == kUint && !ParseUint(segment, capture.number)) {
+      continue;
+    }
+    match.size_ = size + 1;
+    if (Find(next, remaining, match, handler)) {
+      return true;
+    }
+    match.size_ = size;
+  }
+  return false;
+}
@@ -0,0 +1,81 @@
+#ifndef _MQTT_ROUTER_H_
+#define _MQTT_ROUTER_H_
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <boost/utility/string_view.hpp>
+#include <vector>
+
+/**
+ * Dispatches MQTT topics to handlers registered by pattern.
+ *
+ * Patterns are '/' separated, where each segment is either a literal, or one
+ * of the following typed captures:
+ *  - "{hex}": hexadecimal number of up to 16 digits, e.g. an IEEE address.
+ *  - "{uint}": decimal number, e.g. an endpoint.
+ *  - "{name}": any non-empty segment, e.g. a cluster name.
+ *
+ * All patterns are kept in a single trie, so dispatching only depends on the
+ * number of segments in the topic, not on the number of routes. Topics are
+ * split in place, and name captures refer into the dispatched topic, so
+ * dispatching does not allocate.
+ */
+class MqttRouter {
+ public:
+  static constexpr std::size_t kMaxCaptures = 4;
+
+  class Match {
+   public:
+    std::size_t size() const { return size_; }
+    /** Value of a "{hex}" or "{uint}" capture. */
+    std::uint64_t Number(std::size_t index) const {
+      return captures_[index].number;
+    }
+    /** Text of any capture, only valid during the handler call. */
+    boost::string_view Text(std::size_t index) const {
+      return captures_[index].text;
+    }
+
+   private:
+    friend class MqttRouter;
+    struct Capture {
+      std::uint64_t number;
+      boost::string_view text;
+    };
+    std::array<Capture, kMaxCaptures> captures_;
+    std::size_t size_ = 0;
+  };
+
+  typedef std::function<void(const Match& match, const std::string& message)>
+      Handler;
+
+  /** Registers handler for pattern. Throws std::invalid_argument if the
+   * pattern is malformed or already registered. */
+  void Add(boost::string_view pattern, Handler handler);
+
+  /** Calls the handler registered for topic, returns false if there was none.
+   * Literal segments take precedence over captures, and "{hex}" and "{uint}"
+   * over "{name}". */
+  bool Dispatch(boost::string_view topic, const std::string& message) const;
+
+ private:
+  enum CaptureType { kHex = 0, kUint = 1, kName = 2, kCaptureTypeCount = 3 };
+  static constexpr std::size_t kNoNode = (std::size_t)-1;
+
+  struct Node {
+    // (segment, index into nodes_), sorted by segment.
+    std::vector<std::pair<std::string, std::size_t>> literals;
+    std::array<std::size_t, kCaptureTypeCount> captures{
+        {kNoNode, kNoNode, kNoNode}};
+    Handler handler;
+  };
+
+  // nodes_[0] is the root, created on first Add().
+  std::vector<Node> nodes_;
+
+  std::size_t FindLiteral(const Node& node, boost::string_view segment) const;
+  bool Find(std::size_t node, boost::string_view remaining, Match& match,
+            const Handler*& handler) const;
+};
+#endif  // _MQTT_ROUTER_H_
@@ -91,6 +91,12 @@ boost::optional<MqttWrapper::Parameters> MqttWrapper::ParseUrl(
 std::shared_ptr<MqttWrapper> MqttWrapper::FromParameters(
     boost::asio::io_service& io_service,
     const MqttWrapper::Parameters& params) {
+  return FromParameters(io_service, params, Options());
+}
+
+std::shared_ptr<MqttWrapper> MqttWrapper::FromParameters(
+    boost::asio::io_service& io_service, const MqttWrapper::Parameters& params,
+    const MqttWrapper::Options& options) {
   if (params.use_ws) {
 #if defined(MQTT_USE_WS)
     if (params.use_tls) {
@@ -105,7 +111,8 @@ std::shared_ptr<MqttWrapper> MqttWrapper::FromParameters(
             if (password) client->set_password(*password);
             return client;
           },
-          io_service, params.hostname, (params.port ? *params.port : "1883"),
+          io_service, options, params.hostname,
+          (params.port ? *params.port : "1883"),
           (params.client_id ? *params.client_id : "AqaraHub"), params.username,
           params.password);
     } else {
@@ -120,7 +127,8 @@ std::shared_ptr<MqttWrapper> MqttWrapper::FromParameters(
             if (password) client->set_password(*password);
             return client;
           },
-          io_service, params.hostname, (params.port ? *params.port : "1883"),
+          io_service, options, params.hostname,
+          (params.port ? *params.port : "1883"),
           (params.client_id ? *params.client_id : "AqaraHub"), params.username,
           params.password);
     }
@@ -141,7 +149,8 @@ std::shared_ptr<MqttWrapper> MqttWrapper::FromParameters(
             if (password) client->set_password(*password);
             return client;
           },
-          io_service, params.hostname, (params.port ? *params.port : "1883"),
+          io_service, options, params.hostname,
+          (params.port ? *params.port : "1883"),
           (params.client_id ? *params.client_id : "AqaraHub"), params.username,
           params.password);
     } else {
@@ -156,7 +165,8 @@ std::shared_ptr<MqttWrapper> MqttWrapper::FromParameters(
             if (password) client->set_password(*password);
             return client;
           },
-          io_service, params.hostname, (params.port ? *params.port : "1883"),
+          io_service, options, params.hostname,
+          (params.port ? *params.port : "1883"),
           (params.client_id ? *params.client_id : "AqaraHub"), params.username,
           params.password);
     }
@@ -165,9 +175,15 @@ std::shared_ptr<MqttWrapper> MqttWrapper::FromParameters(
 
 std::shared_ptr<MqttWrapper> MqttWrapper::FromUrl(
     boost::asio::io_service& io_service, std::string url) {
+  return FromUrl(io_service, std::move(url), Options());
+}
+
+std::shared_ptr<MqttWrapper> MqttWrapper::FromUrl(
+    boost::asio::io_service& io_service, std::string url,
+    const MqttWrapper::Options& options) {
   auto params = ParseUrl(url);
   if (!params) {
     throw std::runtime_error("MQTT URI Parse error");
   }
-  return FromParameters(io_service, *params);
+  return FromParameters(io_service, *params, options);
 }
@@ -2,23 +2,88 @@
 #define _MQTT_WRAPPER_H_
 #include <boost/asio.hpp>
 #include <boost/signals2.hpp>
+#include <chrono>
 #include <mqtt/qos.hpp>
 #include <set>
 #include <stlab/concurrency/future.hpp>
 #include <string>
+#include <vector>
+#include "inflight_window.h"
+#include "publish_queue.h"
 
 class MqttWrapper {
  public:
   virtual ~MqttWrapper() = default;
+  /** An expiry other than zero drops the message if it couldn't be sent
+   * within that time, e.g. because the connection was down. */
   virtual stlab::future<void> Publish(
       std::string topic_name, std::string message,
-      std::uint8_t qos = mqtt::qos::at_most_once, bool retain = false) = 0;
+      std::uint8_t qos = mqtt::qos::at_most_once, bool retain = false,
+      std::chrono::seconds expiry = std::chrono::seconds::zero()) = 0;
+  struct Message {
+    std::string topic_name;
+    std::string message;
+    std::uint8_t qos;
+    bool retain;
+    std::chrono::seconds expiry{0};
+    // See PublishPolicy::durable.
+    bool durable = false;
+  };
+  /** Publishes all messages, in order. The returned future completes once all
+   * of them have been published, or with the first error. */
+  virtual stlab::future<void> PublishBatch(std::vector<Message> messages) = 0;
   virtual stlab::future<void> Subscribe(
       std::set<std::tuple<std::string, std::uint8_t>> topics) = 0;
   boost::signals2::signal<void(std::string topic, std::string message,
                                std::uint8_t qos, bool retain)>
       on_publish_;
 
+  /** Tries to reconnect right away if disconnected, e.g. because the network
+   * came back. */
+  virtual void NetworkChanged() = 0;
+
+  struct ConnectionStats {
+    std::uint64_t reconnects = 0;
+    // Time from losing the connection until the server accepted a new one.
+    std::chrono::steady_clock::duration last_outage{};
+    std::chrono::steady_clock::duration max_outage{};
+    // Time from reconnecting until all queued messages were sent.
+    std::chrono::steady_clock::duration last_drain{};
+  };
+  struct Stats {
+    PublishQueue::Stats queue;
+    InflightWindow::Stats inflight;
+    ConnectionStats connection;
+  };
+  /** Only to be called from the io_service thread. */
+  virtual Stats stats() const = 0;
+
+  struct Options {
+    // Maximum size of the messages queued while disconnected.
+    std::size_t max_queue_bytes = 4 * 1024 * 1024;
+    PublishQueue::Policy queue_policy = PublishQueue::Policy::DropOldest;
+    // Maximum number of queued messages sent per second after reconnecting,
+    // or 0 to send them all at once.
+    unsigned int replay_rate = 100;
+    // Maximum number of QoS 1 and 2 messages waiting for their PUBACK or
+    // PUBCOMP. Further messages are queued until earlier ones are confirmed.
+    std::size_t max_inflight = 16;
+    // Delays between reconnection attempts, see ReconnectBackoff.
+    std::chrono::milliseconds reconnect_min_delay{1000};
+    std::chrono::milliseconds reconnect_max_delay{60000};
+    // When false, the server keeps the session (subscriptions, messages
+    // waiting for confirmation, and QoS 1 and 2 messages to us) while
+    // disconnected. Needs a client id that is the same on every connect.
+    bool clean_session = true;
+    // When set, messages with QoS 1 or 2 are queued in a PublishSpool in this
+    // directory instead, so they survive a restart.
+    std::string spool_directory;
+    std::size_t spool_max_bytes = 64 * 1024 * 1024;
+    // Appended messages are flushed to disk this long after the first one.
+    // QoS 2 and durable messages are flushed right away.
+    unsigned int spool_sync_ms = 1000;
+  };
+
   struct Parameters {
     bool use_tls;
     bool use_ws;
@@ -33,8 +98,14 @@ class MqttWrapper {
   static boost::optional<Parameters> ParseUrl(const std::string& url);
   static std::shared_ptr<MqttWrapper> FromUrl(
       boost::asio::io_service& io_service, std::string url);
+  static std::shared_ptr<MqttWrapper> FromUrl(
+      boost::asio::io_service& io_service, std::string url,
+      const Options& options);
   static std::shared_ptr<MqttWrapper> FromParameters(
       boost::asio::io_service& io_service, const Parameters& params);
+  static std::shared_ptr<MqttWrapper> FromParameters(
+      boost::asio::io_service& io_service, const Parameters& params,
+      const Options& options);
 };
 
 std::ostream& operator<<(std::ostream& s,
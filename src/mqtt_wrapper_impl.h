@@ -1,13 +1,19 @@
 #ifndef _MQTT_WRAPPER_IMPL_H_
 #define _MQTT_WRAPPER_IMPL_H_
+#include <algorithm>
+#include <limits>
+#include <memory>
 #include <mqtt_client_cpp.hpp>
-#include <queue>
 #include <set>
+#include <unordered_map>
 #include <stlab/concurrency/serial_queue.hpp>
 #include <stlab/concurrency/utility.hpp>
 #include "asio_executor.h"
+#include "flight_recorder.h"
 #include "logging.h"
 #include "mqtt_wrapper.h"
+#include "publish_spool.h"
+#include "reconnect_backoff.h"
 #include "weak_bind.h"
 
 template <typename C>
@@ -16,13 +22,25 @@ class MqttWrapperImpl
       public std::enable_shared_from_this<MqttWrapperImpl<C>> {
  public:
   MqttWrapperImpl(boost::asio::io_service& io_service,
+                  const MqttWrapper::Options& options,
                   std::shared_ptr<C> client)
       : mutex_queue_(AsioExecutor(io_service)),
         mutex_queue_executor_(mutex_queue_.executor()),
         io_service_(io_service),
         client_(client),
-        reconnect_timer_(io_service) {
-    client_->set_clean_session(true);
+        options_(options),
+        publish_queue_(options.max_queue_bytes, options.queue_policy),
+        inflight_(options.max_inflight),
+        reconnect_timer_(io_service),
+        backoff_(options.reconnect_min_delay, options.reconnect_max_delay),
+        replay_timer_(io_service),
+        spool_sync_timer_(io_service) {
+    client_->set_clean_session(options.clean_session);
+    if (!options.spool_directory.empty()) {
+      spool_.reset(new PublishSpool(options.spool_directory,
+                                    kSpoolSegmentBytes,
+                                    options.spool_max_bytes));
+    }
   }
   void PostConstructor() {
     std::shared_ptr<MqttWrapperImpl<C>> self_ptr(this->shared_from_this());
@@ -51,7 +69,29 @@ class MqttWrapperImpl
                                       self_ptr, std::placeholders::_1));
   }
   stlab::future<void> Publish(std::string topic_name, std::string message,
-                              std::uint8_t qos, bool retain) override {
+                              std::uint8_t qos, bool retain,
+                              std::chrono::seconds expiry) override {
+    auto _this = this->shared_from_this();
+    auto package = stlab::package<void(std::exception_ptr)>(
+        AsioExecutor(io_service_), [](std::exception_ptr ex) {
+          if (ex) {
+            std::rethrow_exception(ex);
+          }
+        });
+    PublishQueueItem item{topic_name, message, qos, retain, package.first,
+                          ExpiresAt(expiry)};
+    mutex_queue_(
+        [_this](PublishQueueItem item) {
+          _this->SafePublish(std::move(item));
+        },
+        std::move(item))
+        .detach();
+    return package.second;
+  }
+  stlab::future<void> PublishBatch(std::vector<Message> messages) override {
+    if (messages.empty()) {
+      return stlab::make_ready_future(AsioExecutor(io_service_));
+    }
     auto _this = this->shared_from_this();
     auto package = stlab::package<void(std::exception_ptr)>(
         AsioExecutor(io_service_), [](std::exception_ptr ex) {
@@ -59,12 +99,35 @@ class MqttWrapperImpl
             std::rethrow_exception(ex);
           }
         });
-    PublishQueueItem item{topic_name, message, qos, retain, package.first};
-    return mutex_queue_(
-        [_this](PublishQueueItem item) { _this->SafePublish(item); },
-        std::move(item));
+    // One completion counter for the whole batch, instead of one future per
+    // message.
+    auto completion = std::make_shared<BatchCompletion>();
+    completion->remaining = messages.size();
+    completion->callback = package.first;
+    mutex_queue_(
+        [_this, completion](std::vector<Message> messages) {
+          for (auto& message : messages) {
+            _this->SafePublish(PublishQueueItem{
+                std::move(message.topic_name), std::move(message.message),
+                message.qos, message.retain,
+                [completion](std::exception_ptr ex) {
+                  completion->Done(ex);
+                },
+                ExpiresAt(message.expiry), message.durable});
+          }
+        },
+        std::move(messages))
+        .detach();
     return package.second;
   }
+  Stats stats() const override {
+    return Stats{publish_queue_.stats(), inflight_.stats(),
+                 connection_stats_};
+  }
+  void NetworkChanged() override {
+    auto _this = this->shared_from_this();
+    mutex_queue_([_this]() { _this->SafeNetworkChanged(); }).detach();
+  }
   stlab::future<void> Subscribe(
       std::set<std::tuple<std::string, std::uint8_t>> topics) override {
     if (topics.empty()) {
@@ -80,32 +143,233 @@ class MqttWrapperImpl
   stlab::executor_t mutex_queue_executor_;
   boost::asio::io_service& io_service_;
   std::shared_ptr<C> client_;
+  const MqttWrapper::Options options_;
   enum class ConnectionState { Disconnected, Connecting, Connected };
-  ConnectionState state_;
-  struct PublishQueueItem {
-    std::string topic_name;
-    std::string message;
-    std::uint8_t qos;
-    bool retain;
+  ConnectionState state_ = ConnectionState::Connecting;
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point disconnected_at_;
+  Clock::time_point connected_at_;
+  bool draining_ = false;
+  MqttWrapper::ConnectionStats connection_stats_;
+  typedef PublishQueue::Item PublishQueueItem;
+  struct BatchCompletion {
+    std::size_t remaining;
     std::function<void(std::exception_ptr)> callback;
+    void Done(std::exception_ptr ex) {
+      if (!callback) {
+        // Already failed
+        return;
+      }
+      if (ex || --remaining == 0) {
+        auto done_callback = std::move(callback);
+        callback = nullptr;
+        done_callback(ex);
+      }
+    }
   };
-  std::queue<PublishQueueItem> publish_queue_;
-  std::map<std::uint16_t, PublishQueueItem> publish_inprogress_;
+  PublishQueue publish_queue_;
+  InflightWindow inflight_;
   std::set<std::tuple<std::string, std::uint8_t>> subscriptions_;
+  // Whether all of subscriptions_ were sent since this process started, so a
+  // resumed session has them. A session from an earlier run might have others.
+  bool subscriptions_sent_ = false;
   boost::asio::deadline_timer reconnect_timer_;
+  ReconnectBackoff backoff_;
+  boost::asio::deadline_timer replay_timer_;
+  bool replay_pending_ = false;
+  // Messages are sent in slices of this period while replaying the queue.
+  static constexpr long kReplayPeriodMs = 100;
+  static constexpr std::size_t kSpoolSegmentBytes = 1024 * 1024;
+  std::unique_ptr<PublishSpool> spool_;
+  // Callbacks of the messages spooled by this process, by sequence number.
+  std::unordered_map<std::uint64_t, std::function<void(std::exception_ptr)>>
+      spool_callbacks_;
+  boost::asio::deadline_timer spool_sync_timer_;
+  bool spool_sync_pending_ = false;
+
+  static PublishQueue::Clock::time_point ExpiresAt(
+      std::chrono::seconds expiry) {
+    if (expiry == std::chrono::seconds::zero()) {
+      return PublishQueue::Clock::time_point();
+    }
+    return PublishQueue::Clock::now() + expiry;
+  }
+
+  bool HasBacklog() const {
+    return !publish_queue_.empty() || (spool_ && spool_->HasNext());
+  }
 
   void SafePublish(PublishQueueItem item) {
-    if (state_ != ConnectionState::Connected) {
-      publish_queue_.push(std::move(item));
+    if (item.durable && item.qos != mqtt::qos::at_most_once &&
+        SpoolPublish(item)) {
+      // Sent from the spool like the rest of it, which only acknowledges the
+      // record once the server confirmed it.
+      ResumeBacklog();
+      return;
+    }
+    // Queue behind any messages still waiting to be replayed, to keep order.
+    if (state_ != ConnectionState::Connected || HasBacklog() ||
+        (item.qos != mqtt::qos::at_most_once && inflight_.full())) {
+      Enqueue(std::move(item));
+      return;
+    }
+    SendPublish(std::move(item));
+  }
+
+  void Enqueue(PublishQueueItem item) {
+    if (item.qos != mqtt::qos::at_most_once && SpoolPublish(item)) {
+      return;
+    }
+    publish_queue_.Push(std::move(item));
+  }
+
+  /** Continues sending queued messages once the in-flight window has room,
+   * unless that is already scheduled. */
+  void ResumeBacklog() {
+    if (state_ == ConnectionState::Connected && !replay_pending_ &&
+        HasBacklog()) {
+      ReplayQueue();
+    }
+  }
+
+  /** Queues the messages that were waiting for confirmation when the
+   * connection dropped. */
+  void RequeueInflight() {
+    std::vector<PublishQueueItem> requeued;
+    for (auto& entry : inflight_.TakeAll()) {
+      // Spooled messages are still in the spool, and get sent again anyway.
+      if (!entry.spooled) {
+        requeued.push_back(std::move(entry.item));
+      }
+    }
+    if (!requeued.empty()) {
+      LOG("MqttWrapper", info)
+          << "Queued " << requeued.size() << " unconfirmed messages again";
+      // Ahead of the messages queued while they were in flight, which are
+      // newer.
+      publish_queue_.PushFront(std::move(requeued));
+    }
+  }
+
+  /** Appends item to the spool, returns false if it has to be queued in
+   * memory instead. */
+  bool SpoolPublish(PublishQueueItem& item) {
+    if (!spool_) {
+      return false;
+    }
+    boost::optional<std::uint64_t> sequence;
+    try {
+      sequence = spool_->Append(item.topic_name, item.message, item.qos,
+                                item.retain, item.expires_at);
+      if (item.qos == mqtt::qos::exactly_once || item.durable) {
+        spool_->Sync();
+      }
+    } catch (const std::exception& ex) {
+      LOG("MqttWrapper", error) << "Unable to spool message: " << ex.what();
+      return false;
+    }
+    if (!sequence) {
+      LOG("MqttWrapper", warning) << "Spool full, queueing message in memory";
+      return false;
+    }
+    if (item.callback) {
+      spool_callbacks_[*sequence] = std::move(item.callback);
+    }
+    ScheduleSpoolSync();
+    return true;
+  }
+
+  /** Sends the next spooled message, returns false when there is none. */
+  bool SendSpooled() {
+    boost::optional<PublishSpool::Record> record;
+    PublishQueue::Clock::time_point now = PublishQueue::Clock::now();
+    try {
+      // Expired records are acknowledged without sending them.
+      while ((record = spool_->Next()) &&
+             record->expires_at != PublishSpool::Clock::time_point() &&
+             record->expires_at <= now) {
+        OnSpooledPublished(record->sequence,
+                           std::make_exception_ptr(std::runtime_error(
+                               "Expired before it could be published")),
+                           true);
+      }
+    } catch (const std::exception& ex) {
+      LOG("MqttWrapper", error) << "Unable to read spool: " << ex.what();
+    }
+    if (!record) {
+      return false;
+    }
+    std::uint64_t sequence = record->sequence;
+    std::weak_ptr<MqttWrapperImpl<C>> weak_this(this->shared_from_this());
+    SendPublish(PublishQueueItem{std::move(record->topic_name),
+                                 std::move(record->message), record->qos,
+                                 record->retain,
+                                 [weak_this, sequence](std::exception_ptr ex) {
+                                   if (auto _this = weak_this.lock()) {
+                                     _this->OnSpooledPublished(sequence, ex);
+                                   }
+                                 },
+                                 record->expires_at},
+                true);
+    return true;
+  }
+
+  /** Called when a spooled message was published, or with an exception when
+   * it expired or couldn't be sent. */
+  void OnSpooledPublished(std::uint64_t sequence, std::exception_ptr ex,
+                          bool expired = false) {
+    if (ex && !expired) {
+      // Stays in the spool, and is sent again after reconnecting.
+      return;
+    }
+    spool_->Acknowledge(sequence);
+    ScheduleSpoolSync();
+    auto found = spool_callbacks_.find(sequence);
+    if (found != spool_callbacks_.end()) {
+      auto callback = std::move(found->second);
+      spool_callbacks_.erase(found);
+      callback(ex);
+    }
+  }
+
+  void ScheduleSpoolSync() {
+    if (spool_sync_pending_ || !spool_->dirty()) {
       return;
     }
+    spool_sync_pending_ = true;
+    spool_sync_timer_.expires_from_now(
+        boost::posix_time::milliseconds(options_.spool_sync_ms));
+    std::shared_ptr<MqttWrapperImpl<C>> self_ptr(this->shared_from_this());
+    std::shared_ptr<stlab::executor_t> executor_ptr(self_ptr,
+                                                    &mutex_queue_executor_);
+    spool_sync_timer_.async_wait(
+        WeakExecutorBind(executor_ptr, &MqttWrapperImpl<C>::OnSpoolSyncTimer,
+                         self_ptr, std::placeholders::_1));
+  }
+
+  void OnSpoolSyncTimer(const boost::system::error_code& ec) {
+    spool_sync_pending_ = false;
+    if (ec) {
+      return;
+    }
+    try {
+      spool_->Sync();
+    } catch (const std::exception& ex) {
+      LOG("MqttWrapper", error) << "Unable to sync spool: " << ex.what();
+    }
+  }
+
+  void SendPublish(PublishQueueItem item, bool spooled = false) {
+    FlightRecorder::Global().Add(FlightRecorder::Kind::MqttOut, item.qos,
+                                 item.topic_name, item.message);
     if (item.qos == mqtt::qos::at_most_once) {
       auto callback = item.callback;
       client_->acquired_async_publish(
           0, item.topic_name, item.message, item.qos, item.retain,
           [callback](const boost::system::error_code& error) {
             if (error) {
-              callback(std::make_exception_ptr(error));
+              callback(std::make_exception_ptr(
+                  boost::system::system_error(error)));
             } else {
               callback(nullptr);
             }
@@ -114,7 +378,7 @@ class MqttWrapperImpl
     }
     auto packet_id = client_->acquire_unique_packet_id();
     auto _this = this->shared_from_this();
-    publish_inprogress_[packet_id] = item;
+    inflight_.Add(packet_id, InflightWindow::Entry{item, spooled});
     client_->acquired_async_publish(
         packet_id, item.topic_name, item.message, item.qos, item.retain,
         [packet_id, _this](const boost::system::error_code& error) {
@@ -136,6 +400,8 @@ class MqttWrapperImpl
       client_->async_subscribe(
           std::vector<std::tuple<std::string, std::uint8_t>>(
               subscriptions.begin(), subscriptions.end()));
+    } else {
+      subscriptions_sent_ = false;
     }
   }
 
@@ -146,41 +412,173 @@ class MqttWrapperImpl
           << mqtt::connect_return_code_to_str(connack_return_code);
       return;
     }
-    LOG("MqttWrapper", debug) << "Connected, clean=" << sp;
+    LOG("MqttWrapper", debug) << "Connected, session present=" << sp;
+    FlightRecorder::Global().Add(FlightRecorder::Kind::MqttConnected, sp,
+                                 nullptr, 0);
     state_ = ConnectionState::Connected;
-    if (!subscriptions_.empty()) {
+    backoff_.Reset();
+    connected_at_ = Clock::now();
+    if (disconnected_at_ != Clock::time_point()) {
+      Clock::duration outage = connected_at_ - disconnected_at_;
+      connection_stats_.reconnects++;
+      connection_stats_.last_outage = outage;
+      connection_stats_.max_outage =
+          std::max(connection_stats_.max_outage, outage);
+      LOG("MqttWrapper", info)
+          << "Reconnected after "
+          << std::chrono::duration_cast<std::chrono::milliseconds>(outage)
+                 .count()
+          << " ms";
+    }
+    if (sp) {
+      // mqtt_cpp resends the messages that weren't confirmed, so everything
+      // in flight stays.
+      LOG("MqttWrapper", info) << "Resumed the previous session";
+    } else {
+      // A new session, the server doesn't know about anything from before.
+      RequeueInflight();
+    }
+    if ((!sp || !subscriptions_sent_) && !subscriptions_.empty()) {
       LOG("MqttWrapper", debug) << "Sending async subscribe after connect";
       client_->async_subscribe(
           std::vector<std::tuple<std::string, std::uint8_t>>(
               subscriptions_.begin(), subscriptions_.end()));
     }
-    std::queue<PublishQueueItem> queue_copy;
-    std::swap(queue_copy, publish_queue_);
-    while (!queue_copy.empty()) {
-      auto item = queue_copy.front();
-      queue_copy.pop();
-      SafePublish(item);
+    subscriptions_sent_ = true;
+    if (spool_) {
+      if (!sp) {
+        // Whatever was sent before the connection dropped might not have
+        // arrived.
+        spool_->Rewind();
+      }
+      if (spool_->HasNext()) {
+        LOG("MqttWrapper", info)
+            << "Replaying " << spool_->size() << " spooled messages ("
+            << spool_->bytes() << " bytes)";
+      }
+    }
+    if (!publish_queue_.empty()) {
+      const auto& stats = publish_queue_.stats();
+      LOG("MqttWrapper", info)
+          << "Replaying " << publish_queue_.size() << " queued messages ("
+          << publish_queue_.bytes() << " bytes), " << stats.dropped
+          << " dropped and " << stats.coalesced << " coalesced so far";
+    }
+    if (HasBacklog()) {
+      draining_ = true;
+      ReplayQueue();
+    }
+  }
+
+  /** Sends the next slice of queued messages, and schedules the one after if
+   * there are any left. */
+  void ReplayQueue() {
+    if (state_ != ConnectionState::Connected) {
+      // Continues on the next ConnAck
+      return;
+    }
+    std::size_t count = std::numeric_limits<std::size_t>::max();
+    if (options_.replay_rate > 0) {
+      count = std::max<std::size_t>(
+          1, options_.replay_rate * kReplayPeriodMs / 1000);
+    }
+    publish_queue_.DropExpired();
+    // Spooled messages are older than the ones queued in memory.
+    bool spool_waiting = false;
+    while (count > 0 && spool_ && spool_->HasNext()) {
+      if (inflight_.full()) {
+        spool_waiting = true;
+        break;
+      }
+      if (!SendSpooled()) {
+        break;
+      }
+      count--;
+    }
+    while (!spool_waiting && count > 0 && !publish_queue_.empty()) {
+      if (publish_queue_.front().qos != mqtt::qos::at_most_once &&
+          inflight_.full()) {
+        break;
+      }
+      SendPublish(publish_queue_.Pop());
+      count--;
+    }
+    if (!HasBacklog()) {
+      if (draining_) {
+        draining_ = false;
+        connection_stats_.last_drain = Clock::now() - connected_at_;
+      }
+      return;
+    }
+    replay_pending_ = true;
+    replay_timer_.expires_from_now(
+        boost::posix_time::milliseconds(kReplayPeriodMs));
+    std::shared_ptr<MqttWrapperImpl<C>> self_ptr(this->shared_from_this());
+    std::shared_ptr<stlab::executor_t> executor_ptr(self_ptr,
+                                                    &mutex_queue_executor_);
+    replay_timer_.async_wait(
+        WeakExecutorBind(executor_ptr, &MqttWrapperImpl<C>::OnReplayTimer,
+                         self_ptr, std::placeholders::_1));
+  }
+
+  void OnReplayTimer(const boost::system::error_code& ec) {
+    if (ec) {
+      // Cancelled by rescheduling, which is still pending.
+      return;
     }
+    replay_pending_ = false;
+    ReplayQueue();
   }
 
   void ErrorHandler(const boost::system::error_code& error) {
-    std::weak_ptr<MqttWrapperImpl<C>> weak_this(this->shared_from_this());
     LOG("MqttWrapper", debug) << "ErrorHandler: " << error;
-    state_ = ConnectionState::Disconnected;
-    StartReconnectTimer();
+    OnDisconnected();
   }
 
   void FinishHandler(const boost::system::error_code& error) {
     LOG("MqttWrapper", debug) << "FinishHandler: " << error;
+    if (!error && state_ == ConnectionState::Connecting) {
+      // Still waiting for the ConnAck
+      return;
+    }
+    OnDisconnected();
+  }
+
+  void OnDisconnected() {
+    if (state_ == ConnectionState::Disconnected) {
+      // Both the error and finish handler report the same connection.
+      return;
+    }
+    if (state_ == ConnectionState::Connected) {
+      disconnected_at_ = Clock::now();
+      draining_ = false;
+    }
     state_ = ConnectionState::Disconnected;
+    FlightRecorder::Global().Add(FlightRecorder::Kind::MqttDisconnected, 0,
+                                 nullptr, 0);
+    if (options_.clean_session) {
+      RequeueInflight();
+    }
+    StartReconnectTimer();
+  }
+
+  void SafeNetworkChanged() {
+    if (state_ != ConnectionState::Disconnected) {
+      return;
+    }
+    LOG("MqttWrapper", info) << "Network changed, reconnecting right away";
+    backoff_.Reset();
     StartReconnectTimer();
   }
 
   void StartReconnectTimer() {
     boost::system::error_code ignore;
     reconnect_timer_.cancel(ignore);
-    LOG("MqttWrapper", debug) << "Starting reconnect timer...";
-    reconnect_timer_.expires_from_now(boost::posix_time::seconds(5));
+    ReconnectBackoff::Duration delay = backoff_.Next();
+    LOG("MqttWrapper", debug)
+        << "Reconnecting in " << delay.count() << " ms...";
+    reconnect_timer_.expires_from_now(
+        boost::posix_time::milliseconds(delay.count()));
     std::shared_ptr<MqttWrapperImpl<C>> self_ptr(this->shared_from_this());
     std::shared_ptr<stlab::executor_t> executor_ptr(self_ptr,
                                                     &mutex_queue_executor_);
@@ -203,6 +601,7 @@ class MqttWrapperImpl
       return;
     }
     LOG("MqttWrapper", info) << "Reconnecting to MQTT server...";
+    state_ = ConnectionState::Connecting;
     std::shared_ptr<MqttWrapperImpl<C>> self_ptr(this->shared_from_this());
     std::shared_ptr<stlab::executor_t> executor_ptr(self_ptr,
                                                     &mutex_queue_executor_);
@@ -214,75 +613,83 @@ class MqttWrapperImpl
   void AsyncPublishCallback(std::uint16_t packet_id,
                             const boost::system::error_code& error) {
     if (error) {
-      auto found = publish_inprogress_.find(packet_id);
-      if (found == publish_inprogress_.end()) {
+      auto entry = inflight_.Remove(packet_id);
+      if (!entry) {
         LOG("MqttWrapper", debug)
             << "AsyncPublishCallback: Packet ID " << packet_id << " not found";
         return;
       }
-      auto item = found->second;
-      publish_inprogress_.erase(found);
-      item.callback(std::make_exception_ptr(error));
+      // Thrown as a std::exception, which is what callers catch.
+      entry->item.callback(
+          std::make_exception_ptr(boost::system::system_error(error)));
+      ResumeBacklog();
       return;
     }
   }
 
   void PublishAcknowledgedHandler(std::uint16_t packet_id) {
     // Indicates a packet with QoS at least once was published succesfully.
-    auto found = publish_inprogress_.find(packet_id);
-    if (found == publish_inprogress_.end()) {
+    const InflightWindow::Entry* found = inflight_.Find(packet_id);
+    if (!found) {
       LOG("MqttWrapper", debug)
           << "PublishAcknowledge: Packet ID " << packet_id << " not found";
       return;
     }
-    auto item = found->second;
-    if (item.qos != mqtt::qos::at_least_once) {
+    if (found->item.qos != mqtt::qos::at_least_once) {
       LOG("MqttWrapper", debug)
           << "PublishAcknowledge: Packet ID " << packet_id
           << " was supposed to receive PublishComplete...";
       return;
     }
-    publish_inprogress_.erase(found);
-    item.callback(nullptr);
+    inflight_.Acknowledge(packet_id)->item.callback(nullptr);
+    ResumeBacklog();
     return;
   }
 
   void PublishCompletedHandler(std::uint16_t packet_id) {
     // Indicates a packet with QoS exactly once was published succesfully.
-    auto found = publish_inprogress_.find(packet_id);
-    if (found == publish_inprogress_.end()) {
+    const InflightWindow::Entry* found = inflight_.Find(packet_id);
+    if (!found) {
       LOG("MqttWrapper", debug)
           << "PublishComplete: Packet ID " << packet_id << " not found";
       return;
     }
-    auto item = found->second;
-    if (item.qos != mqtt::qos::exactly_once) {
+    if (found->item.qos != mqtt::qos::exactly_once) {
       LOG("MqttWrapper", debug)
           << "PublishComplete: Packet ID " << packet_id
           << " was supposed to receive PublishAcknowledge...";
       return;
     }
-    publish_inprogress_.erase(found);
-    item.callback(nullptr);
+    inflight_.Acknowledge(packet_id)->item.callback(nullptr);
+    ResumeBacklog();
     return;
   }
 
   void PublishHandler(std::uint8_t fixed_header,
                       boost::optional<std::uint16_t> packet_id,
                       std::string topic_name, std::string message) {
+    FlightRecorder::Global().Add(FlightRecorder::Kind::MqttIn,
+                                 mqtt::publish::get_qos(fixed_header),
+                                 topic_name, message);
     this->on_publish_(topic_name, message, mqtt::publish::get_qos(fixed_header),
                       mqtt::publish::is_retain(fixed_header));
   }
 };
 
+template <typename C>
+constexpr long MqttWrapperImpl<C>::kReplayPeriodMs;
+template <typename C>
+constexpr std::size_t MqttWrapperImpl<C>::kSpoolSegmentBytes;
+
 template <typename F, typename... Args>
 static std::shared_ptr<MqttWrapper> CreateMqttWrapperImpl(
-    F f, boost::asio::io_service& io_service, Args... args) {
+    F f, boost::asio::io_service& io_service,
+    const MqttWrapper::Options& options, Args... args) {
   typedef typename std::result_of<F(boost::asio::io_service&, Args...)>::type
       ReturnType;
   typedef typename ReturnType::element_type ClientType;
   auto wrapper = std::make_shared<MqttWrapperImpl<ClientType>>(
-      io_service, f(io_service, args...));
+      io_service, options, f(io_service, args...));
   wrapper->PostConstructor();
   return wrapper;
 }
@@ -0,0 +1,89 @@
+#include "network_monitor.h"
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "logging.h"
+
+namespace {
+// Give DHCP and routes a moment to settle after a link comes up.
+const boost::posix_time::milliseconds kDebounceDelay(250);
+}  // namespace
+
+NetworkMonitor::NetworkMonitor(boost::asio::io_service& io_service)
+    : netlink_(io_service), debounce_timer_(io_service) {}
+
+NetworkMonitor::~NetworkMonitor() {}
+
+std::shared_ptr<NetworkMonitor> NetworkMonitor::Create(
+    boost::asio::io_service& io_service) {
+  std::shared_ptr<NetworkMonitor> monitor(new NetworkMonitor(io_service));
+  monitor->StartWatching();
+  return monitor;
+}
+
+void NetworkMonitor::StartWatching() {
+  int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_ROUTE);
+  if (fd < 0) {
+    throw boost::system::system_error(
+        boost::system::error_code(errno, boost::system::system_category()),
+        "socket(AF_NETLINK)");
+  }
+  sockaddr_nl address = {};
+  address.nl_family = AF_NETLINK;
+  address.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR |
+                      RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    int bind_errno = errno;
+    close(fd);
+    throw boost::system::system_error(
+        boost::system::error_code(bind_errno, boost::system::system_category()),
+        "bind(AF_NETLINK)");
+  }
+  netlink_.assign(fd);
+  StartRead();
+}
+
+void NetworkMonitor::StartRead() {
+  std::weak_ptr<NetworkMonitor> weak_this(shared_from_this());
+  netlink_.async_read_some(
+      boost::asio::buffer(buffer_),
+      [weak_this](const boost::system::error_code& ec,
+                  std::size_t bytes_transferred) {
+        if (auto _this = weak_this.lock()) {
+          _this->ReadHandler(ec, bytes_transferred);
+        }
+      });
+}
+
+void NetworkMonitor::ReadHandler(const boost::system::error_code& ec,
+                                 std::size_t bytes_transferred) {
+  if (ec == boost::asio::error::operation_aborted) {
+    return;
+  }
+  if (ec && ec != boost::asio::error::no_buffer_space) {
+    LOG("NetworkMonitor", error)
+        << "Unable to read netlink messages: " << ec.message();
+    return;
+  }
+  // The contents don't matter, anything could make the server reachable
+  // again. When the kernel dropped messages (ENOBUFS) something changed too.
+  std::weak_ptr<NetworkMonitor> weak_this(shared_from_this());
+  debounce_timer_.expires_from_now(kDebounceDelay);
+  debounce_timer_.async_wait([weak_this](const boost::system::error_code& ec) {
+    if (auto _this = weak_this.lock()) {
+      _this->DebounceHandler(ec);
+    }
+  });
+  StartRead();
+}
+
+void NetworkMonitor::DebounceHandler(const boost::system::error_code& ec) {
+  if (ec == boost::asio::error::operation_aborted) {
+    // Restarted by a newer change
+    return;
+  }
+  LOG("NetworkMonitor", debug) << "Network configuration changed";
+  on_change_();
+}
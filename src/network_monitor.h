@@ -0,0 +1,37 @@
+#ifndef _NETWORK_MONITOR_H_
+#define _NETWORK_MONITOR_H_
+#include <array>
+#include <boost/asio.hpp>
+#include <boost/signals2/signal.hpp>
+#include <memory>
+
+/**
+ * Watches for network interfaces and addresses coming up or going away,
+ * using a rtnetlink socket.
+ *
+ * Bursts of changes, like an interface coming up and getting its addresses,
+ * are reported once.
+ */
+class NetworkMonitor : public std::enable_shared_from_this<NetworkMonitor> {
+ public:
+  ~NetworkMonitor();
+
+  static std::shared_ptr<NetworkMonitor> Create(
+      boost::asio::io_service& io_service);
+
+  // Called on the io_service after the network configuration changed.
+  boost::signals2::signal<void()> on_change_;
+
+ private:
+  explicit NetworkMonitor(boost::asio::io_service& io_service);
+  void StartWatching();
+  void StartRead();
+  void ReadHandler(const boost::system::error_code& ec,
+                   std::size_t bytes_transferred);
+  void DebounceHandler(const boost::system::error_code& ec);
+
+  boost::asio::posix::stream_descriptor netlink_;
+  boost::asio::deadline_timer debounce_timer_;
+  std::array<char, 8192> buffer_;
+};
+#endif  // _NETWORK_MONITOR_H_
@@ -0,0 +1,43 @@
+#include "payload_format.h"
+#include <stdexcept>
+#include <tao/json.hpp>
+#include <tao/json/cbor.hpp>
+#include <tao/json/msgpack.hpp>
+#include <tao/json/ubjson.hpp>
+
+std::string EncodePayload(PayloadFormat format, const tao::json::value& value) {
+  switch (format) {
+    case PayloadFormat::Json:
+      return tao::json::to_string(value);
+    case PayloadFormat::Cbor:
+      return tao::json::cbor::to_string(value);
+    case PayloadFormat::MsgPack:
+      return tao::json::msgpack::to_string(value);
+    case PayloadFormat::Ubjson:
+      return tao::json::ubjson::to_string(value);
+  }
+  throw std::logic_error("Unknown payload format");
+}
+
+tao::json::value DecodePayload(PayloadFormat format,
+                               const std::string& payload) {
+  switch (format) {
+    case PayloadFormat::Json:
+      return tao::json::from_string(payload);
+    case PayloadFormat::Cbor:
+      return tao::json::cbor::from_string(payload);
+    case PayloadFormat::MsgPack:
+      return tao::json::msgpack::from_string(payload);
+    case PayloadFormat::Ubjson:
+      return tao::json::ubjson::from_string(payload);
+  }
+  throw std::logic_error("Unknown payload format");
+}
+
+std::string PayloadForLog(PayloadFormat format, const std::string& payload) {
+  if (format == PayloadFormat::Json) {
+    return payload;
+  }
+  return std::to_string(payload.size()) + " bytes of " +
+         enum_to_string(format);
+}
@@ -0,0 +1,35 @@
+#ifndef _PAYLOAD_FORMAT_H_
+#define _PAYLOAD_FORMAT_H_
+#include <string>
+#include <tao/json/value.hpp>
+#include "string_enum.h"
+
+/** Encodings of the values in MQTT payloads. */
+enum class PayloadFormat {
+  Json,
+  // RFC 7049 Concise Binary Object Representation
+  Cbor,
+  MsgPack,
+  // Universal Binary JSON
+  Ubjson,
+};
+
+template <>
+struct StringEnumHelper<PayloadFormat> {
+  static std::map<PayloadFormat, std::string> lookup() {
+    return {{PayloadFormat::Json, "json"},
+            {PayloadFormat::Cbor, "cbor"},
+            {PayloadFormat::MsgPack, "msgpack"},
+            {PayloadFormat::Ubjson, "ubjson"}};
+  }
+};
+
+std::string EncodePayload(PayloadFormat format, const tao::json::value& value);
+
+/** Throws std::exception when payload is not a valid encoding of a value. */
+tao::json::value DecodePayload(PayloadFormat format,
+                               const std::string& payload);
+
+/** payload itself for JSON, a short description for the binary formats. */
+std::string PayloadForLog(PayloadFormat format, const std::string& payload);
+#endif  // _PAYLOAD_FORMAT_H_
@@ -0,0 +1,116 @@
+#include "publish_policy.h"
+#include <boost/property_tree/info_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <fstream>
+#include "logging.h"
+
+namespace {
+bool ParseFromPTree(std::map<TopicClass, PublishPolicy>& policies,
+                    const boost::property_tree::ptree& tree) {
+  for (const auto& item : tree) {
+    auto topic_class = string_to_enum<TopicClass>(item.first);
+    if (!topic_class) {
+      LOG("PublishPolicies", error)
+          << "Unknown topic class '" << item.first << "'";
+      return false;
+    }
+    PublishPolicy& policy = policies[*topic_class];
+    for (const auto& setting : item.second) {
+      if (setting.first == "qos") {
+        auto qos = setting.second.get_value_optional<unsigned int>();
+        if (!qos || *qos > 2) {
+          LOG("PublishPolicies", error)
+              << "Invalid QoS '" << setting.second.data() << "' for '"
+              << item.first << "'";
+          return false;
+        }
+        policy.qos = (std::uint8_t)*qos;
+      } else if (setting.first == "retain") {
+        auto retain = setting.second.get_value_optional<bool>();
+        if (!retain) {
+          LOG("PublishPolicies", error)
+              << "Invalid retain flag '" << setting.second.data() << "' for '"
+              << item.first << "'";
+          return false;
+        }
+        policy.retain = *retain;
+      } else if (setting.first == "expiry") {
+        auto expiry = setting.second.get_value_optional<unsigned int>();
+        if (!expiry) {
+          LOG("PublishPolicies", error)
+              << "Invalid expiry '" << setting.second.data() << "' for '"
+              << item.first << "'";
+          return false;
+        }
+        policy.expiry = std::chrono::seconds(*expiry);
+      } else if (setting.first == "format") {
+        auto format = string_to_enum<PayloadFormat>(setting.second.data());
+        if (!format) {
+          LOG("PublishPolicies", error)
+              << "Invalid format '" << setting.second.data() << "' for '"
+              << item.first << "'";
+          return false;
+        }
+        policy.format = *format;
+      } else if (setting.first == "durable") {
+        auto durable = setting.second.get_value_optional<bool>();
+        if (!durable) {
+          LOG("PublishPolicies", error)
+              << "Invalid durable flag '" << setting.second.data() << "' for '"
+              << item.first << "'";
+          return false;
+        }
+        policy.durable = *durable;
+      } else {
+        LOG("PublishPolicies", error) << "Unknown setting '" << setting.first
+                                      << "' for '" << item.first << "'";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+}  // namespace
+
+PublishPolicies::PublishPolicies()
+    : policies_{{TopicClass::Telemetry, {0, false}},
+                {TopicClass::LinkQuality, {0, false}},
+                {TopicClass::Report, {1, false}},
+                {TopicClass::State, {1, true}},
+                {TopicClass::Alarm,
+                 {1, false, std::chrono::seconds::zero(), PayloadFormat::Json,
+                  true}}} {}
+
+const PublishPolicy& PublishPolicies::Get(TopicClass topic_class) const {
+  return policies_.at(topic_class);
+}
+
+void PublishPolicies::Set(TopicClass topic_class, PublishPolicy policy) {
+  policies_[topic_class] = policy;
+}
+
+bool PublishPolicies::ParseFromFile(const std::string& filename) {
+  std::ifstream stream(filename);
+  if (!stream) {
+    LOG("PublishPolicies", error) << "Unable to open '" << filename << "'";
+    return false;
+  }
+  return ParseFromStream(stream);
+}
+
+bool PublishPolicies::ParseFromStream(std::istream& stream) {
+  boost::property_tree::ptree tree;
+  try {
+    boost::property_tree::info_parser::read_info(stream, tree);
+  } catch (const boost::property_tree::info_parser_error& ex) {
+    LOG("PublishPolicies", error) << "Unable to parse: " << ex.what();
+    return false;
+  }
+  // Only apply the settings if all of them are valid.
+  std::map<TopicClass, PublishPolicy> policies = policies_;
+  if (!ParseFromPTree(policies, tree)) {
+    return false;
+  }
+  policies_ = std::move(policies);
+  return true;
+}
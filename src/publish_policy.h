@@ -0,0 +1,55 @@
+#ifndef _PUBLISH_POLICY_H_
+#define _PUBLISH_POLICY_H_
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include "payload_format.h"
+#include "topic_class.h"
+
+struct PublishPolicy {
+  std::uint8_t qos;
+  bool retain;
+  // Messages not sent within this time are dropped, zero to never expire.
+  std::chrono::seconds expiry{0};
+  PayloadFormat format = PayloadFormat::Json;
+  // Spooled and flushed to disk before it is sent, even when connected, so it
+  // isn't lost to a restart before the server confirmed it. Only applies to
+  // QoS 1 and 2 with a spool directory.
+  bool durable = false;
+};
+
+/**
+ * QoS, retain flag, expiry, and payload format to publish each class of
+ * topic with.
+ *
+ * Defaults to QoS 0 for frequent, low-value telemetry & link quality, QoS 1
+ * durable for alarms, QoS 1 for hub reports, and QoS 1 retained for device
+ * state. Can be overridden from a Boost property-tree info file, e.g.:
+ *
+ *   telemetry
+ *   {
+ *       qos 1
+ *       expiry 300
+ *       format cbor
+ *   }
+ *   state
+ *   {
+ *       retain false
+ *   }
+ */
+class PublishPolicies {
+ public:
+  PublishPolicies();
+
+  const PublishPolicy& Get(TopicClass topic_class) const;
+  void Set(TopicClass topic_class, PublishPolicy policy);
+
+  bool ParseFromFile(const std::string& filename);
+  bool ParseFromStream(std::istream& stream);
+
+ private:
+  std::map<TopicClass, PublishPolicy> policies_;
+};
+#endif  // _PUBLISH_POLICY_H_
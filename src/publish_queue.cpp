@@ -0,0 +1,124 @@
+#include "publish_queue.h"
+#include <stdexcept>
+
+PublishQueue::PublishQueue(std::size_t max_bytes, Policy policy)
+    : max_bytes_(max_bytes), policy_(policy) {}
+
+std::size_t PublishQueue::ItemBytes(const Item& item) {
+  return sizeof(Item) + item.topic_name.size() + item.message.size();
+}
+
+void PublishQueue::Push(Item item) {
+  std::size_t item_bytes = ItemBytes(item);
+  if (item_bytes > max_bytes_) {
+    stats_.dropped++;
+    if (item.callback) {
+      item.callback(std::make_exception_ptr(
+          std::runtime_error("Message too large for the publish queue")));
+    }
+    return;
+  }
+  if (policy_ == Policy::CoalesceTopic) {
+    auto found = by_topic_.find(item.topic_name);
+    if (found != by_topic_.end()) {
+      stats_.coalesced++;
+      Drop(found->second, "Superseded by a newer message to the same topic");
+    }
+  }
+  MakeRoom(item_bytes);
+  bytes_ += item_bytes;
+  if (item.qos == 0) {
+    qos0_count_++;
+  }
+  items_.push_back(std::move(item));
+  if (policy_ == Policy::CoalesceTopic) {
+    by_topic_[items_.back().topic_name] = std::prev(items_.end());
+  }
+  stats_.queued++;
+}
+
+void PublishQueue::PushFront(std::vector<Item> items) {
+  // Newest first, so a newer message to the same topic is already queued when
+  // coming across an older one.
+  for (auto item = items.rbegin(); item != items.rend(); ++item) {
+    const char* drop_reason = nullptr;
+    if (ItemBytes(*item) > max_bytes_) {
+      stats_.dropped++;
+      drop_reason = "Message too large for the publish queue";
+    } else if (policy_ == Policy::CoalesceTopic &&
+               by_topic_.count(item->topic_name) > 0) {
+      stats_.coalesced++;
+      drop_reason = "Superseded by a newer message to the same topic";
+    }
+    if (drop_reason) {
+      if (item->callback) {
+        item->callback(
+            std::make_exception_ptr(std::runtime_error(drop_reason)));
+      }
+      continue;
+    }
+    bytes_ += ItemBytes(*item);
+    if (item->qos == 0) {
+      qos0_count_++;
+    }
+    items_.push_front(std::move(*item));
+    if (policy_ == Policy::CoalesceTopic) {
+      by_topic_[items_.front().topic_name] = items_.begin();
+    }
+    stats_.queued++;
+  }
+  MakeRoom(0);
+}
+
+PublishQueue::Item PublishQueue::Pop() {
+  Iterator front = items_.begin();
+  Forget(front);
+  Item item = std::move(*front);
+  items_.erase(front);
+  return item;
+}
+
+void PublishQueue::DropExpired(Clock::time_point now) {
+  for (Iterator it = items_.begin(); it != items_.end();) {
+    Iterator current = it++;
+    if (Expired(*current, now)) {
+      stats_.expired++;
+      Drop(current, "Expired before it could be published");
+    }
+  }
+}
+
+void PublishQueue::Forget(Iterator position) {
+  bytes_ -= ItemBytes(*position);
+  if (position->qos == 0) {
+    qos0_count_--;
+  }
+  if (policy_ == Policy::CoalesceTopic) {
+    auto found = by_topic_.find(position->topic_name);
+    if (found != by_topic_.end() && found->second == position) {
+      by_topic_.erase(found);
+    }
+  }
+}
+
+void PublishQueue::Drop(Iterator position, const char* reason) {
+  Forget(position);
+  auto callback = std::move(position->callback);
+  items_.erase(position);
+  if (callback) {
+    callback(std::make_exception_ptr(std::runtime_error(reason)));
+  }
+}
+
+void PublishQueue::MakeRoom(std::size_t needed) {
+  while (bytes_ + needed > max_bytes_ && !items_.empty()) {
+    Iterator victim = items_.begin();
+    if (policy_ == Policy::DropQos0First && qos0_count_ > 0) {
+      while (victim->qos != 0) {
+        ++victim;
+      }
+    }
+    stats_.dropped++;
+    Drop(victim, "Dropped from the publish queue, it was full");
+  }
+}
@@ -0,0 +1,92 @@
+#ifndef _PUBLISH_QUEUE_H_
+#define _PUBLISH_QUEUE_H_
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Queue of messages waiting for the MQTT connection, capped in bytes.
+ *
+ * When a new message doesn't fit, older messages are dropped according to
+ * the policy. Dropped messages have their callback called with an exception.
+ */
+class PublishQueue {
+ public:
+  typedef std::chrono::system_clock Clock;
+
+  enum class Policy {
+    // Drop the oldest messages.
+    DropOldest,
+    // Drop the oldest QoS 0 messages (e.g. telemetry) before any others, so
+    // messages published with a higher QoS (e.g. alarms) are kept longest.
+    DropQos0First,
+    // Keep only the latest message per topic, dropping older ones queued for
+    // the same topic. Drops the oldest messages when that's not enough.
+    CoalesceTopic,
+  };
+
+  struct Item {
+    std::string topic_name;
+    std::string message;
+    std::uint8_t qos;
+    bool retain;
+    std::function<void(std::exception_ptr)> callback;
+    // Not sent after this time, the epoch for never.
+    Clock::time_point expires_at{};
+    // Spooled even when it could be sent right away.
+    bool durable = false;
+  };
+
+  struct Stats {
+    std::uint64_t queued = 0;
+    std::uint64_t dropped = 0;
+    std::uint64_t coalesced = 0;
+    std::uint64_t expired = 0;
+  };
+
+  PublishQueue(std::size_t max_bytes, Policy policy);
+
+  void Push(Item item);
+  /** Puts items back in front of the queue, in their order, e.g. messages
+   * that were sent but never confirmed. Under Policy::CoalesceTopic, items
+   * superseded by a newer message to the same topic are dropped. */
+  void PushFront(std::vector<Item> items);
+  Item Pop();
+  const Item& front() const { return items_.front(); }
+  /** Drops the messages that expired by now. */
+  void DropExpired(Clock::time_point now = Clock::now());
+
+  bool empty() const { return items_.empty(); }
+  std::size_t size() const { return items_.size(); }
+  std::size_t bytes() const { return bytes_; }
+  const Stats& stats() const { return stats_; }
+
+  /** Size an item is accounted for, including bookkeeping overhead. */
+  static std::size_t ItemBytes(const Item& item);
+  static bool Expired(const Item& item, Clock::time_point now) {
+    return item.expires_at != Clock::time_point() && item.expires_at <= now;
+  }
+
+ private:
+  typedef std::list<Item>::iterator Iterator;
+
+  const std::size_t max_bytes_;
+  const Policy policy_;
+  std::list<Item> items_;
+  std::size_t bytes_ = 0;
+  std::size_t qos0_count_ = 0;
+  // Only maintained for Policy::CoalesceTopic.
+  std::unordered_map<std::string, Iterator> by_topic_;
+  Stats stats_;
+
+  // Removes position from the bookkeeping, but not from items_.
+  void Forget(Iterator position);
+  void Drop(Iterator position, const char* reason);
+  void MakeRoom(std::size_t needed);
+};
+#endif  // _PUBLISH_QUEUE_H_
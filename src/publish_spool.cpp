@@ -0,0 +1,479 @@
+#include "publish_spool.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <boost/system/system_error.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "logging.h"
+
+namespace {
+const char kSegmentSuffix[] = ".spool";
+const std::size_t kSegmentNameLength = 16 + sizeof(kSegmentSuffix) - 1;
+
+// Records are stored as length and CRC-32 of the body, followed by the body:
+// sequence number, expiry time in milliseconds since the epoch (0 for never),
+// QoS, retain flag, topic length, topic and message. All in host byte order,
+// the spool isn't meant to be moved between machines.
+const std::size_t kHeaderSize = 2 * sizeof(std::uint32_t);
+const std::size_t kBodyFixedSize = 2 * sizeof(std::uint64_t) +
+                                   2 * sizeof(std::uint8_t) +
+                                   sizeof(std::uint16_t);
+
+void ThrowErrno(const std::string& what) {
+  throw boost::system::system_error(
+      boost::system::error_code(errno, boost::system::system_category()),
+      what);
+}
+
+template <typename T>
+void Put(std::string& buffer, T value) {
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T Get(const char*& data) {
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  data += sizeof(value);
+  return value;
+}
+
+std::uint32_t Crc32(const char* data, std::size_t size) {
+  boost::crc_32_type crc;
+  crc.process_bytes(data, size);
+  return crc.checksum();
+}
+
+std::string EncodeRecord(std::uint64_t sequence, const std::string& topic_name,
+                         const std::string& message, std::uint8_t qos,
+                         bool retain,
+                         PublishSpool::Clock::time_point expires_at) {
+  std::string body;
+  body.reserve(kBodyFixedSize + topic_name.size() + message.size());
+  Put<std::uint64_t>(body, sequence);
+  Put<std::uint64_t>(body,
+                     std::chrono::duration_cast<std::chrono::milliseconds>(
+                         expires_at.time_since_epoch())
+                         .count());
+  Put<std::uint8_t>(body, qos);
+  Put<std::uint8_t>(body, retain ? 1 : 0);
+  Put<std::uint16_t>(body, topic_name.size());
+  body += topic_name;
+  body += message;
+
+  std::string record;
+  record.reserve(kHeaderSize + body.size());
+  Put<std::uint32_t>(record, body.size());
+  Put<std::uint32_t>(record, Crc32(body.data(), body.size()));
+  record += body;
+  return record;
+}
+
+// Decodes the record at data[offset], returning its size on disk, or 0 if
+// there is no complete and intact record.
+std::size_t DecodeRecord(const char* data, std::size_t size, std::size_t offset,
+                         PublishSpool::Record* record) {
+  if (size - offset < kHeaderSize) {
+    return 0;
+  }
+  const char* pos = data + offset;
+  std::uint32_t length = Get<std::uint32_t>(pos);
+  std::uint32_t crc = Get<std::uint32_t>(pos);
+  if (length < kBodyFixedSize || size - offset - kHeaderSize < length ||
+      Crc32(pos, length) != crc) {
+    return 0;
+  }
+  const char* end = pos + length;
+  record->sequence = Get<std::uint64_t>(pos);
+  record->expires_at = PublishSpool::Clock::time_point(
+      std::chrono::duration_cast<PublishSpool::Clock::duration>(
+          std::chrono::milliseconds(Get<std::uint64_t>(pos))));
+  record->qos = Get<std::uint8_t>(pos);
+  record->retain = Get<std::uint8_t>(pos) != 0;
+  std::uint16_t topic_length = Get<std::uint16_t>(pos);
+  if (topic_length > end - pos) {
+    return 0;
+  }
+  record->topic_name.assign(pos, topic_length);
+  record->message.assign(pos + topic_length, end);
+  return kHeaderSize + length;
+}
+
+void WriteAll(int fd, const std::string& data, const std::string& path) {
+  std::size_t written = 0;
+  while (written < data.size()) {
+    ssize_t result = write(fd, data.data() + written, data.size() - written);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ThrowErrno("write " + path);
+    }
+    written += result;
+  }
+}
+}  // namespace
+
+PublishSpool::PublishSpool(std::string directory, std::size_t segment_bytes,
+                           std::size_t max_bytes)
+    : directory_(std::move(directory)),
+      segment_bytes_(segment_bytes),
+      max_bytes_(max_bytes) {
+  Recover();
+}
+
+PublishSpool::~PublishSpool() {
+  try {
+    Sync();
+  } catch (const std::exception& ex) {
+    LOG("PublishSpool", error) << "Unable to sync spool: " << ex.what();
+  }
+  Unmap();
+  CloseAppend();
+}
+
+std::string PublishSpool::SegmentPath(std::uint64_t first_sequence) const {
+  char name[kSegmentNameLength + 1];
+  std::snprintf(name, sizeof(name), "%016llx%s",
+                (unsigned long long)first_sequence, kSegmentSuffix);
+  return directory_ + "/" + name;
+}
+
+std::string PublishSpool::CursorPath() const { return directory_ + "/cursor"; }
+
+void PublishSpool::Recover() {
+  if (mkdir(directory_.c_str(), 0755) != 0 && errno != EEXIST) {
+    ThrowErrno("mkdir " + directory_);
+  }
+
+  int cursor_fd = open(CursorPath().c_str(), O_RDONLY | O_CLOEXEC);
+  if (cursor_fd >= 0) {
+    std::uint64_t committed;
+    if (read(cursor_fd, &committed, sizeof(committed)) == sizeof(committed)) {
+      committed_ = committed;
+    }
+    close(cursor_fd);
+  }
+
+  DIR* dir = opendir(directory_.c_str());
+  if (dir == nullptr) {
+    ThrowErrno("opendir " + directory_);
+  }
+  std::vector<std::uint64_t> first_sequences;
+  while (dirent* entry = readdir(dir)) {
+    std::string name(entry->d_name);
+    if (name.size() != kSegmentNameLength ||
+        name.compare(16, std::string::npos, kSegmentSuffix) != 0) {
+      continue;
+    }
+    char* end;
+    std::uint64_t first_sequence = std::strtoull(name.c_str(), &end, 16);
+    if (end == name.c_str() + 16) {
+      first_sequences.push_back(first_sequence);
+    }
+  }
+  closedir(dir);
+  std::sort(first_sequences.begin(), first_sequences.end());
+
+  next_sequence_ = committed_;
+  for (std::size_t i = 0; i < first_sequences.size(); i++) {
+    bool last = i + 1 == first_sequences.size();
+    Segment segment{first_sequences[i], first_sequences[i], 0};
+    ScanSegment(segment, last);
+    if (!last && segment.end_sequence <= committed_) {
+      // Fully acknowledged, but not removed yet
+      if (unlink(SegmentPath(segment.first_sequence).c_str()) != 0) {
+        ThrowErrno("unlink " + SegmentPath(segment.first_sequence));
+      }
+      continue;
+    }
+    bytes_ += segment.size;
+    next_sequence_ = std::max(next_sequence_, segment.end_sequence);
+    segments_.push_back(segment);
+  }
+  AdvanceCommitted();
+
+  if (!segments_.empty() && segments_.back().size < segment_bytes_) {
+    std::string path = SegmentPath(segments_.back().first_sequence);
+    append_fd_ = open(path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    if (append_fd_ < 0) {
+      ThrowErrno("open " + path);
+    }
+  }
+  if (size() > 0) {
+    LOG("PublishSpool", info) << "Recovered " << size()
+                              << " spooled messages from " << directory_;
+  }
+}
+
+void PublishSpool::ScanSegment(Segment& segment, bool truncate_torn) {
+  std::string path = SegmentPath(segment.first_sequence);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    ThrowErrno("open " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    ThrowErrno("fstat " + path);
+  }
+  std::size_t file_size = st.st_size;
+  std::size_t offset = 0;
+  if (file_size > 0) {
+    void* data = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      ThrowErrno("mmap " + path);
+    }
+    Record record;
+    while (std::size_t record_size = DecodeRecord(
+               static_cast<const char*>(data), file_size, offset, &record)) {
+      if (record.sequence != segment.end_sequence) {
+        break;
+      }
+      segment.end_sequence++;
+      offset += record_size;
+    }
+    munmap(data, file_size);
+  }
+  close(fd);
+  segment.size = offset;
+  if (offset < file_size) {
+    LOG("PublishSpool", warning)
+        << "Ignoring " << (file_size - offset)
+        << " damaged bytes at the end of " << path;
+    if (truncate_torn && truncate(path.c_str(), offset) != 0) {
+      ThrowErrno("truncate " + path);
+    }
+  }
+}
+
+boost::optional<std::uint64_t> PublishSpool::Append(
+    const std::string& topic_name, const std::string& message,
+    std::uint8_t qos, bool retain, Clock::time_point expires_at) {
+  if (topic_name.size() > UINT16_MAX) {
+    return boost::none;
+  }
+  std::string record = EncodeRecord(next_sequence_, topic_name, message, qos,
+                                    retain, expires_at);
+  if (bytes_ + record.size() > max_bytes_) {
+    return boost::none;
+  }
+  if (append_fd_ < 0) {
+    std::string path = SegmentPath(next_sequence_);
+    append_fd_ =
+        open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC,
+             0644);
+    if (append_fd_ < 0) {
+      ThrowErrno("open " + path);
+    }
+    segments_.push_back(Segment{next_sequence_, next_sequence_, 0});
+    directory_dirty_ = true;
+  }
+  Segment& segment = segments_.back();
+  WriteAll(append_fd_, record, SegmentPath(segment.first_sequence));
+  segment.size += record.size();
+  segment.end_sequence = next_sequence_ + 1;
+  bytes_ += record.size();
+  data_dirty_ = true;
+
+  if (segment.size >= segment_bytes_) {
+    // Sync full segments right away, so only the last one can be dirty.
+    if (fdatasync(append_fd_) != 0) {
+      ThrowErrno("fdatasync " + SegmentPath(segment.first_sequence));
+    }
+    data_dirty_ = false;
+    CloseAppend();
+  }
+  return next_sequence_++;
+}
+
+void PublishSpool::Sync() {
+  if (data_dirty_ && append_fd_ >= 0) {
+    if (fdatasync(append_fd_) != 0) {
+      ThrowErrno("fdatasync " + SegmentPath(segments_.back().first_sequence));
+    }
+  }
+  data_dirty_ = false;
+  if (directory_dirty_) {
+    int fd = open(directory_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+      ThrowErrno("open " + directory_);
+    }
+    int result = fsync(fd);
+    close(fd);
+    if (result != 0) {
+      ThrowErrno("fsync " + directory_);
+    }
+    directory_dirty_ = false;
+  }
+  if (cursor_dirty_) {
+    // An outdated cursor only causes messages to be sent again, so the rename
+    // isn't synced separately.
+    std::string temp_path = CursorPath() + ".tmp";
+    int fd = open(temp_path.c_str(),
+                  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      ThrowErrno("open " + temp_path);
+    }
+    std::string data;
+    Put<std::uint64_t>(data, committed_);
+    try {
+      WriteAll(fd, data, temp_path);
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    int result = fdatasync(fd);
+    close(fd);
+    if (result != 0) {
+      ThrowErrno("fdatasync " + temp_path);
+    }
+    if (rename(temp_path.c_str(), CursorPath().c_str()) != 0) {
+      ThrowErrno("rename " + temp_path);
+    }
+    cursor_dirty_ = false;
+  }
+}
+
+boost::optional<PublishSpool::Record> PublishSpool::Next() {
+  while (read_segment_ < segments_.size()) {
+    const Segment& segment = segments_[read_segment_];
+    if (read_offset_ >= segment.size) {
+      if (read_segment_ + 1 == segments_.size()) {
+        break;
+      }
+      Unmap();
+      read_segment_++;
+      read_offset_ = 0;
+      continue;
+    }
+    if (map_size_ < segment.size) {
+      // New segment, or records were appended since it was mapped.
+      Map(segment.size);
+    }
+    Record record;
+    std::size_t record_size =
+        DecodeRecord(map_, map_size_, read_offset_, &record);
+    if (record_size == 0) {
+      LOG("PublishSpool", error)
+          << "Damaged record in " << SegmentPath(segment.first_sequence)
+          << ", skipping the rest of the segment";
+      read_offset_ = segment.size;
+      continue;
+    }
+    read_offset_ += record_size;
+    if (record.sequence < committed_ ||
+        acknowledged_.count(record.sequence) != 0) {
+      continue;
+    }
+    return std::move(record);
+  }
+  return boost::none;
+}
+
+bool PublishSpool::HasNext() const {
+  return read_segment_ < segments_.size() &&
+         (read_offset_ < segments_[read_segment_].size ||
+          read_segment_ + 1 < segments_.size());
+}
+
+void PublishSpool::Acknowledge(std::uint64_t sequence) {
+  if (sequence < committed_ || sequence >= next_sequence_) {
+    return;
+  }
+  acknowledged_.insert(sequence);
+  AdvanceCommitted();
+  Compact();
+}
+
+void PublishSpool::Rewind() {
+  Unmap();
+  read_segment_ = 0;
+  read_offset_ = 0;
+}
+
+void PublishSpool::Map(std::size_t size) {
+  Unmap();
+  std::string path = SegmentPath(segments_[read_segment_].first_sequence);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    ThrowErrno("open " + path);
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    ThrowErrno("mmap " + path);
+  }
+  map_ = static_cast<const char*>(data);
+  map_size_ = size;
+}
+
+void PublishSpool::Unmap() {
+  if (map_ != nullptr) {
+    munmap(const_cast<char*>(map_), map_size_);
+    map_ = nullptr;
+    map_size_ = 0;
+  }
+}
+
+void PublishSpool::AdvanceCommitted() {
+  std::uint64_t committed = committed_;
+  for (;;) {
+    if (!acknowledged_.empty() && *acknowledged_.begin() == committed_) {
+      acknowledged_.erase(acknowledged_.begin());
+      committed_++;
+      continue;
+    }
+    // Skip records lost to damaged segments.
+    auto segment = std::find_if(
+        segments_.begin(), segments_.end(),
+        [this](const Segment& s) { return s.end_sequence > committed_; });
+    if (segment != segments_.end() && segment->first_sequence > committed_) {
+      committed_ = segment->first_sequence;
+      acknowledged_.erase(acknowledged_.begin(),
+                          acknowledged_.lower_bound(committed_));
+      continue;
+    }
+    break;
+  }
+  if (committed_ != committed) {
+    cursor_dirty_ = true;
+  }
+}
+
+void PublishSpool::Compact() {
+  while (!segments_.empty() && segments_.front().end_sequence <= committed_ &&
+         (segments_.size() > 1 || append_fd_ < 0)) {
+    const Segment& segment = segments_.front();
+    std::string path = SegmentPath(segment.first_sequence);
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+      LOG("PublishSpool", warning)
+          << "Unable to remove " << path << ": " << std::strerror(errno);
+    }
+    bytes_ -= segment.size;
+    if (read_segment_ == 0) {
+      Unmap();
+      read_offset_ = 0;
+    } else {
+      read_segment_--;
+    }
+    segments_.pop_front();
+    cursor_dirty_ = true;
+  }
+}
+
+void PublishSpool::CloseAppend() {
+  if (append_fd_ >= 0) {
+    close(append_fd_);
+    append_fd_ = -1;
+  }
+}
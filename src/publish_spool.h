@@ -0,0 +1,113 @@
+#ifndef _PUBLISH_SPOOL_H_
+#define _PUBLISH_SPOOL_H_
+#include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <string>
+
+/**
+ * Append-only on-disk spool of messages waiting for the MQTT connection, so
+ * they survive a restart.
+ *
+ * Records are appended to segment files in a directory, named after the
+ * sequence number of their first record. Appends are handed to the OS right
+ * away, but only flushed to disk by Sync(), so that many messages share one
+ * write to the (SD card) storage. Records are read back in order through a
+ * memory map, and a segment file is deleted once all of its records were
+ * acknowledged. The first unacknowledged sequence number is stored in a
+ * cursor file on Sync().
+ *
+ * Errors accessing the directory throw boost::system::system_error.
+ */
+class PublishSpool {
+ public:
+  typedef std::chrono::system_clock Clock;
+
+  struct Record {
+    std::uint64_t sequence;
+    std::string topic_name;
+    std::string message;
+    std::uint8_t qos;
+    bool retain;
+    // The epoch for never.
+    Clock::time_point expires_at;
+  };
+
+  /** Opens the spool in directory, creating it when needed, and recovers the
+   * records left unacknowledged by a previous run. */
+  PublishSpool(std::string directory, std::size_t segment_bytes,
+               std::size_t max_bytes);
+  ~PublishSpool();
+  PublishSpool(const PublishSpool&) = delete;
+  PublishSpool& operator=(const PublishSpool&) = delete;
+
+  /** Returns the sequence number of the record, or boost::none if the spool
+   * is full. */
+  boost::optional<std::uint64_t> Append(
+      const std::string& topic_name, const std::string& message,
+      std::uint8_t qos, bool retain,
+      Clock::time_point expires_at = Clock::time_point());
+  /** Flushes appended records and the cursor to disk, if they changed. */
+  void Sync();
+  bool dirty() const {
+    return data_dirty_ || directory_dirty_ || cursor_dirty_;
+  }
+
+  /** Next record to send, or boost::none when all records were read. */
+  boost::optional<Record> Next();
+  bool HasNext() const;
+  void Acknowledge(std::uint64_t sequence);
+  /** Continues reading at the oldest unacknowledged record, e.g. because the
+   * records read so far might not have arrived. */
+  void Rewind();
+
+  /** Number of records not acknowledged yet. */
+  std::size_t size() const {
+    return next_sequence_ - committed_ - acknowledged_.size();
+  }
+  /** Size of all segment files. */
+  std::size_t bytes() const { return bytes_; }
+
+ private:
+  struct Segment {
+    std::uint64_t first_sequence;
+    // One past the sequence number of the last record in the segment.
+    std::uint64_t end_sequence;
+    std::size_t size;
+  };
+
+  const std::string directory_;
+  const std::size_t segment_bytes_;
+  const std::size_t max_bytes_;
+  std::deque<Segment> segments_;
+  std::size_t bytes_ = 0;
+  std::uint64_t next_sequence_ = 0;
+  // Every record before this one was acknowledged.
+  std::uint64_t committed_ = 0;
+  // Acknowledged records after committed_.
+  std::set<std::uint64_t> acknowledged_;
+  // File descriptor of the last segment, or -1 when a new one is needed.
+  int append_fd_ = -1;
+  bool data_dirty_ = false;
+  bool directory_dirty_ = false;
+  bool cursor_dirty_ = false;
+
+  // Read position, and the memory map of the segment being read.
+  std::size_t read_segment_ = 0;
+  std::size_t read_offset_ = 0;
+  const char* map_ = nullptr;
+  std::size_t map_size_ = 0;
+
+  std::string SegmentPath(std::uint64_t first_sequence) const;
+  std::string CursorPath() const;
+  void Recover();
+  void ScanSegment(Segment& segment, bool truncate_torn);
+  void Map(std::size_t size);
+  void Unmap();
+  void AdvanceCommitted();
+  void Compact();
+  void CloseAppend();
+};
+#endif  // _PUBLISH_SPOOL_H_
@@ -0,0 +1,25 @@
+#include "reconnect_backoff.h"
+#include <algorithm>
+
+ReconnectBackoff::ReconnectBackoff(Duration min_delay, Duration max_delay,
+                                   std::uint32_t seed)
+    : min_delay_(min_delay),
+      max_delay_(std::max(min_delay, max_delay)),
+      previous_(min_delay),
+      random_(seed) {}
+
+ReconnectBackoff::Duration ReconnectBackoff::Next() {
+  if (!attempted_) {
+    attempted_ = true;
+    return Duration::zero();
+  }
+  std::uniform_int_distribution<Duration::rep> distribution(
+      min_delay_.count(), std::max(min_delay_, previous_ * 3).count());
+  previous_ = std::min(max_delay_, Duration(distribution(random_)));
+  return previous_;
+}
+
+void ReconnectBackoff::Reset() {
+  attempted_ = false;
+  previous_ = min_delay_;
+}
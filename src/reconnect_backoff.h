@@ -0,0 +1,36 @@
+#ifndef _RECONNECT_BACKOFF_H_
+#define _RECONNECT_BACKOFF_H_
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+/**
+ * Delays between reconnection attempts.
+ *
+ * The first attempt after losing a connection is immediate, so a restarted
+ * server is picked up right away. After that the delays grow exponentially
+ * with "decorrelated jitter": each delay is random between the minimum and
+ * three times the previous delay, capped at the maximum. The randomness keeps
+ * clients from reconnecting in lockstep after an outage.
+ */
+class ReconnectBackoff {
+ public:
+  typedef std::chrono::milliseconds Duration;
+
+  ReconnectBackoff(Duration min_delay, Duration max_delay,
+                   std::uint32_t seed = std::random_device()());
+
+  /** Delay before the next attempt. */
+  Duration Next();
+  /** Starts over after a successful connection. */
+  void Reset();
+
+ private:
+  const Duration min_delay_;
+  const Duration max_delay_;
+  // Zero until the first (immediate) attempt was made.
+  Duration previous_;
+  bool attempted_ = false;
+  std::mt19937 random_;
+};
+#endif  // _RECONNECT_BACKOFF_H_
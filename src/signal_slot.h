@@ -0,0 +1,151 @@
+#ifndef _SIGNAL_SLOT_H_
+#define _SIGNAL_SLOT_H_
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+namespace detail {
+struct SlotState {
+  bool connected = true;
+};
+}  // namespace detail
+
+class Connection {
+ public:
+  Connection() = default;
+  explicit Connection(std::weak_ptr<detail::SlotState> state)
+      : state_(std::move(state)) {}
+
+  void disconnect() const {
+    if (auto state = state_.lock()) {
+      state->connected = false;
+    }
+  }
+  bool connected() const {
+    auto state = state_.lock();
+    return state && state->connected;
+  }
+
+ private:
+  std::weak_ptr<detail::SlotState> state_;
+};
+
+/** Disconnects when destroyed. */
+class ScopedConnection {
+ public:
+  ScopedConnection() = default;
+  ScopedConnection(Connection connection)
+      : connection_(std::move(connection)) {}
+  ScopedConnection(ScopedConnection&& other) = default;
+  ScopedConnection& operator=(ScopedConnection&& other) {
+    connection_.disconnect();
+    connection_ = std::move(other.connection_);
+    other.connection_ = Connection();
+    return *this;
+  }
+  ~ScopedConnection() { connection_.disconnect(); }
+
+  void disconnect() const { connection_.disconnect(); }
+  bool connected() const { return connection_.connected(); }
+
+ private:
+  Connection connection_;
+};
+
+template <typename Signature>
+class Signal;
+
+/**
+ * Single-threaded replacement for boost::signals2::signal, for signals raised
+ * once or more per incoming frame.
+ *
+ * Emitting doesn't take a lock or copy the slot list, and arguments are passed
+ * to the slots by const reference. Slots may connect or disconnect slots
+ * (including themselves) while the signal is emitted; newly connected slots
+ * are called from the next emission on.
+ *
+ * Connecting, disconnecting, and emitting must all happen on the same thread.
+ * Signals that cross threads should stay boost::signals2::signal.
+ */
+template <typename... Args>
+class Signal<void(Args...)> {
+ public:
+  template <typename T>
+  using ConstRef = const typename std::remove_reference<T>::type&;
+  typedef std::function<void(ConstRef<Args>...)> Slot;
+  typedef std::function<void(const Connection&, ConstRef<Args>...)>
+      ExtendedSlot;
+
+  Signal() = default;
+  Signal(const Signal&) = delete;
+  Signal& operator=(const Signal&) = delete;
+
+  Connection connect(Slot slot) {
+    slots_.push_back({std::make_shared<detail::SlotState>(), std::move(slot)});
+    return Connection(slots_.back().state);
+  }
+
+  /** Like connect(), but the slot also gets its own connection, e.g. to
+   * disconnect itself after the first call. */
+  Connection connect_extended(ExtendedSlot slot) {
+    auto state = std::make_shared<detail::SlotState>();
+    Connection connection(state);
+    slots_.push_back({std::move(state),
+                      [connection, slot](ConstRef<Args>... args) {
+                        slot(connection, args...);
+                      }});
+    return connection;
+  }
+
+  void operator()(ConstRef<Args>... args) {
+    // Slots connected while emitting are appended, which doesn't invalidate
+    // references to the others in a deque. Disconnected ones are only erased
+    // once no emission is in progress.
+    const std::size_t size = slots_.size();
+    emitting_++;
+    bool any_disconnected = false;
+    try {
+      for (std::size_t i = 0; i < size; i++) {
+        Entry& entry = slots_[i];
+        if (entry.state->connected) {
+          entry.slot(args...);
+        }
+        any_disconnected |= !entry.state->connected;
+      }
+    } catch (...) {
+      emitting_--;
+      throw;
+    }
+    emitting_--;
+    if (any_disconnected && emitting_ == 0) {
+      EraseDisconnected();
+    }
+  }
+
+  std::size_t num_slots() const {
+    return std::count_if(
+        slots_.begin(), slots_.end(),
+        [](const Entry& entry) { return entry.state->connected; });
+  }
+  bool empty() const { return num_slots() == 0; }
+
+ private:
+  struct Entry {
+    std::shared_ptr<detail::SlotState> state;
+    Slot slot;
+  };
+
+  void EraseDisconnected() {
+    slots_.erase(std::remove_if(slots_.begin(), slots_.end(),
+                                [](const Entry& entry) {
+                                  return !entry.state->connected;
+                                }),
+                 slots_.end());
+  }
+
+  std::deque<Entry> slots_;
+  unsigned int emitting_ = 0;
+};
+#endif  // _SIGNAL_SLOT_H_
@@ -10,10 +10,9 @@ struct StringEnumHelper;
 
 template <typename T>
 boost::optional<std::string> enum_to_string_opt(T value) {
-  static std::map<T, std::string> table;
-  if (table.empty()) {
-    table = StringEnumHelper<T>::lookup();
-  }
+  // Function-local static initialization is thread-safe, cluster info may be
+  // (re)loaded on a background thread.
+  static const std::map<T, std::string> table = StringEnumHelper<T>::lookup();
   auto found = table.find(value);
   if (found != table.end()) {
     return found->second;
@@ -36,12 +35,13 @@ std::string enum_to_string(T value) {
 
 template <typename T>
 boost::optional<T> string_to_enum(const std::string& value) {
-  static std::map<std::string, T> table;
-  if (table.empty()) {
+  static const std::map<std::string, T> table = []() {
+    std::map<std::string, T> table;
     for (const auto& item : StringEnumHelper<T>::lookup()) {
       table[item.second] = item.first;
     }
-  }
+    return table;
+  }();
   auto found = table.find(value);
   if (found != table.end()) {
     return found->second;
@@ -0,0 +1,29 @@
+#ifndef _TOPIC_CLASS_H_
+#define _TOPIC_CLASS_H_
+#include "string_enum.h"
+
+/** Kinds of MQTT topics AqaraHub publishes to, for per-class settings. */
+enum class TopicClass {
+  // Decoded ZCL commands and attributes, e.g. "<IEEE>/1/in/Basic/..."
+  Telemetry,
+  // "<IEEE>/linkquality"
+  LinkQuality,
+  // Hub events below "report/", e.g. permit join and device announcements.
+  Report,
+  // "<IEEE>/state", merged attribute state with --device-state.
+  State,
+  // Decoded ZCL commands and attributes of alarm clusters, i.e. IAS Zone.
+  Alarm,
+};
+
+template <>
+struct StringEnumHelper<TopicClass> {
+  static std::map<TopicClass, std::string> lookup() {
+    return {{TopicClass::Telemetry, "telemetry"},
+            {TopicClass::LinkQuality, "linkquality"},
+            {TopicClass::Report, "report"},
+            {TopicClass::State, "state"},
+            {TopicClass::Alarm, "alarm"}};
+  }
+};
+#endif  // _TOPIC_CLASS_H_
@@ -8,16 +8,12 @@
 
 namespace znp {
 template <>
-class EncodeHelper<zcl::ZclFrame> {
+class EncodeHelper<zcl::ZclFrameHeader> {
  public:
-  static inline std::size_t GetSize(const zcl::ZclFrame& value) {
-    if (value.manufacturer_code) {
-      return 5 + value.payload.size();
-    } else {
-      return 3 + value.payload.size();
-    }
+  static inline std::size_t GetSize(const zcl::ZclFrameHeader& value) {
+    return value.manufacturer_code ? 5 : 3;
   }
-  static inline void Encode(const zcl::ZclFrame& value,
+  static inline void Encode(const zcl::ZclFrameHeader& value,
                             EncodeTarget::iterator& begin,
                             EncodeTarget::iterator end) {
     uint8_t frame_control = 0;
@@ -34,13 +30,8 @@ class EncodeHelper<zcl::ZclFrame> {
                                   end);
     EncodeHelper<zcl::ZclCommandId>::Encode(value.command_identifier, begin,
                                             end);
-    if (end - begin != value.payload.end() - value.payload.begin()) {
-      throw std::runtime_error("Encoding buffer was of wrong size");
-    }
-    std::copy(value.payload.begin(), value.payload.end(), begin);
-    begin = end;
   }
-  static inline void Decode(zcl::ZclFrame& value,
+  static inline void Decode(zcl::ZclFrameHeader& value,
                             EncodeTarget::const_iterator& begin,
                             EncodeTarget::const_iterator end) {
     uint8_t frame_control;
@@ -62,6 +53,29 @@ class EncodeHelper<zcl::ZclFrame> {
                                   end);
     EncodeHelper<zcl::ZclCommandId>::Decode(value.command_identifier, begin,
                                             end);
+  }
+};
+template <>
+class EncodeHelper<zcl::ZclFrame> {
+ public:
+  static inline std::size_t GetSize(const zcl::ZclFrame& value) {
+    return EncodeHelper<zcl::ZclFrameHeader>::GetSize(value) +
+           value.payload.size();
+  }
+  static inline void Encode(const zcl::ZclFrame& value,
+                            EncodeTarget::iterator& begin,
+                            EncodeTarget::iterator end) {
+    EncodeHelper<zcl::ZclFrameHeader>::Encode(value, begin, end);
+    if (end - begin != value.payload.end() - value.payload.begin()) {
+      throw std::runtime_error("Encoding buffer was of wrong size");
+    }
+    std::copy(value.payload.begin(), value.payload.end(), begin);
+    begin = end;
+  }
+  static inline void Decode(zcl::ZclFrame& value,
+                            EncodeTarget::const_iterator& begin,
+                            EncodeTarget::const_iterator end) {
+    EncodeHelper<zcl::ZclFrameHeader>::Decode(value, begin, end);
     value.payload = std::vector<uint8_t>(begin, end);
     begin = end;
   }
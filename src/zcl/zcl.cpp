@@ -13,7 +13,8 @@ std::ostream& operator<<(std::ostream& stream, const ZclDirection& direction) {
   return stream << enum_to_string(direction);
 }
 
-std::ostream& operator<<(std::ostream& stream, const ZclFrame& header) {
+std::ostream& operator<<(std::ostream& stream,
+                         const ZclFrameHeader& header) {
   stream << "{frame_type: " << header.frame_type;
   if (header.manufacturer_code) {
     stream << ", manufacturer_code: " << *header.manufacturer_code;
@@ -30,7 +30,7 @@ enum class ZclCommandId : uint8_t {
   // Deliberately left empty
 };
 
-struct ZclFrame {
+struct ZclFrameHeader {
   ZclFrameType frame_type;
   boost::optional<uint16_t> manufacturer_code;
   ZclDirection direction;
@@ -38,9 +38,12 @@ struct ZclFrame {
   uint8_t reserved;
   uint8_t transaction_sequence_number;
   ZclCommandId command_identifier;
+};
+std::ostream& operator<<(std::ostream& stream, const ZclFrameHeader& header);
+
+struct ZclFrame : ZclFrameHeader {
   std::vector<uint8_t> payload;
 };
-std::ostream& operator<<(std::ostream& stream, const ZclFrame& header);
 
 enum class ZclGlobalCommandId : uint8_t {
   ReadAttributes = 0x00,
@@ -25,7 +25,7 @@ stlab::future<std::shared_ptr<ZclEndpoint>> ZclEndpoint::Create(
 void ZclEndpoint::AttachListeners() {
   std::weak_ptr<ZclEndpoint> weak_this(shared_from_this());
   listeners_.push_back(znp_api_->af_on_incoming_msg_.connect(
-      [weak_this](const znp::IncomingMsg& message) {
+      [weak_this](const std::shared_ptr<const znp::IncomingMsg>& message) {
         if (auto _this = weak_this.lock()) {
           try {
             _this->OnIncomingMsg(message);
@@ -37,25 +37,23 @@ void ZclEndpoint::AttachListeners() {
       }));
 }
 
-void ZclEndpoint::OnIncomingMsg(const znp::IncomingMsg& message) {
-  if (message.DstEndpoint != endpoint_) {
+void ZclEndpoint::OnIncomingMsg(
+    const std::shared_ptr<const znp::IncomingMsg>& message) {
+  if (message->DstEndpoint != endpoint_) {
     return;
   }
-  if (last_msg_[message.SrcAddr] == message.Data) {
-    LOG("ZclEndpoint", debug)
-        << "Ignoring duplicate message from " << (unsigned int)message.SrcAddr;
+  std::shared_ptr<const znp::IncomingMsg>& last_msg =
+      last_msg_[message->SrcAddr];
+  if (last_msg && last_msg->Data == message->Data) {
+    LOG("ZclEndpoint", debug) << "Ignoring duplicate message from "
+                              << (unsigned int)message->SrcAddr;
     return;
   }
-  last_msg_[message.SrcAddr] = message.Data;
-  auto frame = znp::Decode<ZclFrame>(message.Data);
-  if (frame.frame_type == ZclFrameType::Global) {
-    on_command_(message.SrcAddr, message.SrcEndpoint,
-                (ZclClusterId)message.ClusterId, true, frame.direction,
-                frame.command_identifier, frame.payload);
-  } else if (frame.frame_type == ZclFrameType::Local) {
-    on_command_(message.SrcAddr, message.SrcEndpoint,
-                (ZclClusterId)message.ClusterId, false, frame.direction,
-                frame.command_identifier, frame.payload);
+  last_msg = message;
+  auto zcl_message = ZclMessage::Create(message);
+  if (zcl_message->header().frame_type == ZclFrameType::Global ||
+      zcl_message->header().frame_type == ZclFrameType::Local) {
+    on_command_(zcl_message);
   } else {
     LOG("ZclEndpoint", debug) << "Unknown command type";
   }
@@ -1,6 +1,7 @@
 #ifndef _ZCL_ZCL_ENDPOINT_H_
 #define _ZCL_ZCL_ENDPOINT_H_
 #include "zcl/zcl.h"
+#include "zcl/zcl_message.h"
 #include "znp/znp_api.h"
 
 namespace zcl {
@@ -32,25 +33,22 @@ class ZclEndpoint : public std::enable_shared_from_this<ZclEndpoint> {
                                   ZclCommandId command_id,
                                   std::vector<uint8_t> payload);
 
-  boost::signals2::signal<void(
-      znp::ShortAddress source_address, uint8_t source_endpoint,
-      ZclClusterId cluster_id, bool is_global_command, ZclDirection direction,
-      ZclCommandId command_id, std::vector<uint8_t> payload)>
-      on_command_;
+  Signal<void(std::shared_ptr<const ZclMessage> message)> on_command_;
 
  private:
   ZclEndpoint(std::shared_ptr<znp::ZnpApi> znp_api, uint8_t endpoint);
   void AttachListeners();
-  void OnIncomingMsg(const znp::IncomingMsg& message);
+  void OnIncomingMsg(const std::shared_ptr<const znp::IncomingMsg>& message);
   void OnIncomingReportAttributes(const znp::IncomingMsg& message,
                                   const ZclFrame& frame);
   uint8_t NextTransSeqNumFor(znp::ShortAddress address);
 
   std::shared_ptr<znp::ZnpApi> znp_api_;
   const uint8_t endpoint_;
-  std::vector<boost::signals2::connection> listeners_;
+  std::vector<Connection> listeners_;
   std::map<znp::ShortAddress, uint8_t> send_trans_seq_nums_;
-  std::map<znp::ShortAddress, std::vector<uint8_t>> last_msg_;
+  std::map<znp::ShortAddress, std::shared_ptr<const znp::IncomingMsg>>
+      last_msg_;
 };
 }  // namespace zcl
 #endif  // _ZCL_ZCL_ENDPOINT_H_
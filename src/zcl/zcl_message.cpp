@@ -0,0 +1,20 @@
+#include "zcl/zcl_message.h"
+#include <boost/pool/pool_alloc.hpp>
+#include "zcl/encoding.h"
+
+namespace zcl {
+ZclMessage::ZclMessage(std::shared_ptr<const znp::IncomingMsg> incoming)
+    : incoming_(std::move(incoming)) {
+  payload_begin_ = incoming_->Data.cbegin();
+  znp::EncodeHelper<ZclFrameHeader>::Decode(header_, payload_begin_,
+                                            incoming_->Data.cend());
+}
+
+std::shared_ptr<const ZclMessage> ZclMessage::Create(
+    std::shared_ptr<const znp::IncomingMsg> incoming) {
+  // Messages may be released on decoding threads, so use the (default)
+  // locking pool.
+  return std::allocate_shared<ZclMessage>(
+      boost::fast_pool_allocator<ZclMessage>(), std::move(incoming));
+}
+}  // namespace zcl
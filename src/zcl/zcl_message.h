@@ -0,0 +1,49 @@
+#ifndef _ZCL_ZCL_MESSAGE_H_
+#define _ZCL_ZCL_MESSAGE_H_
+#include <memory>
+#include <vector>
+#include "zcl/zcl.h"
+#include "znp/znp.h"
+
+namespace zcl {
+/**
+ * An incoming ZCL command, parsed once and then shared, read-only, by every
+ * stage handling it, possibly on other threads.
+ *
+ * The payload isn't copied out of the AF message, but refers into its data,
+ * which the message keeps alive.
+ */
+class ZclMessage {
+ public:
+  typedef std::vector<uint8_t>::const_iterator const_iterator;
+
+  /** Use Create() instead, it allocates from a pool. Throws if the ZCL header
+   * is truncated. */
+  explicit ZclMessage(std::shared_ptr<const znp::IncomingMsg> incoming);
+
+  static std::shared_ptr<const ZclMessage> Create(
+      std::shared_ptr<const znp::IncomingMsg> incoming);
+
+  const znp::IncomingMsg& incoming() const { return *incoming_; }
+  const ZclFrameHeader& header() const { return header_; }
+
+  znp::ShortAddress source_address() const { return incoming_->SrcAddr; }
+  uint8_t source_endpoint() const { return incoming_->SrcEndpoint; }
+  ZclClusterId cluster_id() const {
+    return (ZclClusterId)incoming_->ClusterId;
+  }
+  bool is_global_command() const {
+    return header_.frame_type == ZclFrameType::Global;
+  }
+
+  const_iterator payload_begin() const { return payload_begin_; }
+  const_iterator payload_end() const { return incoming_->Data.cend(); }
+  std::size_t payload_size() const { return payload_end() - payload_begin(); }
+
+ private:
+  std::shared_ptr<const znp::IncomingMsg> incoming_;
+  ZclFrameHeader header_;
+  const_iterator payload_begin_;
+};
+}  // namespace zcl
+#endif  // _ZCL_ZCL_MESSAGE_H_
@@ -0,0 +1,128 @@
+#include "znp/threaded_znp_port.h"
+#include "logging.h"
+
+namespace znp {
+ThreadedZnpPort::ThreadedZnpPort(boost::asio::io_service& io_service,
+                                 const std::string& port)
+    : io_service_(io_service),
+      port_work_(port_io_service_),
+      port_(port_io_service_, port) {
+  port_.on_frame_.connect(std::bind(&ThreadedZnpPort::OnFrame, this,
+                                    std::placeholders::_1,
+                                    std::placeholders::_2,
+                                    std::placeholders::_3));
+  port_.on_error_.connect(
+      std::bind(&ThreadedZnpPort::OnError, this, std::placeholders::_1));
+}
+
+ThreadedZnpPort::~ThreadedZnpPort() {
+  port_io_service_.stop();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+std::shared_ptr<ThreadedZnpPort> ThreadedZnpPort::Create(
+    boost::asio::io_service& io_service, const std::string& port) {
+  std::shared_ptr<ThreadedZnpPort> threaded_port(
+      new ThreadedZnpPort(io_service, port));
+  // Set before the thread starts, so it can read it without locking.
+  threaded_port->weak_this_ = threaded_port;
+  ThreadedZnpPort* raw_port = threaded_port.get();
+  threaded_port->thread_ =
+      std::thread([raw_port]() { raw_port->port_io_service_.run(); });
+  return threaded_port;
+}
+
+void ThreadedZnpPort::SendFrame(ZnpCommandType type, ZnpCommand command,
+                                const std::vector<uint8_t>& payload) {
+  if (payload.size() > 255) {
+    throw std::runtime_error(
+        "ZNP Command Payload size should not exceed 255 bytes");
+  }
+  Push(to_send_, Frame{type, command.Subsystem(), command.RawCommand(),
+                       payload});
+  if (!send_posted_.exchange(true)) {
+    // Not holding a reference, the port's thread must never drop the last one
+    // and end up joining itself. The destructor joins the thread, so this
+    // outlives the handler anyway.
+    port_io_service_.post([this]() { SendQueued(); });
+  }
+  on_sent_(type, command, payload);
+}
+
+void ThreadedZnpPort::Push(Channel& channel, Frame frame) {
+  if (!channel.overflowing && channel.ring.push(frame)) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(channel.overflow_mutex);
+  if (!channel.overflowing.exchange(true)) {
+    LOG("ThreadedZnpPort", warning)
+        << "Frame ring full, queueing until the other thread catches up";
+  }
+  channel.overflow.push_back(std::move(frame));
+}
+
+template <typename F>
+void ThreadedZnpPort::ConsumeAll(Channel& channel, F f) {
+  channel.ring.consume_all(f);
+  if (!channel.overflowing) {
+    return;
+  }
+  // Frames might have been pushed to the ring since, before it filled up.
+  // Nothing more goes into it until the overflow is taken, so these are all
+  // older than the overflow.
+  channel.ring.consume_all(f);
+  std::deque<Frame> overflow;
+  {
+    std::lock_guard<std::mutex> lock(channel.overflow_mutex);
+    overflow.swap(channel.overflow);
+    channel.overflowing = false;
+  }
+  for (const Frame& frame : overflow) {
+    f(frame);
+  }
+}
+
+void ThreadedZnpPort::OnFrame(ZnpCommandType type, ZnpCommand command,
+                              const std::vector<uint8_t>& payload) {
+  Push(received_, Frame{type, command.Subsystem(), command.RawCommand(),
+                        payload});
+  if (!receive_posted_.exchange(true)) {
+    std::weak_ptr<ThreadedZnpPort> weak_this(weak_this_);
+    io_service_.post([weak_this]() {
+      if (auto _this = weak_this.lock()) {
+        _this->DeliverReceived();
+      }
+    });
+  }
+}
+
+void ThreadedZnpPort::OnError(const boost::system::error_code& error) {
+  std::weak_ptr<ThreadedZnpPort> weak_this(weak_this_);
+  io_service_.post([weak_this, error]() {
+    if (auto _this = weak_this.lock()) {
+      _this->on_error_(error);
+    }
+  });
+}
+
+void ThreadedZnpPort::SendQueued() {
+  // Clear the flag before draining, frames pushed after this point get a
+  // drain of their own. The exchange pairs with the one in SendFrame(), so
+  // everything pushed before it is visible below.
+  send_posted_.exchange(false);
+  ConsumeAll(to_send_, [this](const Frame& frame) {
+    port_.SendFrame(frame.type, ZnpCommand(frame.subsystem, frame.command),
+                    frame.payload);
+  });
+}
+
+void ThreadedZnpPort::DeliverReceived() {
+  receive_posted_.exchange(false);
+  ConsumeAll(received_, [this](const Frame& frame) {
+    on_frame_(frame.type, ZnpCommand(frame.subsystem, frame.command),
+              frame.payload);
+  });
+}
+}  // namespace znp
@@ -0,0 +1,85 @@
+#ifndef _THREADED_ZNP_PORT_H_
+#define _THREADED_ZNP_PORT_H_
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "znp/znp_port.h"
+#include "znp/znp_raw_interface.h"
+
+namespace znp {
+/**
+ * ZnpPort running on an io_service & thread of its own, so a busy processing
+ * thread can't keep it from reading the UART before the dongle's buffer
+ * overflows.
+ *
+ * Frames are handed between the threads through lock-free single-producer,
+ * single-consumer rings. When a ring is full, frames spill into a locked queue
+ * instead, so neither thread ever waits for the other. SendFrame() must be
+ * called from, and all signals are emitted on, the processing io_service.
+ */
+class ThreadedZnpPort : public ZnpRawInterface {
+ public:
+  ~ThreadedZnpPort();
+
+  static std::shared_ptr<ThreadedZnpPort> Create(
+      boost::asio::io_service& io_service, const std::string& port);
+
+  void SendFrame(ZnpCommandType type, ZnpCommand command,
+                 const std::vector<uint8_t>& payload) override;
+
+ private:
+  struct Frame {
+    ZnpCommandType type;
+    ZnpSubsystem subsystem;
+    uint8_t command;
+    std::vector<uint8_t> payload;
+  };
+  // Frames waiting for the other thread. Both directions are bursty, but
+  // small: a handful of frames per request.
+  static const std::size_t kRingCapacity = 256;
+  typedef boost::lockfree::spsc_queue<
+      Frame, boost::lockfree::capacity<kRingCapacity>>
+      Ring;
+  struct Channel {
+    Ring ring;
+    // Frames that didn't fit in the ring, newer than any in it. While there
+    // are any, further frames are queued here too, to keep them in order.
+    std::mutex overflow_mutex;
+    std::deque<Frame> overflow;
+    std::atomic<bool> overflowing{false};
+  };
+
+  ThreadedZnpPort(boost::asio::io_service& io_service,
+                  const std::string& port);
+  // Called by the channel's producer.
+  static void Push(Channel& channel, Frame frame);
+  // Called by the channel's consumer.
+  template <typename F>
+  static void ConsumeAll(Channel& channel, F f);
+  // Called on the port's thread.
+  void OnFrame(ZnpCommandType type, ZnpCommand command,
+               const std::vector<uint8_t>& payload);
+  void OnError(const boost::system::error_code& error);
+  void SendQueued();
+  // Called on the processing thread.
+  void DeliverReceived();
+
+  boost::asio::io_service& io_service_;
+  boost::asio::io_service port_io_service_;
+  boost::asio::io_service::work port_work_;
+  ZnpPort port_;
+  std::weak_ptr<ThreadedZnpPort> weak_this_;
+  Channel received_;
+  Channel to_send_;
+  // Whether a drain of the ring is already posted to its consumer.
+  std::atomic<bool> receive_posted_{false};
+  std::atomic<bool> send_posted_{false};
+  std::thread thread_;
+};
+}  // namespace znp
+#endif  // _THREADED_ZNP_PORT_H_
@@ -1,5 +1,6 @@
 #include "znp/znp_api.h"
 #include <boost/asio/deadline_timer.hpp>
+#include <boost/pool/pool_alloc.hpp>
 #include <sstream>
 #include <stlab/concurrency/immediate_executor.hpp>
 #include <stlab/concurrency/utility.hpp>
@@ -24,17 +25,14 @@ ZnpApi::ZnpApi(boost::asio::io_service& io_service,
                         zdo_on_trustcenter_device_, false);
   AddSimpleEventHandler(ZnpCommandType::AREQ, ZdoCommand::PERMIT_JOIN_IND,
                         zdo_on_permit_join_, false);
-  // NOTE: INCOMING_MSG sometimes has 3 extra trailing bytes, so allow a partial
-  // decoding.
-  AddSimpleEventHandler(ZnpCommandType::AREQ, AfCommand::INCOMING_MSG,
-                        af_on_incoming_msg_, true);
+  AddIncomingMsgHandler();
 }
 
 stlab::future<ResetInfo> ZnpApi::SysReset(bool soft_reset) {
   auto package = stlab::package<ResetInfo(ResetInfo)>(
       stlab::immediate_executor, [](ResetInfo info) { return info; });
   sys_on_reset_.connect_extended(
-      [package](const boost::signals2::connection& connection, ResetInfo info) {
+      [package](const Connection& connection, ResetInfo info) {
         connection.disconnect();
         package.first(info);
       });
@@ -329,6 +327,34 @@ stlab::future<ShortAddress> ZnpApi::UtilAddrmgrExtAddrLookup(
       .then(&znp::Decode<ShortAddress>);
 }
 
+void ZnpApi::AddIncomingMsgHandler() {
+  const ZnpCommand incoming_msg(AfCommand::INCOMING_MSG);
+  handlers_.push_back([this, incoming_msg](const ZnpCommandType& type,
+                                           const ZnpCommand& command,
+                                           const std::vector<uint8_t>& data)
+                          -> FrameHandlerAction {
+    if (type != ZnpCommandType::AREQ || command != incoming_msg) {
+      return {false, false};
+    }
+    // Decoded straight into a pooled, shared message. Listeners keep a
+    // reference to it (or to its data) instead of copying it.
+    auto message = std::allocate_shared<IncomingMsg>(
+        boost::fast_pool_allocator<IncomingMsg>());
+    try {
+      // NOTE: INCOMING_MSG sometimes has 3 extra trailing bytes, so allow a
+      // partial decoding.
+      EncodeTarget::const_iterator current = data.begin();
+      EncodeHelper<IncomingMsg>::Decode(*message, current, data.end());
+    } catch (const std::exception& exc) {
+      LOG("ZnpApi", warning)
+          << "Exception while decoding event: " << exc.what();
+      return {false, false};
+    }
+    af_on_incoming_msg_(std::shared_ptr<const IncomingMsg>(std::move(message)));
+    return {true, false};
+  });
+}
+
 void ZnpApi::OnFrame(ZnpCommandType type, ZnpCommand command,
                      const std::vector<uint8_t>& payload) {
   for (auto it = handlers_.begin(); it != handlers_.end();) {
@@ -372,9 +398,8 @@ stlab::future<DeviceState> ZnpApi::WaitForState(
                   return state;
                 });
         this->zdo_on_state_change_.connect_extended(
-            [promise, end_states, allowed_states](
-                const boost::signals2::connection& connection,
-                DeviceState state) {
+            [promise, end_states, allowed_states](const Connection& connection,
+                                                  DeviceState state) {
               LOG("WaitForState", debug) << "Got on_state_change_";
               if (end_states.count(state) != 0) {
                 connection.disconnect();
@@ -2,7 +2,6 @@
 #define _ZNP_API_H_
 #include <bitset>
 #include <boost/asio/io_service.hpp>
-#include <boost/signals2/signal.hpp>
 #include <map>
 #include <queue>
 #include <set>
@@ -34,7 +33,7 @@ class ZnpApi {
   stlab::future<uint16_t> SysOsalNvLength(NvItemId Id);
 
   // SYS events
-  boost::signals2::signal<void(ResetInfo)> sys_on_reset_;
+  Signal<void(ResetInfo)> sys_on_reset_;
 
   // AF commands
   stlab::future<void> AfRegister(uint8_t endpoint, uint16_t profile_id,
@@ -47,7 +46,7 @@ class ZnpApi {
                                     uint8_t TransId, uint8_t Options,
                                     uint8_t Radius, std::vector<uint8_t> Data);
   // AF events
-  boost::signals2::signal<void(const IncomingMsg&)> af_on_incoming_msg_;
+  Signal<void(std::shared_ptr<const IncomingMsg>)> af_on_incoming_msg_;
 
   // ZDO commands
   stlab::future<ZdoIEEEAddressResponse> ZdoIEEEAddress(
@@ -86,13 +85,12 @@ class ZnpApi {
   stlab::future<uint8_t> ZdoExtCountAllGroups();
 
   // ZDO events
-  boost::signals2::signal<void(DeviceState)> zdo_on_state_change_;
-  boost::signals2::signal<void(ShortAddress, IEEEAddress, ShortAddress)>
+  Signal<void(DeviceState)> zdo_on_state_change_;
+  Signal<void(ShortAddress, IEEEAddress, ShortAddress)>
       zdo_on_trustcenter_device_;
-  boost::signals2::signal<void(ShortAddress, ShortAddress, IEEEAddress,
-                               uint8_t)>
+  Signal<void(ShortAddress, ShortAddress, IEEEAddress, uint8_t)>
       zdo_on_end_device_announce_;
-  boost::signals2::signal<void(uint8_t)> zdo_on_permit_join_;
+  Signal<void(uint8_t)> zdo_on_permit_join_;
 
   // SAPI commands
   stlab::future<std::vector<uint8_t>> SapiReadConfigurationRaw(
@@ -134,7 +132,7 @@ class ZnpApi {
  private:
   boost::asio::io_service& io_service_;
   std::shared_ptr<ZnpRawInterface> raw_;
-  boost::signals2::scoped_connection on_frame_connection_;
+  ScopedConnection on_frame_connection_;
 
   struct FrameHandlerAction {
     bool
@@ -147,6 +145,7 @@ class ZnpApi {
       FrameHandler;
   std::list<FrameHandler> handlers_;
 
+  void AddIncomingMsgHandler();
   void OnFrame(ZnpCommandType type, ZnpCommand command,
                const std::vector<uint8_t>& payload);
   stlab::future<std::vector<uint8_t>> WaitFor(
@@ -169,7 +168,7 @@ class ZnpApi {
 
   template <typename... Args>
   void AddSimpleEventHandler(ZnpCommandType type, ZnpCommand command,
-                             boost::signals2::signal<void(Args...)>& signal,
+                             Signal<void(Args...)>& signal,
                              bool allow_partial) {
     handlers_.push_back([&signal, type, command, allow_partial](
                             const ZnpCommandType& recvd_type,
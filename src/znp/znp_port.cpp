@@ -76,15 +76,13 @@ void ZnpPort::SendHandler(const boost::system::error_code& error,
 }
 
 void ZnpPort::StartReceive() {
-  auto target = std::make_shared<uint8_t>(0);
   boost::asio::async_read(
-      port_, boost::asio::buffer(target.get(), sizeof(uint8_t)),
-      std::bind(&ZnpPort::StartOfFrameHandler, this, target,
-                std::placeholders::_1, std::placeholders::_2));
+      port_, boost::asio::buffer(&receive_marker_, sizeof(uint8_t)),
+      std::bind(&ZnpPort::StartOfFrameHandler, this, std::placeholders::_1,
+                std::placeholders::_2));
 }
 
-void ZnpPort::StartOfFrameHandler(std::shared_ptr<uint8_t> marker,
-                                  const boost::system::error_code& error,
+void ZnpPort::StartOfFrameHandler(const boost::system::error_code& error,
                                   std::size_t bytes_transferred) {
   if (error) {
     LOG("ZnpPort", critical)
@@ -92,19 +90,18 @@ void ZnpPort::StartOfFrameHandler(std::shared_ptr<uint8_t> marker,
     on_error_(error);
     return;
   }
-  if (*marker != 0xFE) {
+  if (receive_marker_ != 0xFE) {
     LOG("ZnpPort", trace) << "No SOF marker, dropping data";
     StartReceive();
     return;
   }
   boost::asio::async_read(
-      port_, boost::asio::buffer(marker.get(), sizeof(uint8_t)),
-      std::bind(&ZnpPort::FrameLengthHandler, this, marker,
-                std::placeholders::_1, std::placeholders::_2));
+      port_, boost::asio::buffer(&receive_length_, sizeof(uint8_t)),
+      std::bind(&ZnpPort::FrameLengthHandler, this, std::placeholders::_1,
+                std::placeholders::_2));
 }
 
-void ZnpPort::FrameLengthHandler(std::shared_ptr<uint8_t> length,
-                                 const boost::system::error_code& error,
+void ZnpPort::FrameLengthHandler(const boost::system::error_code& error,
                                  std::size_t bytes_transferred) {
   if (error) {
     LOG("ZnpPort", critical)
@@ -112,16 +109,20 @@ void ZnpPort::FrameLengthHandler(std::shared_ptr<uint8_t> length,
     on_error_(error);
     return;
   }
-  auto buffer =
-      std::make_shared<std::vector<uint8_t>>(2 + ((std::size_t)*length) + 1);
+  // The same buffers are reused for every frame, the payload's capacity only
+  // grows up to the largest frame seen.
+  receive_payload_.resize(receive_length_);
+  std::array<boost::asio::mutable_buffer, 3> buffers = {
+      boost::asio::buffer(receive_command_),
+      boost::asio::buffer(receive_payload_),
+      boost::asio::buffer(&receive_fcs_, sizeof(uint8_t))};
   boost::asio::async_read(
-      port_, boost::asio::buffer(buffer->data(), buffer->size()),
-      std::bind(&ZnpPort::FrameHandler, this, buffer, std::placeholders::_1,
+      port_, buffers,
+      std::bind(&ZnpPort::FrameHandler, this, std::placeholders::_1,
                 std::placeholders::_2));
 }
 
-void ZnpPort::FrameHandler(std::shared_ptr<std::vector<uint8_t>> frame,
-                           const boost::system::error_code& error,
+void ZnpPort::FrameHandler(const boost::system::error_code& error,
                            std::size_t bytes_transferred) {
   if (error) {
     LOG("ZnpPort", critical)
@@ -129,20 +130,20 @@ void ZnpPort::FrameHandler(std::shared_ptr<std::vector<uint8_t>> frame,
     on_error_(error);
     return;
   }
+  // Slots get a reference to receive_payload_. That's fine, the next frame is
+  // only read into it after its length was read, in another handler.
   StartReceive();
-  uint8_t crc = 0;
-  crc ^= frame->size() - 3;  // Length byte
-  for (std::size_t i = 0; i < frame->size() - 1; i++) {
-    crc ^= (*frame)[i];
+  uint8_t crc = receive_length_ ^ receive_command_[0] ^ receive_command_[1];
+  for (uint8_t byte : receive_payload_) {
+    crc ^= byte;
   }
-  if (crc != (*frame)[frame->size() - 1]) {
+  if (crc != receive_fcs_) {
     LOG("ZnpPort", warning) << "CRC does not match, dropping frame";
     return;
   }
-  ZnpCommandType type = (ZnpCommandType)((*frame)[0] >> 4);
-  ZnpSubsystem subsystem = (ZnpSubsystem)((*frame)[0] & 0xF);
-  unsigned int command = (*frame)[1];
-  on_frame_(type, ZnpCommand(subsystem, command),
-            std::vector<uint8_t>(frame->begin() + 2, frame->end() - 1));
+  ZnpCommandType type = (ZnpCommandType)(receive_command_[0] >> 4);
+  ZnpSubsystem subsystem = (ZnpSubsystem)(receive_command_[0] & 0xF);
+  unsigned int command = receive_command_[1];
+  on_frame_(type, ZnpCommand(subsystem, command), receive_payload_);
 }
 }  // namespace znp
@@ -1,7 +1,7 @@
 #ifndef _ZNP_PORT_H_
 #define _ZNP_PORT_H_
+#include <array>
 #include <boost/asio.hpp>
-#include <boost/signals2/signal.hpp>
 #include <queue>
 #include <stlab/concurrency/future.hpp>
 #include <vector>
@@ -15,12 +15,6 @@ class ZnpPort : public ZnpRawInterface {
   void SendFrame(ZnpCommandType type, ZnpCommand command,
                  const std::vector<uint8_t>& payload) override;
 
-  boost::signals2::signal<void(ZnpCommandType, ZnpCommand,
-                               const std::vector<uint8_t>&)>
-      on_sent_;
-
-  boost::signals2::signal<void(const boost::system::error_code&)> on_error_;
-
  private:
   boost::asio::serial_port port_;
   bool send_in_progress_;
@@ -29,15 +23,19 @@ class ZnpPort : public ZnpRawInterface {
   void TrySend();
   void SendHandler(const boost::system::error_code& error,
                    std::size_t bytes_transferred);
+  // Only one frame is read at a time, into these.
+  uint8_t receive_marker_;
+  uint8_t receive_length_;
+  std::array<uint8_t, 2> receive_command_;
+  std::vector<uint8_t> receive_payload_;
+  uint8_t receive_fcs_;
+
   void StartReceive();
-  void StartOfFrameHandler(std::shared_ptr<uint8_t> marker,
-                           const boost::system::error_code& error,
+  void StartOfFrameHandler(const boost::system::error_code& error,
                            std::size_t bytes_transferred);
-  void FrameLengthHandler(std::shared_ptr<uint8_t> length,
-                          const boost::system::error_code& error,
+  void FrameLengthHandler(const boost::system::error_code& error,
                           std::size_t bytes_transferred);
-  void FrameHandler(std::shared_ptr<std::vector<uint8_t>> frame,
-                    const boost::system::error_code& error,
+  void FrameHandler(const boost::system::error_code& error,
                     std::size_t bytes_transferred);
 };
 }  // namespace znp
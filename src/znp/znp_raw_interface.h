@@ -1,7 +1,8 @@
 #ifndef _ZNP_RAW_INTERFACE_H_
 #define _ZNP_RAW_INTERFACE_H_
-#include <boost/signals2/signal.hpp>
+#include <boost/system/error_code.hpp>
 #include <vector>
+#include "signal_slot.h"
 #include "znp/znp.h"
 
 namespace znp {
@@ -13,9 +14,13 @@ class ZnpRawInterface {
   virtual void SendFrame(ZnpCommandType cmdtype, ZnpCommand command,
                          const std::vector<uint8_t>& payload) = 0;
 
-  boost::signals2::signal<void(ZnpCommandType, ZnpCommand,
-                               const std::vector<uint8_t>&)>
+  Signal<void(ZnpCommandType, ZnpCommand, const std::vector<uint8_t>&)>
       on_frame_;
+
+  Signal<void(ZnpCommandType, ZnpCommand, const std::vector<uint8_t>&)>
+      on_sent_;
+
+  Signal<void(const boost::system::error_code&)> on_error_;
 };
 }  // namespace znp
 #endif  // _ZNP_RAW_INTERFACE_H_
@@ -1,5 +1,6 @@
 #include <clusterdb/cluster_db.h>
 #include <dynamic_encoding/decoding.h>
+#include <dynamic_encoding/encoding.h>
 #include <zcl/encoding.h>
 #include <boost/optional/optional_io.hpp>
 #include <boost/test/unit_test.hpp>
@@ -51,6 +52,34 @@ global commands\n\
 		}\n\
 	}\n\
 }\n\
+0x0500 \"IAS Zone\"\n\
+{\n\
+	attributes\n\
+	{\n\
+		0x0002 \"ZoneStatus\"\n\
+		{\n\
+			type map16\n\
+			bits\n\
+			{\n\
+				0 \"Alarm1\"\n\
+				1 \"Alarm2\"\n\
+				3 \"Battery\"\n\
+			}\n\
+		}\n\
+	}\n\
+	commands serverToClient\n\
+	{\n\
+		0x00 \"Zone Status Change Notification\"\n\
+		{\n\
+			map16 \"Zone Status\"\n\
+			{\n\
+				0 \"Alarm1\"\n\
+				1 \"Alarm2\"\n\
+			}\n\
+			map8 \"Extended Status\"\n\
+		}\n\
+	}\n\
+}\n\
 ";
   std::stringstream stream(test_db);
   if (!db.ParseFromStream(stream, [](std::string x) { return x; })) {
@@ -88,6 +117,85 @@ BOOST_AUTO_TEST_CASE(AttributeById) {
   BOOST_TEST(attribute_found->name == "ApplicationVersion");
 }
 
+BOOST_AUTO_TEST_CASE(AttributeByClusterAndId) {
+  ClusterDb db;
+  LoadTestDb(db);
+
+  auto found = db.AttributeById((zcl::ZclClusterId)0x0006,
+                                (zcl::ZclAttributeId)0x0000);
+  BOOST_TEST(!!found);
+  BOOST_TEST(found->name == "OnOff");
+  BOOST_TEST(!db.AttributeById((zcl::ZclClusterId)0x0006,
+                               (zcl::ZclAttributeId)0x0001));
+  BOOST_TEST(!db.AttributeById((zcl::ZclClusterId)0x0001,
+                               (zcl::ZclAttributeId)0x0000));
+}
+
+BOOST_AUTO_TEST_CASE(CommandByIdAndName) {
+  ClusterDb db;
+  LoadTestDb(db);
+
+  auto found = db.CommandById((zcl::ZclClusterId)0x0006,
+                              (zcl::ZclCommandId)0x0A, true,
+                              zcl::ZclDirection::ServerToClient);
+  BOOST_TEST(!!found);
+  BOOST_TEST(found->name == "Report attributes");
+  BOOST_TEST(!db.CommandById((zcl::ZclClusterId)0x0006,
+                             (zcl::ZclCommandId)0x0A, false,
+                             zcl::ZclDirection::ServerToClient));
+
+  std::string topic("AqaraHub/00158D000152D7B2/1/out/On/Off");
+  auto by_name = db.ClusterByName(boost::string_view(topic).substr(32));
+  BOOST_TEST(!!by_name);
+  BOOST_TEST((unsigned int)by_name->id == 0x0006);
+}
+
+BOOST_AUTO_TEST_CASE(ImageRoundtrip) {
+  ClusterDb db;
+  LoadTestDb(db);
+
+  std::stringstream image;
+  db.WriteImage(image);
+  std::string image_data(image.str());
+
+  ClusterDb loaded;
+  BOOST_TEST(loaded.ParseFromImage((const std::uint8_t*)image_data.data(),
+                                   image_data.size(),
+                                   [](std::string x) { return x; }));
+  auto found = loaded.AttributeById((zcl::ZclClusterId)0x0006,
+                                    (zcl::ZclAttributeId)0x0000);
+  BOOST_TEST(!!found);
+  BOOST_TEST(found->name == "OnOff");
+  BOOST_TEST((found->datatype == zcl::DataType::_bool) == true);
+  auto command_found = loaded.GlobalCommandById((zcl::ZclCommandId)0x01);
+  BOOST_TEST(!!command_found);
+  BOOST_TEST((command_found->data ==
+              db.GlobalCommandById((zcl::ZclCommandId)0x01)->data) == true);
+  auto zone_status = loaded.AttributeById((zcl::ZclClusterId)0x0500,
+                                          (zcl::ZclAttributeId)0x0002);
+  BOOST_TEST(!!zone_status);
+  BOOST_TEST(zone_status->bit_names ==
+             std::vector<std::string>({"Alarm1", "Alarm2", "", "Battery"}));
+  auto notification = loaded.CommandById(
+      (zcl::ZclClusterId)0x0500, (zcl::ZclCommandId)0x00, false,
+      zcl::ZclDirection::ServerToClient);
+  BOOST_TEST(!!notification);
+  BOOST_TEST((notification->data ==
+              db.CommandById((zcl::ZclClusterId)0x0500,
+                             (zcl::ZclCommandId)0x00, false,
+                             zcl::ZclDirection::ServerToClient)
+                  ->data) == true);
+
+  std::stringstream reimage;
+  loaded.WriteImage(reimage);
+  BOOST_TEST(reimage.str() == image_data);
+
+  ClusterDb truncated;
+  BOOST_TEST(!truncated.ParseFromImage((const std::uint8_t*)image_data.data(),
+                                       image_data.size() - 1,
+                                       [](std::string x) { return x; }));
+}
+
 BOOST_AUTO_TEST_CASE(ReportAttributesArguments) {
   ClusterDb db;
   LoadTestDb(db);
@@ -139,3 +247,62 @@ BOOST_AUTO_TEST_CASE(DecodeOnOffAttribute) {
   BOOST_TEST(!!(parsed_until == data.cend()));
   BOOST_TEST(result == expected);
 }
+
+BOOST_AUTO_TEST_CASE(DecodeZoneStatusCompact) {
+  ClusterDb db;
+  LoadTestDb(db);
+
+  auto ias_zone_cluster = db.ClusterById((zcl::ZclClusterId)0x0500);
+  auto report_command =
+      db.GlobalCommandById((zcl::ZclCommandId)0x0A);  // Report attributes
+
+  // ZoneStatus, map16, Alarm1 | Battery | bit 12
+  std::vector<uint8_t> data{0x02, 0x00, 0x19, 0x09, 0x10};
+
+  tao::json::value expected(tao::json::value::object_t{
+      {"report",
+       tao::json::value::array_t{tao::json::value::object_t{
+           {"Attribute identifier", "ZoneStatus"},
+           {"data", tao::json::value::object_t{
+                        {"type", "map16"},
+                        {"value", tao::json::value::object_t{
+                                      {"Alarm1", true},
+                                      {"Alarm2", false},
+                                      {"Battery", true},
+                                      {"12", true}}}}}}}}});
+
+  auto parsed_until = data.cbegin();
+  dynamic_encoding::Context ctx{*ias_zone_cluster};
+  ctx.profile = dynamic_encoding::ValueProfile::Compact;
+  tao::json::value result = dynamic_encoding::Decode(ctx, report_command->data,
+                                                     parsed_until, data.cend());
+  BOOST_TEST(!!(parsed_until == data.cend()));
+  BOOST_TEST(result == expected);
+
+  std::vector<uint8_t> reencoded;
+  dynamic_encoding::Encode(ctx, report_command->data, result, reencoded);
+  BOOST_TEST(reencoded == data);
+}
+
+BOOST_AUTO_TEST_CASE(DecodeZoneStatusChangeCompact) {
+  ClusterDb db;
+  LoadTestDb(db);
+
+  auto ias_zone_cluster = db.ClusterById((zcl::ZclClusterId)0x0500);
+  auto notification = db.CommandById((zcl::ZclClusterId)0x0500,
+                                     (zcl::ZclCommandId)0x00, false,
+                                     zcl::ZclDirection::ServerToClient);
+  std::vector<uint8_t> data{0x02, 0x00, 0x00};
+
+  auto parsed_until = data.cbegin();
+  dynamic_encoding::Context ctx{*ias_zone_cluster};
+  ctx.profile = dynamic_encoding::ValueProfile::Compact;
+  tao::json::value result = dynamic_encoding::Decode(ctx, notification->data,
+                                                     parsed_until, data.cend());
+  BOOST_TEST(!!(parsed_until == data.cend()));
+  BOOST_TEST(result == tao::json::value(tao::json::value::object_t{
+                           {"Zone Status", tao::json::value::object_t{
+                                               {"Alarm1", false},
+                                               {"Alarm2", true}}},
+                           {"Extended Status", 0}}));
+}
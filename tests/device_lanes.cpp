@@ -0,0 +1,47 @@
+#include <device_lanes.h>
+#include <boost/test/unit_test.hpp>
+#include <map>
+#include <stlab/concurrency/default_executor.hpp>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(DeviceLanesDeliverInOrderPerDevice) {
+  boost::asio::io_service io_service;
+  boost::asio::io_service::work work(io_service);
+  DeviceLanes lanes(io_service, stlab::default_executor);
+  const int kDevices = 4;
+  const int kMessages = 200;
+  const std::thread::id io_thread = std::this_thread::get_id();
+  std::map<znp::IEEEAddress, std::vector<int>> delivered;
+  int remaining = kDevices * kMessages;
+  bool delivered_on_io_thread = true;
+  for (int i = 0; i < kMessages; i++) {
+    for (znp::IEEEAddress device = 1; device <= kDevices; device++) {
+      lanes.Post(device,
+                 [i]() {
+                   // Make later work finish sooner, if it could overtake.
+                   std::this_thread::sleep_for(
+                       std::chrono::microseconds((kMessages - i) % 7));
+                   return i;
+                 },
+                 [&, device](int value) {
+                   delivered_on_io_thread &=
+                       std::this_thread::get_id() == io_thread;
+                   delivered[device].push_back(value);
+                   if (--remaining == 0) {
+                     io_service.stop();
+                   }
+                 });
+    }
+  }
+  io_service.run();
+  BOOST_TEST(lanes.size() == kDevices);
+  BOOST_TEST(delivered_on_io_thread);
+  for (znp::IEEEAddress device = 1; device <= kDevices; device++) {
+    std::vector<int> expected;
+    for (int i = 0; i < kMessages; i++) {
+      expected.push_back(i);
+    }
+    BOOST_TEST(delivered[device] == expected, boost::test_tools::per_element());
+  }
+}
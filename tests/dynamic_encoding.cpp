@@ -14,10 +14,10 @@ std::vector<std::tuple<std::vector<uint8_t>, dynamic_encoding::AnyType,
         {{0x10, 0x01},
          dynamic_encoding::VariantType{},
          tao::json::value::object_t{{"type", "bool"}, {"value", true}}},
-//        {{0x23},
-//         zcl::DataType::map8,
-//         std::vector<bool>{true, true, false, false, false, true, false,
-//                           false}},
+        {{0x23},
+         zcl::DataType::map8,
+         tao::json::value::array_t{true, true, false, false, false, true,
+                                   false, false}},
         {{0x78, 0x56, 0x34, 0x12}, zcl::DataType::int32, 0x12345678},
         {{0x88, 0xA9, 0xCB, 0xED}, zcl::DataType::int32, -0x12345678},
         {{0x78, 0x56, 0x34, 0x12}, zcl::DataType::uint32, 0x12345678},
@@ -64,7 +64,27 @@ std::vector<std::tuple<std::vector<uint8_t>, dynamic_encoding::AnyType,
          dynamic_encoding::ErrorOrType{zcl::DataType::_bool},
          tao::json::value::object_t{{"error", (unsigned int)0x12}}},
     };
-}
+
+std::vector<std::tuple<std::vector<uint8_t>, dynamic_encoding::AnyType,
+                       tao::json::value>>
+    compact_examples{
+        {{0x23}, zcl::DataType::map8, 0x23},
+        {{0x01, 0x02, 0x03}, zcl::DataType::data24, "010203"},
+        {{0x02, 0xAB, 0xCD}, zcl::DataType::octstr, "ABCD"},
+        {{0x00, 0x00}, zcl::DataType::octstr16, ""},
+        {{0xFF}, zcl::DataType::octstr, tao::json::null},
+        {{0x09, 0x10},
+         dynamic_encoding::BitmapType{zcl::DataType::map16,
+                                      {"Alarm1", "Alarm2", "", "Battery"}},
+         tao::json::value::object_t{{"Alarm1", true},
+                                    {"Alarm2", false},
+                                    {"Battery", true},
+                                    {"12", true}}},
+        {{0x19, 0x00, 0x80},
+         dynamic_encoding::VariantType{},
+         tao::json::value::object_t{{"type", "map16"}, {"value", 0x8000}}},
+    };
+}  // namespace
 
 BOOST_AUTO_TEST_CASE(DecodeExamples) {
   dynamic_encoding::Context ctx;
@@ -142,3 +162,65 @@ BOOST_AUTO_TEST_CASE(EncodeNoPayloadNull) {
                            encoded_data);
   BOOST_TEST(encoded_data.size() == 0);
 }
+
+BOOST_AUTO_TEST_CASE(CompactExamples) {
+  dynamic_encoding::Context ctx;
+  ctx.profile = dynamic_encoding::ValueProfile::Compact;
+  for (const auto& example : compact_examples) {
+    const auto& encoded_data = std::get<0>(example);
+    const auto& type = std::get<1>(example);
+    const auto& json = std::get<2>(example);
+    auto parsed_until = encoded_data.cbegin();
+    auto rejson =
+        dynamic_encoding::Decode(ctx, type, parsed_until, encoded_data.cend());
+    BOOST_TEST((parsed_until == encoded_data.cend()) == true);
+    BOOST_TEST(rejson == json);
+    std::vector<uint8_t> reencoded;
+    dynamic_encoding::Encode(ctx, type, json, reencoded);
+    BOOST_TEST(reencoded == encoded_data);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(EncodeBitmapForms) {
+  dynamic_encoding::Context ctx;
+  const dynamic_encoding::BitmapType type{zcl::DataType::map16,
+                                          {"Alarm1", "Alarm2"}};
+  std::vector<uint8_t> expected{0x02, 0x01};
+  for (const tao::json::value& json :
+       {tao::json::value(0x0102),
+        tao::json::value(tao::json::value::object_t{{"Alarm2", true},
+                                                    {"Alarm1", false},
+                                                    {"8", true}}),
+        tao::json::value(tao::json::value::array_t{
+            false, true, false, false, false, false, false, false, true,
+            false, false, false, false, false, false, false})}) {
+    std::vector<uint8_t> encoded;
+    dynamic_encoding::Encode(ctx, type, json, encoded);
+    BOOST_TEST(encoded == expected);
+  }
+
+  std::vector<uint8_t> encoded;
+  BOOST_CHECK_THROW(
+      dynamic_encoding::Encode(
+          ctx, type, tao::json::value::object_t{{"Tamper", true}}, encoded),
+      std::exception);
+  BOOST_CHECK_THROW(
+      dynamic_encoding::Encode(ctx, type,
+                               tao::json::value::object_t{{"16", true}},
+                               encoded),
+      std::exception);
+  BOOST_CHECK_THROW(dynamic_encoding::Encode(ctx, zcl::DataType::data16,
+                                             "ABCDEF", encoded),
+                    std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeBitmapHighBits) {
+  dynamic_encoding::Context ctx;
+  tao::json::value::array_t bits(64, false);
+  bits[40] = true;
+  bits[63] = true;
+  std::vector<uint8_t> encoded;
+  dynamic_encoding::Encode(ctx, zcl::DataType::map64, bits, encoded);
+  BOOST_TEST(encoded == std::vector<uint8_t>(
+                            {0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x80}));
+}
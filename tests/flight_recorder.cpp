@@ -0,0 +1,88 @@
+#include <flight_recorder.h>
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(FlightRecorderKeepsMostRecent) {
+  FlightRecorder recorder(5);
+  BOOST_TEST(recorder.Snapshot().empty());
+  for (std::uint8_t i = 0; i < 20; i++) {
+    const std::vector<std::uint8_t> payload(i, i);
+    recorder.Add(FlightRecorder::Kind::FrameIn, 0x4581, payload.data(),
+                 payload.size());
+  }
+  // Rounded up to 8 entries.
+  std::vector<FlightRecorder::Entry> entries = recorder.Snapshot();
+  BOOST_TEST(entries.size() == 8u);
+  for (std::size_t i = 0; i < entries.size(); i++) {
+    BOOST_TEST(entries[i].size == 12 + i);
+    BOOST_TEST(entries[i].data[0] == 12 + i);
+    BOOST_TEST(entries[i].code == 0x4581);
+    BOOST_TEST((entries[i].kind == FlightRecorder::Kind::FrameIn));
+  }
+  BOOST_TEST(entries.front().timestamp_us <= entries.back().timestamp_us);
+}
+
+BOOST_AUTO_TEST_CASE(FlightRecorderCutsOffData) {
+  FlightRecorder recorder(4);
+  const std::string topic = "AqaraHub/00158d0001234567/1/out/OnOff/Toggle";
+  recorder.Add(FlightRecorder::Kind::MqttIn, 0, topic, "{\"on\":true}");
+  const std::vector<std::uint8_t> payload(100, 0x42);
+  recorder.Add(FlightRecorder::Kind::DecodeError, 0x0006, payload.data(),
+               payload.size());
+  std::vector<FlightRecorder::Entry> entries = recorder.Snapshot();
+  BOOST_TEST_REQUIRE(entries.size() == 2u);
+  BOOST_TEST(entries[0].size == topic.size() + 1 + 11);
+  BOOST_TEST(std::string((const char*)entries[0].data, topic.size()) == topic);
+  BOOST_TEST(entries[0].data[topic.size()] == 0);
+  BOOST_TEST(std::string((const char*)entries[0].data + topic.size() + 1,
+                         FlightRecorder::kMaxData - topic.size() - 1) ==
+             "{\"o");
+  BOOST_TEST(entries[1].size == 100u);
+  BOOST_TEST(entries[1].data[FlightRecorder::kMaxData - 1] == 0x42);
+}
+
+BOOST_AUTO_TEST_CASE(FlightRecorderDumpRoundTrip) {
+  FlightRecorder recorder(16);
+  const std::vector<std::uint8_t> payload{1, 2, 3};
+  recorder.Add(FlightRecorder::Kind::FrameOut, 0x2401, payload.data(),
+               payload.size());
+  recorder.Add(FlightRecorder::Kind::MqttConnected, 0, nullptr, 0);
+  std::stringstream dump;
+  recorder.Write(dump);
+  std::vector<FlightRecorder::Entry> entries = FlightRecorder::Read(dump);
+  BOOST_TEST_REQUIRE(entries.size() == 2u);
+  BOOST_TEST((entries[0].kind == FlightRecorder::Kind::FrameOut));
+  BOOST_TEST(entries[0].code == 0x2401);
+  BOOST_TEST(entries[0].data[2] == 3);
+  BOOST_TEST((entries[1].kind == FlightRecorder::Kind::MqttConnected));
+
+  std::stringstream truncated(dump.str().substr(0, dump.str().size() - 1));
+  BOOST_CHECK_THROW(FlightRecorder::Read(truncated), std::runtime_error);
+  std::stringstream garbage("not a dump at all");
+  BOOST_CHECK_THROW(FlightRecorder::Read(garbage), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(FlightRecorderConcurrentWriters) {
+  FlightRecorder recorder(1024);
+  std::vector<std::thread> threads;
+  for (std::uint16_t t = 0; t < 4; t++) {
+    threads.emplace_back([&recorder, t]() {
+      for (std::uint8_t i = 0; i < 200; i++) {
+        recorder.Add(FlightRecorder::Kind::FrameIn, t, &i, 1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::vector<FlightRecorder::Entry> entries = recorder.Snapshot();
+  BOOST_TEST(entries.size() == 800u);
+  // Each writer's entries stay in order.
+  std::vector<int> last(4, -1);
+  for (const auto& entry : entries) {
+    BOOST_TEST(entry.data[0] > last[entry.code]);
+    last[entry.code] = entry.data[0];
+  }
+}
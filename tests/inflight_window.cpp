@@ -0,0 +1,71 @@
+#include <inflight_window.h>
+#include <boost/test/unit_test.hpp>
+
+namespace {
+InflightWindow::Entry MakeEntry(std::string message) {
+  return InflightWindow::Entry{
+      PublishQueue::Item{"topic", message, 1, false, nullptr}, false};
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(InflightWindowCapacity) {
+  InflightWindow window(2);
+  InflightWindow::Clock::time_point now;
+  BOOST_TEST(!window.full());
+  window.Add(1000, MakeEntry("1"), now);
+  window.Add(7, MakeEntry("2"), now);
+  BOOST_TEST(window.full());
+  BOOST_TEST(window.size() == 2);
+
+  BOOST_TEST(!window.Acknowledge(8, now));
+  auto entry = window.Acknowledge(1000, now + std::chrono::milliseconds(30));
+  BOOST_TEST(!!entry);
+  BOOST_TEST(entry->item.message == "1");
+  BOOST_TEST(!window.full());
+  // Acknowledged twice
+  BOOST_TEST(!window.Acknowledge(1000, now));
+
+  window.Add(1000, MakeEntry("3"), now);
+  window.Acknowledge(1000, now + std::chrono::milliseconds(10));
+  auto stats = window.stats();
+  BOOST_TEST(stats.depth == 1);
+  BOOST_TEST(stats.max_depth == 2);
+  BOOST_TEST(stats.acknowledged == 2);
+  BOOST_TEST((stats.total_latency == std::chrono::milliseconds(40)));
+  BOOST_TEST((stats.max_latency == std::chrono::milliseconds(30)));
+}
+
+BOOST_AUTO_TEST_CASE(InflightWindowTakeAll) {
+  InflightWindow window(4);
+  InflightWindow::Clock::time_point now;
+  window.Add(3, MakeEntry("1"), now);
+  window.Add(2, MakeEntry("2"), now + std::chrono::milliseconds(1));
+  window.Add(1, MakeEntry("3"), now + std::chrono::milliseconds(2));
+  // Reuses the first slot for a newer message.
+  window.Remove(3);
+  window.Add(4, MakeEntry("4"), now + std::chrono::milliseconds(3));
+
+  auto entries = window.TakeAll();
+  BOOST_TEST(entries.size() == 3);
+  BOOST_TEST(entries[0].item.message == "2");
+  BOOST_TEST(entries[1].item.message == "3");
+  BOOST_TEST(entries[2].item.message == "4");
+  BOOST_TEST(window.size() == 0);
+  BOOST_TEST(window.stats().acknowledged == 0);
+}
+
+BOOST_AUTO_TEST_CASE(InflightWindowTakeAllSentAtOnce) {
+  InflightWindow window(4);
+  InflightWindow::Clock::time_point now;
+  window.Add(1, MakeEntry("1"), now);
+  window.Add(2, MakeEntry("2"), now);
+  window.Remove(1);
+  window.Add(3, MakeEntry("3"), now);
+  window.Add(4, MakeEntry("4"), now);
+
+  auto entries = window.TakeAll();
+  BOOST_TEST(entries.size() == 3);
+  BOOST_TEST(entries[0].item.message == "2");
+  BOOST_TEST(entries[1].item.message == "3");
+  BOOST_TEST(entries[2].item.message == "4");
+}
@@ -0,0 +1,51 @@
+#include <last_value_cache.h>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(LastValueCacheDisabledClass) {
+  LastValueCache cache;
+  cache.Enable(TopicClass::Telemetry, std::chrono::seconds(0));
+  BOOST_TEST(cache.enabled(TopicClass::Telemetry));
+  BOOST_TEST(!cache.enabled(TopicClass::LinkQuality));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::LinkQuality, "a", "1"));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::LinkQuality, "a", "1"));
+  BOOST_TEST(cache.published() == 2);
+  BOOST_TEST(cache.suppressed() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(LastValueCacheSuppressesRepeats) {
+  LastValueCache cache;
+  cache.Enable(TopicClass::Telemetry, std::chrono::seconds(0));
+  auto now = LastValueCache::Clock::now();
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "a", "1", now));
+  BOOST_TEST(!cache.ShouldPublish(TopicClass::Telemetry, "a", "1", now));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "b", "1", now));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "a", "2", now));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "a", "1", now));
+  // Without a refresh interval, repeats are suppressed forever.
+  BOOST_TEST(!cache.ShouldPublish(TopicClass::Telemetry, "a", "1",
+                                  now + std::chrono::hours(24)));
+  BOOST_TEST(cache.published() == 4);
+  BOOST_TEST(cache.suppressed() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(LastValueCacheRefreshInterval) {
+  LastValueCache cache;
+  cache.Enable(TopicClass::Telemetry, std::chrono::seconds(60));
+  auto now = LastValueCache::Clock::now();
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "a", "1", now));
+  BOOST_TEST(!cache.ShouldPublish(TopicClass::Telemetry, "a", "1",
+                                  now + std::chrono::seconds(59)));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "a", "1",
+                                 now + std::chrono::seconds(60)));
+  // The refresh restarted the interval.
+  BOOST_TEST(!cache.ShouldPublish(TopicClass::Telemetry, "a", "1",
+                                  now + std::chrono::seconds(61)));
+}
+
+BOOST_AUTO_TEST_CASE(LastValueCacheForget) {
+  LastValueCache cache;
+  cache.Enable(TopicClass::Telemetry, std::chrono::seconds(0));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "a", "1"));
+  cache.Forget("a");
+  BOOST_TEST(cache.ShouldPublish(TopicClass::Telemetry, "a", "1"));
+}
@@ -0,0 +1,54 @@
+#include <link_quality.h>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(LinkQualityFirstSample) {
+  LinkQualityAggregator aggregator(0.5, 10);
+  BOOST_TEST(aggregator.Pending().empty());
+  BOOST_TEST(aggregator.Add(0x1234, 100));
+  BOOST_TEST(aggregator.Pending() == std::vector<znp::ShortAddress>{0x1234});
+  auto stats = aggregator.Take(0x1234);
+  BOOST_TEST(!!stats);
+  BOOST_TEST(stats->min == 100);
+  BOOST_TEST(stats->max == 100);
+  BOOST_TEST(stats->samples == 1);
+  BOOST_TEST(stats->average == 100);
+  BOOST_TEST(aggregator.Pending().empty());
+  BOOST_TEST(!aggregator.Take(0x1234));
+}
+
+BOOST_AUTO_TEST_CASE(LinkQualityWindow) {
+  LinkQualityAggregator aggregator(0.5, 100);
+  aggregator.Add(0x1234, 100);
+  aggregator.Take(0x1234);
+  BOOST_TEST(!aggregator.Add(0x1234, 80));
+  BOOST_TEST(!aggregator.Add(0x1234, 120));
+  auto stats = aggregator.Take(0x1234);
+  BOOST_TEST(!!stats);
+  BOOST_TEST(stats->min == 80);
+  BOOST_TEST(stats->max == 120);
+  BOOST_TEST(stats->samples == 2);
+  // 100 -> 90 -> 105
+  BOOST_TEST(stats->average == 105);
+
+  // New window, the average carries over.
+  aggregator.Add(0x1234, 105);
+  stats = aggregator.Take(0x1234);
+  BOOST_TEST(stats->min == 105);
+  BOOST_TEST(stats->max == 105);
+  BOOST_TEST(stats->samples == 1);
+  BOOST_TEST(stats->average == 105);
+}
+
+BOOST_AUTO_TEST_CASE(LinkQualityBand) {
+  LinkQualityAggregator aggregator(0.5, 10);
+  BOOST_TEST(aggregator.Add(0x1234, 100));
+  // Not taken yet, so still outside the band.
+  BOOST_TEST(aggregator.Add(0x1234, 100));
+  aggregator.Take(0x1234);
+  // 100 -> 90, just within the band
+  BOOST_TEST(!aggregator.Add(0x1234, 80));
+  // 90 -> 85
+  BOOST_TEST(aggregator.Add(0x1234, 80));
+  BOOST_TEST(aggregator.Take(0x1234)->average == 85);
+  BOOST_TEST(!aggregator.Add(0x1234, 85));
+}
@@ -0,0 +1,46 @@
+#include <logging.h>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(LogLevelsPerChannel) {
+  BOOST_TEST(SetLogLevels("warning,FRAME=debug,Main=error"));
+  BOOST_TEST(LogEnabled("FRAME", debug));
+  BOOST_TEST(!LogEnabled("FRAME", trace));
+  BOOST_TEST(!LogEnabled("Main", warning));
+  BOOST_TEST(LogEnabled("Main", error));
+  BOOST_TEST(!LogEnabled("OnZclCommand", info));
+  BOOST_TEST(LogEnabled("OnZclCommand", warning));
+  BOOST_TEST(LogEnabled(std::string("OnZclCommand"), critical));
+
+  // Without a default level, the default stays info.
+  BOOST_TEST(SetLogLevels("FRAME=trace"));
+  BOOST_TEST(LogEnabled("FRAME", trace));
+  BOOST_TEST(LogEnabled("Main", info));
+  BOOST_TEST(!LogEnabled("Main", debug));
+  BOOST_TEST(SetLogLevels("info"));
+}
+
+BOOST_AUTO_TEST_CASE(LogLevelsRejectMalformedSpecs) {
+  BOOST_TEST(SetLogLevels("error"));
+  BOOST_TEST(!SetLogLevels(""));
+  BOOST_TEST(!SetLogLevels("verbose"));
+  BOOST_TEST(!SetLogLevels("FRAME=debug,info"));
+  BOOST_TEST(!SetLogLevels("=debug"));
+  BOOST_TEST(!SetLogLevels("info,FRAME=loud"));
+  BOOST_TEST(!SetLogLevels("info,"));
+  // Nothing changed.
+  BOOST_TEST(!LogEnabled("FRAME", warning));
+  BOOST_TEST(LogEnabled("FRAME", error));
+  BOOST_TEST(SetLogLevels("info"));
+}
+
+BOOST_AUTO_TEST_CASE(LogSkipsArgumentsWhenFiltered) {
+  BOOST_TEST(SetLogLevels("info,Quiet=error"));
+  int evaluated = 0;
+  auto count = [&evaluated]() { return ++evaluated; };
+  LOG("Quiet", warning) << count();
+  LOG("Quiet", trace) << count();
+  BOOST_TEST(evaluated == 0);
+  LOG("Loud", warning) << count();
+  BOOST_TEST(evaluated == 1);
+  BOOST_TEST(SetLogLevels("info"));
+}
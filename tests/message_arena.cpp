@@ -0,0 +1,62 @@
+#include <message_arena.h>
+#include <boost/test/unit_test.hpp>
+#include <cstdint>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(MessageArenaAlignsAllocations) {
+  MessageArena arena;
+  arena.Allocate(1, 1);
+  void* p = arena.Allocate(sizeof(std::uint64_t), alignof(std::uint64_t));
+  BOOST_TEST(reinterpret_cast<std::uintptr_t>(p) % alignof(std::uint64_t) ==
+             0u);
+  BOOST_TEST(arena.used() == 1 + sizeof(std::uint64_t));
+}
+
+BOOST_AUTO_TEST_CASE(MessageArenaReusesBlocks) {
+  MessageArena arena;
+  void* first = arena.Allocate(100, 1);
+  for (int i = 0; i < 100; i++) {
+    arena.Allocate(100, 1);
+  }
+  const std::size_t blocks = arena.blocks();
+  BOOST_TEST(blocks > 1u);
+  // Large allocations don't take up the normal blocks.
+  arena.Allocate(MessageArena::kBlockSize * 2, 1);
+  BOOST_TEST(arena.blocks() == blocks);
+
+  arena.Reset();
+  BOOST_TEST(arena.used() == 0u);
+  BOOST_TEST(arena.Allocate(100, 1) == first);
+  for (int i = 0; i < 100; i++) {
+    arena.Allocate(100, 1);
+  }
+  BOOST_TEST(arena.blocks() == blocks);
+}
+
+BOOST_AUTO_TEST_CASE(MessageArenaScopeResetsWhenOutermostEnds) {
+  MessageArena& arena = MessageArena::ThisThread();
+  {
+    MessageArena::Scope outer;
+    BOOST_TEST(&outer.arena() == &arena);
+    ArenaString topic("AqaraHub/00158d0001234567/1/out/OnOff/ReportAttributes",
+                      ArenaAllocator<char>(outer.arena()));
+    {
+      MessageArena::Scope inner;
+      topic += "/OnOff";
+    }
+    BOOST_TEST(arena.used() > 0u);
+    BOOST_TEST(topic ==
+               "AqaraHub/00158d0001234567/1/out/OnOff/ReportAttributes/OnOff");
+  }
+  BOOST_TEST(arena.used() == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(MessageArenaAllocatorInContainers) {
+  MessageArena arena;
+  std::vector<int, ArenaAllocator<int>> values{ArenaAllocator<int>(arena)};
+  for (int i = 0; i < 1000; i++) {
+    values.push_back(i);
+  }
+  BOOST_TEST(values[999] == 999);
+  BOOST_TEST(arena.used() >= 1000 * sizeof(int));
+}
@@ -0,0 +1,115 @@
+#include <mqtt_router.h>
+#include <boost/test/unit_test.hpp>
+#include <stdexcept>
+
+BOOST_AUTO_TEST_CASE(MqttRouterLiteral) {
+  MqttRouter router;
+  int called = 0;
+  router.Add("write/permitjoin",
+             [&called](const MqttRouter::Match& match,
+                       const std::string& message) {
+               BOOST_TEST(match.size() == 0);
+               BOOST_TEST(message == "60");
+               called++;
+             });
+  BOOST_TEST(router.Dispatch("write/permitjoin", "60"));
+  BOOST_TEST(called == 1);
+  BOOST_TEST(!router.Dispatch("write/permitjoin/", "60"));
+  BOOST_TEST(!router.Dispatch("write", "60"));
+  BOOST_TEST(!router.Dispatch("write/permitjoin/more", "60"));
+  BOOST_TEST(!router.Dispatch("", "60"));
+  BOOST_TEST(called == 1);
+}
+
+BOOST_AUTO_TEST_CASE(MqttRouterTypedCaptures) {
+  MqttRouter router;
+  std::uint64_t address = 0;
+  std::uint64_t endpoint = 0;
+  std::string cluster, command;
+  router.Add("{hex}/{uint}/out/{name}/{name}",
+             [&](const MqttRouter::Match& match, const std::string& message) {
+               BOOST_TEST(match.size() == 4);
+               address = match.Number(0);
+               endpoint = match.Number(1);
+               cluster = match.Text(2).to_string();
+               command = match.Text(3).to_string();
+             });
+  BOOST_TEST(router.Dispatch("00158d000152D7B2/1/out/OnOff/Toggle", ""));
+  BOOST_TEST(address == 0x00158D000152D7B2);
+  BOOST_TEST(endpoint == 1);
+  BOOST_TEST(cluster == "OnOff");
+  BOOST_TEST(command == "Toggle");
+}
+
+BOOST_AUTO_TEST_CASE(MqttRouterRejectsBadCaptures) {
+  MqttRouter router;
+  int called = 0;
+  router.Add("{hex}/{uint}/out/{name}",
+             [&called](const MqttRouter::Match&, const std::string&) {
+               called++;
+             });
+  BOOST_TEST(router.Dispatch("ABC/12/out/Basic", ""));
+  BOOST_TEST(!router.Dispatch("XYZ/12/out/Basic", ""));
+  BOOST_TEST(!router.Dispatch("ABC/1a/out/Basic", ""));
+  BOOST_TEST(!router.Dispatch("00158D000152D7B2A/12/out/Basic", ""));
+  BOOST_TEST(!router.Dispatch("ABC/99999999999999999999/out/Basic", ""));
+  BOOST_TEST(!router.Dispatch("ABC//out/Basic", ""));
+  BOOST_TEST(called == 1);
+}
+
+BOOST_AUTO_TEST_CASE(MqttRouterPrecedence) {
+  MqttRouter router;
+  std::string called;
+  router.Add("write/directjoin/{hex}",
+             [&called](const MqttRouter::Match&, const std::string&) {
+               called = "hex";
+             });
+  router.Add("write/directjoin/{name}",
+             [&called](const MqttRouter::Match&, const std::string&) {
+               called = "name";
+             });
+  router.Add("write/directjoin/all",
+             [&called](const MqttRouter::Match&, const std::string&) {
+               called = "literal";
+             });
+  BOOST_TEST(router.Dispatch("write/directjoin/ABCD", ""));
+  BOOST_TEST(called == "hex");
+  BOOST_TEST(router.Dispatch("write/directjoin/all", ""));
+  BOOST_TEST(called == "literal");
+  BOOST_TEST(router.Dispatch("write/directjoin/none", ""));
+  BOOST_TEST(called == "name");
+}
+
+BOOST_AUTO_TEST_CASE(MqttRouterBacktracks) {
+  // "10" matches both {hex} & {uint} at the first level, only the {uint}
+  // branch continues with "out".
+  MqttRouter router;
+  std::string called;
+  router.Add("{hex}/in", [&called](const MqttRouter::Match&,
+                                   const std::string&) { called = "in"; });
+  router.Add("{uint}/out", [&called](const MqttRouter::Match& match,
+                                     const std::string&) {
+    BOOST_TEST(match.size() == 1);
+    BOOST_TEST(match.Number(0) == 10);
+    called = "out";
+  });
+  BOOST_TEST(router.Dispatch("10/out", ""));
+  BOOST_TEST(called == "out");
+  BOOST_TEST(router.Dispatch("10/in", ""));
+  BOOST_TEST(called == "in");
+}
+
+BOOST_AUTO_TEST_CASE(MqttRouterInvalidPatterns) {
+  MqttRouter router;
+  auto handler = [](const MqttRouter::Match&, const std::string&) {};
+  router.Add("write/permitjoin", handler);
+  BOOST_CHECK_THROW(router.Add("write/permitjoin", handler),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(router.Add("write//permitjoin", handler),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(router.Add("write/", handler), std::invalid_argument);
+  BOOST_CHECK_THROW(router.Add("write/{float}", handler),
+                    std::invalid_argument);
+  BOOST_CHECK_THROW(router.Add("{name}/{name}/{name}/{name}/{name}", handler),
+                    std::invalid_argument);
+}
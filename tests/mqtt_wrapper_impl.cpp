@@ -0,0 +1,187 @@
+#include <mqtt_wrapper_impl.h>
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "last_value_cache.h"
+
+namespace {
+// Stands in for the mqtt_cpp client, recording what gets sent, so the test can
+// play the server by calling the handlers.
+struct FakeClient {
+  typedef std::function<void(const boost::system::error_code&)> Callback;
+  struct Sent {
+    std::uint16_t packet_id;
+    std::string topic_name;
+    std::string message;
+    std::uint8_t qos;
+    Callback callback;
+  };
+
+  std::function<bool(bool, std::uint8_t)> connack_handler;
+  std::function<bool(std::uint16_t)> puback_handler;
+  std::function<bool(std::uint16_t)> pubcomp_handler;
+  std::function<bool(std::uint8_t, boost::optional<std::uint16_t>,
+                     std::string, std::string)>
+      publish_handler;
+  Callback error_handler;
+  std::vector<Sent> sent;
+  std::vector<std::vector<std::tuple<std::string, std::uint8_t>>> subscribed;
+  std::uint16_t last_packet_id = 0;
+
+  void set_clean_session(bool) {}
+  template <typename F>
+  void set_connack_handler(F f) {
+    connack_handler = f;
+  }
+  template <typename F>
+  void set_puback_handler(F f) {
+    puback_handler = f;
+  }
+  template <typename F>
+  void set_pubcomp_handler(F f) {
+    pubcomp_handler = f;
+  }
+  template <typename F>
+  void set_publish_handler(F f) {
+    publish_handler = f;
+  }
+  template <typename F>
+  void set_error_handler(F f) {
+    error_handler = f;
+  }
+  template <typename F>
+  void connect(F) {}
+  std::uint16_t acquire_unique_packet_id() { return ++last_packet_id; }
+  template <typename F>
+  void acquired_async_publish(std::uint16_t packet_id,
+                              const std::string& topic_name,
+                              const std::string& message, std::uint8_t qos,
+                              bool retain, F callback) {
+    sent.push_back(Sent{packet_id, topic_name, message, qos, callback});
+  }
+  void async_subscribe(
+      std::vector<std::tuple<std::string, std::uint8_t>> topics) {
+    subscribed.push_back(topics);
+  }
+};
+
+struct Harness {
+  explicit Harness(MqttWrapper::Options options = MqttWrapper::Options())
+      : work(io_service), client(std::make_shared<FakeClient>()) {
+    auto fake_client = client;
+    wrapper = CreateMqttWrapperImpl(
+        [fake_client](boost::asio::io_service&) { return fake_client; },
+        io_service, options);
+    Poll();
+  }
+  ~Harness() {
+    // The handlers hold on to the wrapper.
+    *client = FakeClient();
+  }
+  void Poll() {
+    while (io_service.poll() > 0) {
+    }
+  }
+  // Waits for the next timer, e.g. the next slice of the replay.
+  void Wait() {
+    Poll();
+    io_service.run_one();
+    Poll();
+  }
+  void Connect(bool session_present = false) {
+    client->connack_handler(session_present,
+                            mqtt::connect_return_code::accepted);
+    Poll();
+  }
+  void Disconnect() {
+    client->error_handler(boost::asio::error::connection_reset);
+    Poll();
+  }
+
+  boost::asio::io_service io_service;
+  boost::asio::io_service::work work;
+  std::shared_ptr<FakeClient> client;
+  std::shared_ptr<MqttWrapper> wrapper;
+};
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(MqttWrapperImplFailedPublishForgetsLastValue) {
+  Harness harness;
+  harness.Connect();
+  LastValueCache cache;
+  cache.Enable(TopicClass::State, std::chrono::seconds(0));
+  BOOST_TEST(cache.ShouldPublish(TopicClass::State, "state", "1"));
+  bool failed = false;
+  // Like OnDeviceState().
+  harness.wrapper->Publish("state", "1", mqtt::qos::at_least_once, true)
+      .recover([&](auto f) {
+        try {
+          f.get_try();
+        } catch (const std::exception&) {
+          failed = true;
+          cache.Forget("state");
+        }
+      })
+      .detach();
+  harness.Poll();
+  BOOST_TEST_REQUIRE(harness.client->sent.size() == 1);
+  // Not done until the server confirmed it.
+  BOOST_TEST(!failed);
+  harness.client->sent[0].callback(boost::asio::error::broken_pipe);
+  harness.Poll();
+  BOOST_TEST(failed);
+  BOOST_TEST(cache.ShouldPublish(TopicClass::State, "state", "1"));
+}
+
+BOOST_AUTO_TEST_CASE(MqttWrapperImplRequeuesUnconfirmedInOrder) {
+  MqttWrapper::Options options;
+  options.max_inflight = 2;
+  options.replay_rate = 0;
+  Harness harness(options);
+  harness.Connect();
+  for (const char* message : {"1", "2", "3"}) {
+    harness.wrapper->Publish("state", message, mqtt::qos::at_least_once, true)
+        .detach();
+  }
+  harness.Poll();
+  // The window is full, the last one waits in the queue.
+  BOOST_TEST_REQUIRE(harness.client->sent.size() == 2);
+
+  harness.Disconnect();
+  harness.client->sent.clear();
+  harness.Connect();
+  BOOST_TEST_REQUIRE(harness.client->sent.size() == 2);
+  BOOST_TEST(harness.client->sent[0].message == "1");
+  BOOST_TEST(harness.client->sent[1].message == "2");
+  harness.client->puback_handler(harness.client->sent[0].packet_id);
+  harness.client->puback_handler(harness.client->sent[1].packet_id);
+  harness.Wait();
+  BOOST_TEST_REQUIRE(harness.client->sent.size() == 3);
+  BOOST_TEST(harness.client->sent[2].message == "3");
+}
+
+BOOST_AUTO_TEST_CASE(MqttWrapperImplSubscribesToResumedSession) {
+  Harness harness;
+  harness.wrapper->Subscribe({std::make_tuple("a", 1)}).detach();
+  harness.Poll();
+  // The session might be from an earlier run with other subscriptions.
+  harness.Connect(true);
+  BOOST_TEST(harness.client->subscribed.size() == 1);
+
+  harness.Disconnect();
+  harness.Connect(true);
+  BOOST_TEST(harness.client->subscribed.size() == 1);
+
+  harness.Disconnect();
+  harness.wrapper->Subscribe({std::make_tuple("b", 1)}).detach();
+  harness.Poll();
+  harness.Connect(true);
+  BOOST_TEST_REQUIRE(harness.client->subscribed.size() == 2);
+  BOOST_TEST(harness.client->subscribed[1].size() == 2);
+
+  harness.Disconnect();
+  harness.Connect(false);
+  BOOST_TEST(harness.client->subscribed.size() == 3);
+}
@@ -0,0 +1,37 @@
+#include <payload_format.h>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(PayloadFormatRoundTrip) {
+  const tao::json::value value = {
+      {"type", "uint16"},
+      {"value", 2150},
+      {"list", tao::json::value::array({-1, 0.5, true, tao::json::null})}};
+  for (PayloadFormat format :
+       {PayloadFormat::Json, PayloadFormat::Cbor, PayloadFormat::MsgPack,
+        PayloadFormat::Ubjson}) {
+    std::string payload = EncodePayload(format, value);
+    BOOST_TEST((DecodePayload(format, payload) == value),
+               enum_to_string(format));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(PayloadFormatCbor) {
+  const tao::json::value value = {{"a", 1}};
+  BOOST_TEST(EncodePayload(PayloadFormat::Json, value) == "{\"a\":1}");
+  // Map of one pair, text string of length one, unsigned integer 1.
+  BOOST_TEST(EncodePayload(PayloadFormat::Cbor, value) ==
+             std::string("\xA1\x61"
+                         "a\x01"));
+  BOOST_TEST(PayloadForLog(PayloadFormat::Cbor, "\xA1\x61"
+                                                "a\x01") ==
+             "4 bytes of cbor");
+}
+
+BOOST_AUTO_TEST_CASE(PayloadFormatInvalid) {
+  BOOST_CHECK_THROW(DecodePayload(PayloadFormat::Json, "{\"a\":"),
+                    std::exception);
+  BOOST_CHECK_THROW(DecodePayload(PayloadFormat::Cbor, "\xA1\x61"),
+                    std::exception);
+  BOOST_TEST((string_to_enum<PayloadFormat>("msgpack").value() ==
+              PayloadFormat::MsgPack));
+}
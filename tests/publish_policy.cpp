@@ -0,0 +1,59 @@
+#include <publish_policy.h>
+#include <boost/test/unit_test.hpp>
+#include <sstream>
+
+BOOST_AUTO_TEST_CASE(PublishPolicyDefaults) {
+  PublishPolicies policies;
+  BOOST_TEST(policies.Get(TopicClass::LinkQuality).qos == 0);
+  BOOST_TEST(policies.Get(TopicClass::Alarm).qos == 1);
+  BOOST_TEST(policies.Get(TopicClass::State).retain);
+  BOOST_TEST(!policies.Get(TopicClass::Telemetry).retain);
+  BOOST_TEST(policies.Get(TopicClass::Alarm).durable);
+  BOOST_TEST(!policies.Get(TopicClass::Report).durable);
+}
+
+BOOST_AUTO_TEST_CASE(PublishPolicyParse) {
+  PublishPolicies policies;
+  std::istringstream stream(
+      "telemetry\n"
+      "{\n"
+      "    qos 2\n"
+      "    retain true\n"
+      "    expiry 300\n"
+      "    format cbor\n"
+      "    durable true\n"
+      "}\n"
+      "state\n"
+      "{\n"
+      "    retain false\n"
+      "}\n");
+  BOOST_TEST(policies.ParseFromStream(stream));
+  BOOST_TEST(policies.Get(TopicClass::Telemetry).qos == 2);
+  BOOST_TEST(policies.Get(TopicClass::Telemetry).retain);
+  BOOST_TEST(policies.Get(TopicClass::Telemetry).expiry.count() == 300);
+  BOOST_TEST((policies.Get(TopicClass::Telemetry).format ==
+              PayloadFormat::Cbor));
+  BOOST_TEST(policies.Get(TopicClass::Telemetry).durable);
+  BOOST_TEST(policies.Get(TopicClass::State).qos == 1);
+  BOOST_TEST(policies.Get(TopicClass::State).expiry.count() == 0);
+  BOOST_TEST(!policies.Get(TopicClass::State).retain);
+  BOOST_TEST((policies.Get(TopicClass::State).format == PayloadFormat::Json));
+}
+
+BOOST_AUTO_TEST_CASE(PublishPolicyParseInvalid) {
+  const char* invalid[] = {
+      "telemetry { qos 3 }",        "telemetry { retain maybe }",
+      "telemetry { priority 1 }",   "nonsense { qos 1 }",
+      "telemetry { expiry soon }",  "telemetry { format xml }",
+      "telemetry { durable sometimes }",
+      "linkquality { qos 0 } state { qos -1 }",
+  };
+  for (const char* text : invalid) {
+    PublishPolicies policies;
+    std::istringstream stream(text);
+    BOOST_TEST(!policies.ParseFromStream(stream), text);
+    // Nothing applied when any setting is invalid.
+    BOOST_TEST(policies.Get(TopicClass::LinkQuality).qos == 0);
+    BOOST_TEST(policies.Get(TopicClass::State).qos == 1);
+  }
+}
@@ -0,0 +1,137 @@
+#include <publish_queue.h>
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+namespace {
+// Room for exactly three items with a one character topic & message.
+const std::size_t kThreeItems = 3 * (sizeof(PublishQueue::Item) + 2);
+
+struct Recorder {
+  std::vector<std::string> dropped;
+  PublishQueue::Item Make(std::string topic, std::string message,
+                          std::uint8_t qos = 0) {
+    return PublishQueue::Item{
+        topic, message, qos, false, [this, message](std::exception_ptr ex) {
+          if (ex) {
+            dropped.push_back(message);
+          }
+        }};
+  }
+};
+
+std::vector<std::string> Drain(PublishQueue& queue) {
+  std::vector<std::string> messages;
+  while (!queue.empty()) {
+    messages.push_back(queue.Pop().message);
+  }
+  return messages;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(PublishQueueDropOldest) {
+  Recorder recorder;
+  PublishQueue queue(kThreeItems, PublishQueue::Policy::DropOldest);
+  for (const char* message : {"1", "2", "3", "4"}) {
+    queue.Push(recorder.Make("a", message));
+  }
+  BOOST_TEST(queue.size() == 3);
+  BOOST_TEST(queue.bytes() == kThreeItems);
+  BOOST_TEST(recorder.dropped == std::vector<std::string>{"1"});
+  BOOST_TEST(queue.stats().queued == 4);
+  BOOST_TEST(queue.stats().dropped == 1);
+  BOOST_TEST(Drain(queue) == (std::vector<std::string>{"2", "3", "4"}));
+  BOOST_TEST(queue.bytes() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(PublishQueueDropQos0First) {
+  Recorder recorder;
+  PublishQueue queue(kThreeItems, PublishQueue::Policy::DropQos0First);
+  queue.Push(recorder.Make("a", "1", 1));
+  queue.Push(recorder.Make("b", "2", 0));
+  queue.Push(recorder.Make("c", "3", 1));
+  queue.Push(recorder.Make("d", "4", 1));
+  BOOST_TEST(recorder.dropped == std::vector<std::string>{"2"});
+  // No QoS 0 messages left, fall back to dropping the oldest.
+  queue.Push(recorder.Make("e", "5", 1));
+  BOOST_TEST(recorder.dropped == (std::vector<std::string>{"2", "1"}));
+  BOOST_TEST(Drain(queue) == (std::vector<std::string>{"3", "4", "5"}));
+}
+
+BOOST_AUTO_TEST_CASE(PublishQueueCoalesceTopic) {
+  Recorder recorder;
+  PublishQueue queue(kThreeItems, PublishQueue::Policy::CoalesceTopic);
+  queue.Push(recorder.Make("a", "1"));
+  queue.Push(recorder.Make("b", "2"));
+  queue.Push(recorder.Make("a", "3"));
+  BOOST_TEST(recorder.dropped == std::vector<std::string>{"1"});
+  BOOST_TEST(queue.stats().coalesced == 1);
+  queue.Push(recorder.Make("c", "4"));
+  queue.Push(recorder.Make("d", "5"));
+  BOOST_TEST(recorder.dropped == (std::vector<std::string>{"1", "2"}));
+  BOOST_TEST(Drain(queue) == (std::vector<std::string>{"3", "4", "5"}));
+  // Popped topics are no longer coalesced with.
+  queue.Push(recorder.Make("a", "6"));
+  BOOST_TEST(queue.stats().coalesced == 1);
+}
+
+BOOST_AUTO_TEST_CASE(PublishQueuePushFront) {
+  Recorder recorder;
+  PublishQueue queue(kThreeItems, PublishQueue::Policy::DropOldest);
+  queue.Push(recorder.Make("c", "3"));
+  std::vector<PublishQueue::Item> unconfirmed;
+  unconfirmed.push_back(recorder.Make("a", "1"));
+  unconfirmed.push_back(recorder.Make("b", "2"));
+  queue.PushFront(std::move(unconfirmed));
+  BOOST_TEST(recorder.dropped.empty());
+  BOOST_TEST(Drain(queue) == (std::vector<std::string>{"1", "2", "3"}));
+
+  // Still the oldest, so the first to make room.
+  queue.Push(recorder.Make("c", "3"));
+  queue.Push(recorder.Make("d", "4"));
+  unconfirmed.clear();
+  unconfirmed.push_back(recorder.Make("a", "1"));
+  unconfirmed.push_back(recorder.Make("b", "2"));
+  queue.PushFront(std::move(unconfirmed));
+  BOOST_TEST(recorder.dropped == std::vector<std::string>{"1"});
+  BOOST_TEST(Drain(queue) == (std::vector<std::string>{"2", "3", "4"}));
+}
+
+BOOST_AUTO_TEST_CASE(PublishQueuePushFrontCoalesceTopic) {
+  Recorder recorder;
+  PublishQueue queue(kThreeItems, PublishQueue::Policy::CoalesceTopic);
+  queue.Push(recorder.Make("a", "3"));
+  std::vector<PublishQueue::Item> unconfirmed;
+  unconfirmed.push_back(recorder.Make("b", "1"));
+  unconfirmed.push_back(recorder.Make("a", "2"));
+  unconfirmed.push_back(recorder.Make("b", "4"));
+  queue.PushFront(std::move(unconfirmed));
+  // Only the newest message to each topic is left.
+  BOOST_TEST(recorder.dropped == (std::vector<std::string>{"2", "1"}));
+  BOOST_TEST(queue.stats().coalesced == 2);
+  BOOST_TEST(Drain(queue) == (std::vector<std::string>{"4", "3"}));
+}
+
+BOOST_AUTO_TEST_CASE(PublishQueueTooLarge) {
+  Recorder recorder;
+  PublishQueue queue(kThreeItems, PublishQueue::Policy::DropOldest);
+  queue.Push(recorder.Make("a", "1"));
+  queue.Push(recorder.Make("a", std::string(kThreeItems, 'x')));
+  BOOST_TEST(recorder.dropped.size() == 1);
+  BOOST_TEST(Drain(queue) == std::vector<std::string>{"1"});
+}
+
+BOOST_AUTO_TEST_CASE(PublishQueueExpiry) {
+  Recorder recorder;
+  PublishQueue queue(kThreeItems, PublishQueue::Policy::DropOldest);
+  PublishQueue::Clock::time_point now = PublishQueue::Clock::now();
+  auto item = recorder.Make("a", "1");
+  item.expires_at = now + std::chrono::seconds(10);
+  queue.Push(std::move(item));
+  queue.Push(recorder.Make("b", "2"));
+  queue.DropExpired(now);
+  BOOST_TEST(queue.size() == 2);
+  queue.DropExpired(now + std::chrono::seconds(10));
+  BOOST_TEST(recorder.dropped == std::vector<std::string>{"1"});
+  BOOST_TEST(queue.stats().expired == 1);
+  BOOST_TEST(Drain(queue) == std::vector<std::string>{"2"});
+}
@@ -0,0 +1,137 @@
+#include <publish_spool.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <vector>
+
+namespace {
+// Temporary spool directory, removed again at the end of the test.
+struct SpoolDirectory {
+  std::string path;
+  SpoolDirectory() {
+    char path_template[] = "/tmp/publish_spool_XXXXXX";
+    BOOST_REQUIRE(mkdtemp(path_template) != nullptr);
+    path = path_template;
+  }
+  ~SpoolDirectory() {
+    for (const auto& file : Files()) {
+      unlink((path + "/" + file).c_str());
+    }
+    rmdir(path.c_str());
+  }
+  std::vector<std::string> Files() const {
+    std::vector<std::string> files;
+    DIR* dir = opendir(path.c_str());
+    while (dirent* entry = readdir(dir)) {
+      std::string name(entry->d_name);
+      if (name != "." && name != "..") {
+        files.push_back(name);
+      }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+  }
+};
+
+std::vector<std::string> ReadAll(PublishSpool& spool) {
+  std::vector<std::string> messages;
+  while (auto record = spool.Next()) {
+    messages.push_back(record->message);
+  }
+  return messages;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(PublishSpoolAppendAndRead) {
+  SpoolDirectory directory;
+  PublishSpool spool(directory.path, 1024, 1024 * 1024);
+  BOOST_TEST(!spool.HasNext());
+  BOOST_TEST(*spool.Append("a/b", "1", 1, false) == 0);
+  const PublishSpool::Clock::time_point expires_at(std::chrono::seconds(1000));
+  BOOST_TEST(*spool.Append("a/c", "2", 2, true, expires_at) == 1);
+  BOOST_TEST(spool.dirty());
+  BOOST_TEST(spool.HasNext());
+
+  auto record = spool.Next();
+  BOOST_TEST(!!record);
+  BOOST_TEST(record->sequence == 0);
+  BOOST_TEST(record->topic_name == "a/b");
+  BOOST_TEST(record->message == "1");
+  BOOST_TEST(record->qos == 1);
+  BOOST_TEST(record->retain == false);
+  BOOST_TEST((record->expires_at == PublishSpool::Clock::time_point()));
+  record = spool.Next();
+  BOOST_TEST(record->message == "2");
+  BOOST_TEST((record->expires_at == expires_at));
+  // Appending while reading remaps the segment.
+  spool.Append("a/d", "3", 1, false);
+  BOOST_TEST(ReadAll(spool) == std::vector<std::string>{"3"});
+  BOOST_TEST(!spool.HasNext());
+
+  // Unacknowledged records are read again after rewinding.
+  spool.Acknowledge(1);
+  BOOST_TEST(spool.size() == 2);
+  spool.Rewind();
+  BOOST_TEST(ReadAll(spool) == (std::vector<std::string>{"1", "3"}));
+  spool.Sync();
+  BOOST_TEST(!spool.dirty());
+}
+
+BOOST_AUTO_TEST_CASE(PublishSpoolRecover) {
+  SpoolDirectory directory;
+  {
+    PublishSpool spool(directory.path, 1024, 1024 * 1024);
+    for (const char* message : {"1", "2", "3"}) {
+      spool.Append("topic", message, 1, false);
+    }
+    spool.Next();
+    spool.Acknowledge(0);
+  }
+  // Simulate a write torn by a power failure.
+  {
+    std::ofstream segment(directory.path + "/0000000000000000.spool",
+                          std::ios::app | std::ios::binary);
+    segment << "torn";
+  }
+  PublishSpool spool(directory.path, 1024, 1024 * 1024);
+  BOOST_TEST(spool.size() == 2);
+  BOOST_TEST(ReadAll(spool) == (std::vector<std::string>{"2", "3"}));
+  BOOST_TEST(*spool.Append("topic", "4", 1, false) == 3);
+  BOOST_TEST(ReadAll(spool) == std::vector<std::string>{"4"});
+}
+
+BOOST_AUTO_TEST_CASE(PublishSpoolCompact) {
+  SpoolDirectory directory;
+  PublishSpool spool(directory.path, 1, 1024 * 1024);
+  // Every record fills a segment.
+  for (const char* message : {"1", "2", "3"}) {
+    spool.Append("topic", message, 1, false);
+  }
+  BOOST_TEST(directory.Files() == (std::vector<std::string>{
+                                      "0000000000000000.spool",
+                                      "0000000000000001.spool",
+                                      "0000000000000002.spool",
+                                  }));
+  ReadAll(spool);
+  spool.Acknowledge(1);
+  BOOST_TEST(directory.Files().size() == 3);
+  spool.Acknowledge(0);
+  BOOST_TEST(directory.Files() ==
+             std::vector<std::string>{"0000000000000002.spool"});
+  spool.Acknowledge(2);
+  spool.Sync();
+  BOOST_TEST(directory.Files() == std::vector<std::string>{"cursor"});
+  BOOST_TEST(spool.bytes() == 0);
+  BOOST_TEST(spool.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(PublishSpoolFull) {
+  SpoolDirectory directory;
+  PublishSpool spool(directory.path, 1024, 64);
+  BOOST_TEST(!!spool.Append("topic", "1", 1, false));
+  BOOST_TEST(!spool.Append("topic", std::string(64, 'x'), 1, false));
+  BOOST_TEST(spool.size() == 1);
+}
@@ -0,0 +1,32 @@
+#include <reconnect_backoff.h>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE(ReconnectBackoffBounds) {
+  const ReconnectBackoff::Duration min(100);
+  const ReconnectBackoff::Duration max(5000);
+  ReconnectBackoff backoff(min, max, 1234);
+  BOOST_TEST(backoff.Next().count() == 0);
+  ReconnectBackoff::Duration previous = min;
+  bool reached_max = false;
+  for (int i = 0; i < 100; i++) {
+    ReconnectBackoff::Duration delay = backoff.Next();
+    BOOST_TEST(delay.count() >= min.count());
+    BOOST_TEST(delay.count() <= std::min(max, previous * 3).count());
+    reached_max |= delay == max;
+    previous = delay;
+  }
+  BOOST_TEST(reached_max);
+}
+
+BOOST_AUTO_TEST_CASE(ReconnectBackoffReset) {
+  ReconnectBackoff backoff(ReconnectBackoff::Duration(100),
+                           ReconnectBackoff::Duration(5000), 1234);
+  backoff.Next();
+  for (int i = 0; i < 10; i++) {
+    backoff.Next();
+  }
+  backoff.Reset();
+  BOOST_TEST(backoff.Next().count() == 0);
+  BOOST_TEST(backoff.Next().count() <= 300);
+}
@@ -0,0 +1,72 @@
+#include <signal_slot.h>
+#include <boost/test/unit_test.hpp>
+#include <vector>
+
+BOOST_AUTO_TEST_CASE(SignalCallsSlotsInOrder) {
+  Signal<void(int, const std::vector<int>&)> signal;
+  std::vector<int> calls;
+  signal.connect([&calls](int value, const std::vector<int>& values) {
+    calls.push_back(value + values.size());
+  });
+  signal.connect([&calls](int value, const std::vector<int>&) {
+    calls.push_back(value * 10);
+  });
+  signal(1, {1, 2});
+  BOOST_TEST(calls == std::vector<int>({3, 10}),
+             boost::test_tools::per_element());
+  BOOST_TEST(signal.num_slots() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(SignalPassesByReference) {
+  Signal<void(std::vector<int>)> signal;
+  const std::vector<int> values = {1, 2, 3};
+  const std::vector<int>* seen = nullptr;
+  signal.connect(
+      [&seen](const std::vector<int>& argument) { seen = &argument; });
+  signal(values);
+  BOOST_TEST(seen == &values);
+}
+
+BOOST_AUTO_TEST_CASE(SignalDisconnect) {
+  Signal<void()> signal;
+  int calls = 0;
+  Connection connection = signal.connect([&calls]() { calls++; });
+  signal();
+  BOOST_TEST(connection.connected());
+  connection.disconnect();
+  BOOST_TEST(!connection.connected());
+  signal();
+  BOOST_TEST(calls == 1);
+  BOOST_TEST(signal.empty());
+  {
+    ScopedConnection scoped = signal.connect([&calls]() { calls++; });
+    signal();
+  }
+  signal();
+  BOOST_TEST(calls == 2);
+}
+
+BOOST_AUTO_TEST_CASE(SignalChangesWhileEmitting) {
+  Signal<void(int)> signal;
+  std::vector<int> calls;
+  signal.connect_extended([&calls](const Connection& connection, int value) {
+    calls.push_back(value);
+    connection.disconnect();
+  });
+  Connection second;
+  signal.connect([&](int value) {
+    calls.push_back(value * 10);
+    // Connected now, called from the next emission on.
+    signal.connect([&calls](int value) { calls.push_back(value * 100); });
+    second.disconnect();
+  });
+  second = signal.connect([&calls](int value) { calls.push_back(-value); });
+  signal(1);
+  BOOST_TEST(calls == std::vector<int>({1, 10}),
+             boost::test_tools::per_element());
+  calls.clear();
+  signal(2);
+  BOOST_TEST(calls == std::vector<int>({20, 200}),
+             boost::test_tools::per_element());
+  BOOST_TEST(signal.num_slots() == 3);
+}
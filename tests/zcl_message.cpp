@@ -0,0 +1,48 @@
+#include <zcl/zcl_message.h>
+#include <boost/test/unit_test.hpp>
+
+namespace {
+std::shared_ptr<const znp::IncomingMsg> MakeIncomingMsg(
+    std::vector<uint8_t> data) {
+  auto message = std::make_shared<znp::IncomingMsg>();
+  message->ClusterId = 0x0402;
+  message->SrcAddr = 0x1234;
+  message->SrcEndpoint = 1;
+  message->Data = std::move(data);
+  return message;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(ZclMessageParsesHeader) {
+  // Report Attributes, server to client
+  auto incoming = MakeIncomingMsg({0x18, 0x42, 0x0A, 0x00, 0x00, 0x29, 0x34,
+                                   0x08});
+  auto message = zcl::ZclMessage::Create(incoming);
+  BOOST_TEST(message->source_address() == 0x1234);
+  BOOST_TEST(message->source_endpoint() == 1);
+  BOOST_TEST((message->cluster_id() == zcl::ZclClusterId(0x0402)));
+  BOOST_TEST(message->is_global_command());
+  BOOST_TEST((message->header().direction ==
+              zcl::ZclDirection::ServerToClient));
+  BOOST_TEST(message->header().transaction_sequence_number == 0x42);
+  BOOST_TEST((message->header().command_identifier == zcl::ZclCommandId(0x0A)));
+  BOOST_TEST(!message->header().manufacturer_code);
+  // The payload refers into the AF message's data
+  BOOST_TEST(message->payload_size() == 5);
+  BOOST_TEST(&*message->payload_begin() == &incoming->Data[3]);
+}
+
+BOOST_AUTO_TEST_CASE(ZclMessageManufacturerSpecific) {
+  auto message = zcl::ZclMessage::Create(
+      MakeIncomingMsg({0x1D, 0x5F, 0x11, 0x07, 0x0A, 0x01, 0xFF}));
+  BOOST_TEST(!message->is_global_command());
+  BOOST_TEST(*message->header().manufacturer_code == 0x115F);
+  BOOST_TEST(message->header().transaction_sequence_number == 0x07);
+  BOOST_TEST((message->header().command_identifier == zcl::ZclCommandId(0x0A)));
+  BOOST_TEST(message->payload_size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(ZclMessageTruncated) {
+  BOOST_CHECK_THROW(zcl::ZclMessage::Create(MakeIncomingMsg({0x18, 0x42})),
+                    std::exception);
+}
@@ -0,0 +1,51 @@
+// Compiles clusters.info into a C++ source file containing a binary image of
+// the cluster database, so AqaraHub doesn't need to parse it at startup.
+#include <boost/format.hpp>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "clusterdb/cluster_db.h"
+
+int main(int argc, const char** argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <clusters.info> <output.cpp>"
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  clusterdb::ClusterDb cluster_db;
+  try {
+    // Names are stored unmangled, AqaraHub mangles them when loading.
+    if (!cluster_db.ParseFromFile(argv[1], [](std::string x) { return x; })) {
+      std::cerr << "Unable to parse '" << argv[1] << "'" << std::endl;
+      return EXIT_FAILURE;
+    }
+  } catch (const std::exception& ex) {
+    std::cerr << "Unable to read '" << argv[1] << "': " << ex.what()
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::stringstream image;
+  cluster_db.WriteImage(image);
+  std::string image_data(image.str());
+
+  std::ofstream output(argv[2]);
+  output << "// Generated by compile_cluster_info, do not edit." << std::endl;
+  output << "#include \"clusterdb/builtin_image.h\"" << std::endl << std::endl;
+  output << "namespace clusterdb {" << std::endl;
+  output << "const std::uint8_t builtin_image[] = {";
+  for (std::size_t i = 0; i < image_data.size(); i++) {
+    output << ((i % 12 == 0) ? "\n    " : " ")
+           << boost::str(boost::format("0x%02X,") %
+                         (unsigned int)(std::uint8_t)image_data[i]);
+  }
+  output << std::endl << "};" << std::endl;
+  output << "const std::size_t builtin_image_size = sizeof(builtin_image);"
+         << std::endl;
+  output << "}  // namespace clusterdb" << std::endl;
+  output.close();
+  if (!output) {
+    std::cerr << "Unable to write '" << argv[2] << "'" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
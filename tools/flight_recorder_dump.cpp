@@ -0,0 +1,85 @@
+// Prints a flight recorder dump, as written by AqaraHub on SIGUSR1 or a publish
+// to write/flightrecorder, one entry per line.
+#include <algorithm>
+#include <boost/format.hpp>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include "flight_recorder.h"
+#include "znp/znp.h"
+
+namespace {
+void PrintData(const FlightRecorder::Entry& entry, bool text) {
+  const std::size_t size =
+      std::min<std::size_t>(entry.size, FlightRecorder::kMaxData);
+  for (std::size_t i = 0; i < size; i++) {
+    const std::uint8_t c = entry.data[i];
+    if (text && c == 0) {
+      std::cout << ' ';
+    } else if (text && c >= 0x20 && c < 0x7F) {
+      std::cout << (char)c;
+    } else if (text) {
+      std::cout << '.';
+    } else {
+      std::cout << boost::format(" %02X") % (unsigned int)c;
+    }
+  }
+  if (entry.size > size) {
+    std::cout << " ... (" << entry.size << " bytes)";
+  }
+}
+}  // namespace
+
+int main(int argc, const char** argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <dump>" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::ifstream file(argv[1], std::ios::binary);
+  if (!file) {
+    std::cerr << "Unable to open '" << argv[1] << "'" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::vector<FlightRecorder::Entry> entries;
+  try {
+    entries = FlightRecorder::Read(file);
+  } catch (const std::exception& ex) {
+    std::cerr << "Unable to read '" << argv[1] << "': " << ex.what()
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  for (const auto& entry : entries) {
+    const std::time_t seconds = entry.timestamp_us / 1000000;
+    char time[32];
+    std::strftime(time, sizeof(time), "%F %T", std::localtime(&seconds));
+    std::cout << time
+              << boost::format(".%06d %-16s ") %
+                     (unsigned int)(entry.timestamp_us % 1000000) %
+                     entry.kind;
+    switch (entry.kind) {
+      case FlightRecorder::Kind::FrameIn:
+      case FlightRecorder::Kind::FrameOut:
+        std::cout << (znp::ZnpCommandType)((entry.code >> 12) & 0xE) << " "
+                  << znp::ZnpCommand((znp::ZnpSubsystem)((entry.code >> 8) &
+                                                         0x1F),
+                                     entry.code & 0xFF)
+                  << ":";
+        PrintData(entry, false);
+        break;
+      case FlightRecorder::Kind::MqttIn:
+      case FlightRecorder::Kind::MqttOut:
+        std::cout << "QoS " << entry.code << " ";
+        PrintData(entry, true);
+        break;
+      case FlightRecorder::Kind::DecodeError:
+        std::cout << boost::format("cluster 0x%04X:") % entry.code;
+        PrintData(entry, false);
+        break;
+      default:
+        std::cout << entry.code;
+        break;
+    }
+    std::cout << std::endl;
+  }
+  return EXIT_SUCCESS;
+}